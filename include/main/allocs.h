@@ -0,0 +1,71 @@
+#ifndef ALLOCS_H_
+#define ALLOCS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "main/bytecode.h"
+#include "main/runtime.h"
+
+/**
+ * Allocation statistics, collected while runtime->allocStats is set. Every
+ * thing and scope that is created is counted for the instruction of the
+ * innermost blerg frame on the call stack, so allocations made by native
+ * functions are attributed to the blerg code that called them. Allocations
+ * made while no blerg code runs have no site.
+ *
+ * Ints, floats, bools and none are immediates and are never counted.
+ */
+
+//scopes are counted like a thing type of their own
+#define ALLOC_SCOPE THING_TYPES
+#define ALLOC_TYPES (THING_TYPES + 1)
+
+//how many of the sites that allocate the most are reported
+#define ALLOC_REPORTED 20
+
+typedef struct {
+    //the module and the index in its code of the allocating instruction, or
+    //NULL if no blerg code was running
+    const Module* module;
+    uint32_t index;
+    //a thing type or ALLOC_SCOPE
+    uint32_t type;
+    //the number of allocations, or zero if the entry is unused
+    uint64_t count;
+    uint64_t bytes;
+} AllocSite;
+
+struct AllocStats {
+    //indexed by thing type or ALLOC_SCOPE
+    uint64_t counts[ALLOC_TYPES];
+    uint64_t bytes[ALLOC_TYPES];
+    //an open addressing hash table with linear probing. sitesCapacity is a
+    //power of two.
+    AllocSite* sites;
+    uint32_t sitesLength;
+    uint32_t sitesCapacity;
+};
+
+typedef struct AllocStats AllocStats;
+
+AllocStats* createAllocStats();
+void destroyAllocStats(AllocStats* stats);
+
+/**
+ * Counts an allocation of the given size for the current instruction.
+ *
+ * @param type a thing type or ALLOC_SCOPE
+ */
+void countAlloc(Runtime* runtime, uint32_t type, size_t size);
+
+/**
+ * Prints the allocations per site and per type, followed by the things and
+ * scopes that are still live. Garbage is collected first, so things that are
+ * not reachable from the runtime's roots are freed. This must be done before
+ * the modules that were executed are destroyed.
+ */
+void printAllocStats(Runtime* runtime, FILE* file);
+
+#endif /* ALLOCS_H_ */
@@ -2,8 +2,15 @@
 #define BYTECODE_H_
 
 #include <stdint.h>
+#include <stddef.h>
 #include "main/util.h"
 
+class Thing;
+struct Shape;
+
+//Compiled modules are cached on disk (see cache.h). Caches are only loaded
+//by the build of blerg that wrote them, so changes to the instructions do not
+//need to be recorded anywhere.
 enum INSTRUCTIONS {
     //args: value (uint32)
     //stack: -> uin32
@@ -30,10 +37,14 @@ enum INSTRUCTIONS {
     //pops x off the stack and returns x. This is the value that is pushed onto
     //the stack in the OP_CALL instruction of the caller.
     OP_RETURN,
-    //args: label (uint32)
+    //args: label (uint32) capturedNum (uint32)
+    //      (<uint8 CaptureSource> <uint32 index>)*
     //stack: -> func
-    //creates a new function which inherits the current scope is the current
-    //scope and whose entry point is the label.
+    //creates a new function whose entry point is the label. Each variable the
+    //function captures is followed by where the value is copied from: a local
+    //slot or captured variable of the current function, or a name in the
+    //constant table that is looked up in the current scope. Captured values
+    //that are not assigned yet are looked up when they are first used.
     OP_CREATE_FUNC,
     //args: name (uint32)
     //stack: -> value
@@ -62,22 +73,77 @@ enum INSTRUCTIONS {
     OP_CHECK_NONE,
     //This opcode performs no operations, but denotes the beginning of a
     //function. It is used to tell the runtime function object the function's
-    //arity and the names to bind the arguments to. The format is
+    //arity and the names of its local variable slots. The format is
     //
-    //<byte opcode = OP_DEF_FUNC> <uint8 argNum> (<uint32 argNameIndex>)+
+    //<byte opcode = OP_DEF_FUNC> <uint8 argNum> <uint32 slotNum>
+    //        (<uint32 slotNameIndex>)* <uint32 capturedNum>
+    //        (<uint32 capturedNameIndex>)*
     //
     //The opcode is followed by an integer operand that denotes the function's
-    //arity. Following the arity is a variable number of integer operands whose
-    //values correspond to the index of the argument names in the constant
-    //table. The number of these arguments is equal to the functions arity
-    //found in the first operand.
+    //arity. Following the arity is the number of local variable slots, and
+    //then a variable number of integer operands whose values correspond to the
+    //index of the slot names in the constant table. The first argNum slots are
+    //the arguments. The names of the captured variables follow in the same
+    //way.
     //
-    //For example, "def myFunc x y then ..." would become "OP_DEF_FUNC 2 35 36"
-    //assuming that 35 corresponds to "x" and 36 corresponds to "y" in the
-    //constant table.
+    //For example, "def myFunc x y then z = x + w; ..." would become
+    //"OP_DEF_FUNC 2 3 35 36 37 1 38" assuming that 35 corresponds to "x", 36
+    //corresponds to "y", 37 corresponds to "z" and 38 corresponds to "w" in
+    //the constant table.
     OP_DEF_FUNC,
+    //args: slot (uint32)
+    //stack: -> value
+    //Pushes the local variable in the given slot. If the slot has not been
+    //assigned yet, the name is looked up in the enclosing scopes instead.
+    OP_LOAD_LOCAL,
+    //args: slot (uint32)
+    //stack: value ->
+    //Assigns the local variable in the given slot.
+    OP_STORE_LOCAL,
+    //args: index (uint32)
+    //stack: -> value
+    //Pushes the captured variable with the given index. If it was not assigned
+    //when the function was created, the name is looked up in the scope the
+    //function was created in, and the value found is kept as the captured
+    //value.
+    OP_LOAD_CAPTURED,
+    //args:
+    //stack: a b -> c
+    //Each of these applies an operator to a and b. Two ints or two floats are
+    //handled directly. Anything else is passed to the operator's symbol, just
+    //as if PUSH_BUILTIN and CALL 2 had been used.
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_EQ,
+    OP_NOT_EQ,
+    OP_LESS_THAN,
+    OP_LESS_THAN_EQ,
+    OP_GREATER_THAN,
+    OP_GREATER_THAN_EQ,
+    //args: arity (uint32)
+    //stack: f x_1 x_2 ... x_n -> y
+    //Like OP_CALL, but it is always followed by OP_RETURN. If f is a blerg
+    //function called from another function, the callee's frame replaces the
+    //current frame, so it returns straight to the current frame's caller.
+    //Otherwise, this is the same as OP_CALL.
+    OP_TAIL_CALL,
 };
 
+//the number of opcodes
+#define OPCODES (OP_TAIL_CALL + 1)
+
+//the number of operator opcodes, from OP_ADD to OP_GREATER_THAN_EQ
+#define OPERATOR_OPCODES (OP_GREATER_THAN_EQ - OP_ADD + 1)
+
+//where OP_CREATE_FUNC copies a captured variable from
+typedef enum {
+    CAPTURE_LOCAL,
+    CAPTURE_CAPTURED,
+    CAPTURE_NAME
+} CaptureSource;
+
 typedef struct {
     uint32_t index;
     SrcLoc location;
@@ -86,13 +152,99 @@ typedef struct {
 BytecodeSrcLoc createBytecodeSrcLoc(uint32_t index, SrcLoc location);
 
 /**
- * The compiled contents of a module. This contains none of the values
- * generated at runtime.
+ * An instruction decoded from the bytecode so that executeCode does not need
+ * to decode operands as it runs. Each instruction in the bytecode becomes one
+ * of these, except that OP_CREATE_FUNC is followed by one per captured
+ * variable whose opcode is the variable's CaptureSource.
+ */
+typedef struct {
+    //address of the instruction's handler in executeCode once the module is
+    //threaded, otherwise NULL
+    const void* handler;
+    uint8_t opcode;
+    //the decoded operand. Jump targets are indices into Module.code and
+    //constants are looked up in the constant table. Once the module is
+    //threaded, the operand of OP_PUSH_LITERAL is the literal's Thing.
+    union {
+        int32_t i;
+        uint32_t u;
+        float f;
+        const char* str;
+        Thing* thing;
+    } arg;
+    //the hash of a constant operand, or the second operand of OP_CREATE_FUNC
+    //and OP_DEF_FUNC. Once the module is threaded, the index of the call
+    //site's cache for OP_CALL and OP_TAIL_CALL.
+    uint32_t extra;
+    //index of the instruction in the bytecode
+    uint32_t offset;
+} Instruction;
+
+//the number of callees each call site remembers
+#define CALL_CACHE_ENTRIES 4
+
+//how a call site calls a callee it has seen before
+typedef enum {
+    //a blerg function, whose frame is created from index and slotNum
+    CALL_CACHE_FUNC,
+    //a symbol sent to an object of a shape with the symbol, which reads the
+    //value from the slot given by index
+    CALL_CACHE_PROPERTY,
+    //an operator symbol sent to two ints or two floats, which is applied
+    //like the operator's opcode
+    CALL_CACHE_OPERATOR,
+    //any other symbol, which is dispatched to the receiver directly
+    CALL_CACHE_DISPATCH
+} CallCacheKind;
+
+/**
+ * A callee that a call site has seen. Functions are recognized by their
+ * module and entry and symbols by their id and the type of their receiver, as
+ * well as its shape for objects. The things themselves are not used, so the
+ * entries remain valid when the things are collected and do not depend on
+ * the runtime.
+ */
+typedef struct {
+    uint8_t kind;
+    //the opcode of CALL_CACHE_OPERATOR
+    uint8_t opcode;
+    //the number of arguments passed to the function
+    uint8_t arity;
+    //the function's entry or the symbol's id
+    uint32_t key;
+    //the function's module, or NULL for symbols
+    const void* module;
+    //the type of the symbol's receiver
+    uint32_t receiverType;
+    //the shape of the receiver if it is an object, otherwise NULL
+    const struct Shape* shape;
+    //the index in the module's code of the function's first instruction
+    //after its OP_DEF_FUNC header and the function's number of slots, or
+    //the slot of CALL_CACHE_PROPERTY
+    uint32_t index;
+    uint32_t slotNum;
+} CallCacheEntry;
+
+/**
+ * The inline cache of an OP_CALL or OP_TAIL_CALL instruction. Once all the
+ * entries are used, further callees take the uncached path.
+ */
+typedef struct {
+    uint32_t length;
+    CallCacheEntry entries[CALL_CACHE_ENTRIES];
+} CallCache;
+
+/**
+ * The compiled contents of a module. Apart from the things of its string
+ * literals, this contains none of the values generated at runtime.
  */
 typedef struct {
     //the constant table, constantsLength is the length of constants
     uint32_t constantsLength;
     const char** constants;
+    //hashStr of each constant, so that names do not need to be rehashed
+    //every time they are looked up
+    const uint32_t* constantHashes;
 
     //the bytecode, bytecodeLength is the length of bytecode
     uint32_t bytecodeLength;
@@ -103,6 +255,70 @@ typedef struct {
 
     uint32_t entryIndex;
     const char* name;
+
+    //the bytecode decoded by translateModule, codeLength is the length of
+    //code. codeIndex maps the index of each instruction in the bytecode to its
+    //index in code.
+    uint32_t codeLength;
+    Instruction* code;
+    uint32_t* codeIndex;
+    //zero until executeCode has filled in the handlers of code. Then it tells
+    //which version of executeCode the handlers belong to.
+    uint8_t threaded;
+    //the StrThing of each constant used by OP_PUSH_LITERAL, indexed like
+    //constants. The table is created when the module is threaded; until then
+    //it is NULL. The things are owned by the module, not by a runtime.
+    Thing** literals;
+    //the cache of each call site, indexed by the extra field of the call's
+    //instruction. These are created along with the literals.
+    uint32_t callCachesLength;
+    CallCache* callCaches;
+
+    //if the module was loaded by loadModuleCache, the mapped cache file that
+    //the constants, bytecode and srcLoc point into. Otherwise NULL.
+    const void* cache;
+    size_t cacheLength;
 } Module;
 
+/**
+ * Returns the number of bytes the instruction at the given index of the
+ * bytecode occupies, operands included.
+ */
+uint32_t instructionSize(const unsigned char* bytecode, uint32_t index);
+
+/**
+ * Checks that bytecode the compiler did not just produce, such as that of a
+ * cached module, is safe to translate and execute. Every instruction must fit
+ * in the bytecode, operands must refer to existing constants, slots, captured
+ * variables and functions, jumps must stay in their function and no
+ * instruction may pop more values than the stack of its function holds.
+ *
+ * @return whether the bytecode passed the checks
+ */
+uint8_t checkBytecode(const Module* module);
+
+/**
+ * Decodes the module's bytecode into module->code. This must be done before
+ * the module is executed.
+ */
+void translateModule(Module* module);
+
+/**
+ * Frees the decoded form of the module created by translateModule, along
+ * with the module's literals and call caches.
+ */
+void destroyModuleCode(Module* module);
+
+/**
+ * Returns the source location of the instruction at the given index of
+ * module->code. Instructions without a location of their own belong to the
+ * closest one before them.
+ */
+SrcLoc findSrcLoc(const Module* module, uint32_t index);
+
+/**
+ * Returns the name of the opcode, such as "PUSH_INT" for OP_PUSH_INT.
+ */
+const char* opcodeName(uint8_t opcode);
+
 #endif /* BYTECODE_H_ */
@@ -0,0 +1,62 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <stdint.h>
+
+#include "main/bytecode.h"
+
+/**
+ * Compiled modules are cached in .blgc files next to their source, so that
+ * later runs do not need to parse, transform and compile the source again.
+ *
+ * A cache file is a CacheHeader followed by the constant hashes, the offsets
+ * of the constants in the constant data, the srcLoc entries, the bytecode and
+ * finally the constant data, which is every constant followed by a 0 byte.
+ * There are no pointers in the file, so it is mapped into memory and used in
+ * place. Numbers are stored in native byte order; the cache is not meant to be
+ * shared between machines.
+ *
+ * The header records a hash of the source and an identifier of the build of
+ * blerg that wrote the cache. If either changes, the cache is ignored and
+ * rewritten. The bytecode of a cache is checked before it is used, and a cache
+ * that fails the checks is treated like a missing one.
+ */
+
+/**
+ * Must be incremented whenever the layout of cache files changes. Changes to
+ * the bytecode are caught by the build identifier instead.
+ */
+#define CACHE_VERSION 5
+
+/**
+ * Returns the path of the cache of the given source file. The returned string
+ * must be freed.
+ */
+char* cachePath(const char* path);
+
+/**
+ * Loads the cached module of the source file at path.
+ *
+ * @param path the path of the source file
+ * @param src the current contents of the source file
+ * @return the module, or NULL if there is no cache, it is for a different
+ *      version of the source or it is invalid
+ */
+Module* loadModuleCache(const char* path, const char* src);
+
+/**
+ * Writes the module to the cache of the source file at path. The cache is
+ * written to a temporary file that replaces the old cache, so other processes
+ * never see a partially written cache.
+ *
+ * @return whether the cache was written
+ */
+uint8_t saveModuleCache(const char* path, const char* src, Module* module);
+
+/**
+ * Frees the parts of a module that loadModuleCache created, including the
+ * mapping of the cache file.
+ */
+void destroyModuleCache(Module* module);
+
+#endif /* CACHE_H_ */
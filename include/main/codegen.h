@@ -11,27 +11,39 @@
  * Contains an alternative representation of a module as its being built.
  * Useful for building modules.
  */
+/**
+ * A reference to a label in the bytecode.
+ */
+typedef struct {
+    uint32_t label;
+    //the index of the 4 bytes in the bytecode that are patched with the
+    //label's position
+    uint32_t position;
+} LabelRef;
+
 typedef struct {
     /*
-     * Instead of the constants and bytecode being stored as a continuous
-     * array, They are instead split into arrays of SEGMENT_SIZE and stored as
-     * a list in reverse order. As new elements are added, the first array is
-     * filled up. Once it is full, a new array is created and added to the
-     * beginning of the list.
-     *
-     * Note that constantsLength and bytecodeLength count the number of filled
-     * elements in all the segments of their respective lists. They do not
-     * count the current capacity.
+     * The constants, bytecode and srcLoc entries are stored in arrays that
+     * double in size when they are full. Each length counts the elements in
+     * use and each capacity counts the elements the array has room for.
+     * builderToModule hands the arrays to the module.
      */
 
     uint32_t constantsLength;
-    List* constants;
+    uint32_t constantsCapacity;
+    const char** constants;
+    //the hashStr of each constant
+    uint32_t* constantHashes;
+    //maps the constants to their indices, so interning is constant time
+    Map* constantIndices;
 
     uint32_t bytecodeLength;
-    List* bytecode;
+    uint32_t bytecodeCapacity;
+    uint8_t* bytecode;
 
     uint32_t srcLocLength;
-    List* srcLoc;
+    uint32_t srcLocCapacity;
+    BytecodeSrcLoc* srcLoc;
 
     /**
      * Since labels are referenced in instructions before they are defined via
@@ -51,13 +63,20 @@ typedef struct {
     //in order to get a unique label.
     uint32_t nextLabel;
 
-    //stores the definition of labels.
-    //Maps labels (ints) to bytecode positions (ints)
-    Map* labelDefs;
+    //stores the bytecode position of each label, indexed by label. It has
+    //room for labelsCapacity labels.
+    uint32_t labelsCapacity;
+    uint32_t* labelDefs;
 
-    //stores the references of labels.
-    //Maps labels (ints) to lists of bytecode positions (ints)
-    Map* labelRefs;
+    //every label reference, in the order they were emitted
+    uint32_t labelRefsLength;
+    uint32_t labelRefsCapacity;
+    LabelRef* labelRefs;
+
+    //the bytecode position just after the last OP_CALL, or 0 if there is
+    //none. emitReturn turns a call that is directly before it into a tail
+    //call.
+    uint32_t callEnd;
 } ModuleBuilder;
 
 ModuleBuilder* createModuleBuilder();
@@ -88,16 +107,47 @@ void emitPushBuiltin(ModuleBuilder* builder, const char* name);
 void emitPushLiteral(ModuleBuilder* builder, const char* literal);
 void emitPushNone(ModuleBuilder* builder);
 void emitCall(ModuleBuilder* builder, uint32_t arity);
+
+/**
+ * Emits a RETURN instruction. If the previous instruction is a CALL, it is
+ * replaced with a TAIL_CALL.
+ */
 void emitReturn(ModuleBuilder* builder);
 
 /**
  * Emits a CREATE_FUNC instruction. The location is the label just before the
- * function's bytecode.
+ * function's bytecode. It must be followed by capturedNum calls to emitCapture
+ * or emitCaptureName, one for each variable the function captures.
  */
-void emitCreateFunc(ModuleBuilder* builder, uint32_t location);
+void emitCreateFunc(ModuleBuilder* builder, uint32_t location,
+        uint32_t capturedNum);
+
+/**
+ * Emits where a captured variable comes from. source is a CaptureSource and
+ * index is the slot or captured variable index.
+ */
+void emitCapture(ModuleBuilder* builder, uint8_t source, uint32_t index);
+
+/**
+ * Emits a captured variable that is looked up by name.
+ */
+void emitCaptureName(ModuleBuilder* builder, const char* name);
 
 void emitLoad(ModuleBuilder* builder, const char* name);
 void emitStore(ModuleBuilder* builder, const char* name);
+void emitLoadLocal(ModuleBuilder* builder, uint32_t slot);
+void emitStoreLocal(ModuleBuilder* builder, uint32_t slot);
+void emitLoadCaptured(ModuleBuilder* builder, uint32_t index);
+void emitDup(ModuleBuilder* builder);
+void emitRot3(ModuleBuilder* builder);
+void emitSwap(ModuleBuilder* builder);
+void emitPop(ModuleBuilder* builder);
+void emitCheckNone(ModuleBuilder* builder);
+
+/**
+ * Emits one of the operator instructions, OP_ADD through OP_GREATER_THAN_EQ.
+ */
+void emitOperator(ModuleBuilder* builder, uint8_t opcode);
 
 /**
  * Emits a conditional jump instruction.
@@ -121,19 +171,28 @@ void emitAbsJump(ModuleBuilder* builder, uint32_t label);
  * Emits a function definition instruction.
  *
  * @param builder the ModuleBuilder instance
- * @param argNum the arity of the function. This should be the length of args
- * @param args an array of the argument names. The function will not hold a
- *      reference to the array or any of its elements; it will copy them as
- *      necessary.
+ * @param argNum the arity of the function. The first argNum slots are the
+ *      arguments.
+ * @param slotNum the number of local variable slots. This should be the
+ *      length of slots
+ * @param slots an array of the local variable names. The function will not
+ *      hold a reference to the array or any of its elements; it will copy them
+ *      as necessary.
+ * @param capturedNum the number of captured variables. This should be the
+ *      length of captured
+ * @param captured an array of the captured variable names. It is copied like
+ *      slots.
  */
-void emitDefFunc(ModuleBuilder* builder, uint8_t argNum, const char** args,
+void emitDefFunc(ModuleBuilder* builder, uint8_t argNum, uint32_t slotNum,
+        const char** slots, uint32_t capturedNum, const char** captured,
         uint8_t isInit);
 
 void emitSrcLoc(ModuleBuilder* builder, SrcLoc location);
 
 /**
- * Turns a ModuleBuilder into a module suitable for interpreting. This compacts
- * the segments into a single array and patches the label references.
+ * Turns a ModuleBuilder into a module suitable for interpreting. This patches
+ * the label references and moves the builder's arrays to the module. Nothing
+ * can be emitted to the builder afterwards; it must only be destroyed.
  */
 Module* builderToModule(ModuleBuilder* builder, uint32_t entry);
 
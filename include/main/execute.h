@@ -28,6 +28,26 @@
 Runtime* createRuntime(uint8_t argc, const char* args[]);
 void destroyRuntime(Runtime* runtime);
 
+/**
+ * Sets the maximum call depth. Calls beyond it raise a stack overflow error.
+ * Must not be called while code is executing.
+ */
+void setStackFrameLimit(Runtime* runtime, uint32_t limit);
+
+/**
+ * Creates a module level scope. It is freed by the garbage collector once
+ * unreachable.
+ */
+Scope* createScope(Runtime* runtime, Scope* parent);
+
+/**
+ * Creates a scope for an invocation of func with slotCount empty slots. It is
+ * freed by the garbage collector once unreachable.
+ */
+Scope* createSlotScope(Runtime* runtime, Scope* parent, Thing* func,
+        uint32_t slotCount);
+void destroyScope(void* scope);
+
 /**
  * Executes the given module. The function executes the bytecode at index 0
  * until the module returns. Instead of normally returning the value returned',
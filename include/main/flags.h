@@ -11,4 +11,25 @@
  */
 #define INCLUDE_TESTS 1
 
+/**
+ * Determines if executeCode dispatches instructions by jumping to the address
+ * of the next instruction's handler (computed goto, a GCC extension) instead
+ * of with a switch statement.
+ */
+#ifndef USE_COMPUTED_GOTO
+#ifdef __GNUC__
+#define USE_COMPUTED_GOTO 1
+#else
+#define USE_COMPUTED_GOTO 0
+#endif
+#endif
+
+/**
+ * Determines if compiled modules are cached in .blgc files next to their
+ * source. See cache.h.
+ */
+#ifndef USE_MODULE_CACHE
+#define USE_MODULE_CACHE 1
+#endif
+
 #endif /* FLAGS_H_ */
@@ -0,0 +1,59 @@
+#ifndef GC_H_
+#define GC_H_
+
+#include <stdint.h>
+
+#include "main/runtime.h"
+
+/**
+ * The garbage collector is a simple mark and sweep collector. Things and
+ * scopes are marked starting from the roots: the operand stack, the scopes of
+ * the stack frames, the builtins, the operators, the imported modules and the
+ * pinned things. Everything that is not marked is then freed.
+ *
+ * Collections only happen at safe points in the interpreter loop, where every
+ * live thing is reachable from the roots. Native code is never interrupted by
+ * a collection, but it may call blerg code which does collect. This is why
+ * things allocated by native code are pinned until the native code returns.
+ */
+
+/**
+ * The number of allocations before the first collection. After a collection,
+ * the threshold becomes the number of survivors if that is larger.
+ */
+#define GC_INITIAL_THRESHOLD 4096
+
+/**
+ * Pins the thing if native code is currently executing (or if no code is
+ * executing at all). Things allocated with createThing are already pinned;
+ * this is for things that are handed back to native code from blerg code.
+ */
+void pinThing(Runtime* runtime, Thing* thing);
+
+/**
+ * Marks the thing as reachable. Its children are marked later.
+ */
+void markThing(Runtime* runtime, Thing* thing);
+
+/**
+ * Marks the scope, its parents and the things bound in them as reachable.
+ */
+void markScope(Runtime* runtime, Scope* scope);
+
+/**
+ * Frees all things and scopes that are not reachable from the roots.
+ */
+void collectGarbage(Runtime* runtime);
+
+/**
+ * Collects garbage if enough allocations have been made since the last
+ * collection. Must only be called at a safe point. This is inline since the
+ * interpreter checks before every instruction.
+ */
+inline void maybeCollectGarbage(Runtime* runtime) {
+    if(runtime->allocationCount >= runtime->collectThreshold) {
+        collectGarbage(runtime);
+    }
+}
+
+#endif /* GC_H_ */
@@ -0,0 +1,29 @@
+#ifndef PEEPHOLE_H_
+#define PEEPHOLE_H_
+
+#include <stdint.h>
+
+#include "main/codegen.h"
+
+/**
+ * Simplifies the bytecode of a finished builder before builderToModule
+ * patches its labels. The pass
+ *
+ *  - retargets jumps to unconditional jumps to their final target, and turns
+ *    unconditional jumps to a return into a return,
+ *  - removes code that follows a return or an unconditional jump and is not
+ *    the target of any jump or function,
+ *  - removes unconditional jumps to the next instruction,
+ *  - removes DUP followed by POP and SWAP followed by SWAP,
+ *  - turns calls that are now directly followed by a return into tail calls.
+ *
+ * Label definitions, label references and srcLoc entries are moved along
+ * with the instructions. The srcLoc entries of removed instructions apply to
+ * the instruction that takes their place.
+ *
+ * @param entryLabel the label of the module's entry, which is kept even
+ *      though nothing jumps to it
+ */
+void optimizeBuilder(ModuleBuilder* builder, uint32_t entryLabel);
+
+#endif /* PEEPHOLE_H_ */
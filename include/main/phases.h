@@ -0,0 +1,56 @@
+#ifndef PHASES_H_
+#define PHASES_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Timings of the phases that turn source into a module and run it. While
+ * phase timing is on, sourceToModule records how long parsing, validation,
+ * each pass of the transformation and compilation took for each module,
+ * along with how many allocations were made from the token arena and how big
+ * the result is. loadModule records cache lookups and writes, and modules are
+ * timed as they are executed, including the ones loaded by libImport.
+ *
+ * Executing a module also runs the modules it imports, so the execute phase
+ * of a module includes the phases of its imports.
+ */
+
+//the value of a measurement that does not apply to a phase
+#define PHASE_UNMEASURED -1
+
+/**
+ * Starts recording phases. Any phases that were recorded before are
+ * discarded.
+ */
+void startPhaseTimes();
+
+/**
+ * Returns whether phases are being recorded.
+ */
+uint8_t timingPhases();
+
+/**
+ * Returns the current time in seconds, for measuring phases.
+ */
+double phaseClock();
+
+/**
+ * Records a phase if phases are being recorded.
+ *
+ * @param module the name of the module, or NULL if it has none. It is copied.
+ * @param phase the name of the phase. It is copied.
+ * @param allocations the number of allocations, or PHASE_UNMEASURED
+ * @param size the size of the output, or PHASE_UNMEASURED
+ * @param unit what the size counts, such as "tokens"
+ */
+void recordPhase(const char* module, const char* phase, double seconds,
+        int64_t allocations, int64_t size, const char* unit);
+
+/**
+ * Prints the recorded phases in the order they ended, followed by the total
+ * of each phase over all modules, and stops recording.
+ */
+void printPhaseTimes(FILE* file);
+
+#endif /* PHASES_H_ */
@@ -0,0 +1,57 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "main/runtime.h"
+
+/**
+ * A sampling profiler for blerg code. While profiling, a SIGPROF timer
+ * interrupts the interpreter every PROFILE_INTERVAL_US microseconds of CPU
+ * time and the call stack of the runtime is recorded. The signal handler only
+ * copies the module and instruction index of each frame into tables that are
+ * allocated up front, so samples are cheap and identical stacks are counted
+ * instead of stored again. The frames are mapped to source locations when the
+ * profile is written.
+ *
+ * Profiles are written in the folded stack format used by flamegraph tools:
+ * one line per distinct stack, with the frames from the outermost to the
+ * innermost separated by ';', followed by a space and the number of samples.
+ * Frames of blerg code are written as file:line:column and native frames as
+ * [native code].
+ */
+
+//the time between samples
+#define PROFILE_INTERVAL_US 1000
+
+//the number of distinct stacks that can be recorded
+#define PROFILE_STACKS_CAPACITY (1 << 14)
+
+//the number of frames the distinct stacks can have in total
+#define PROFILE_FRAMES_CAPACITY (1 << 18)
+
+/**
+ * Starts sampling the call stack of the runtime. Only one runtime can be
+ * profiled at a time.
+ *
+ * @return 0 if the timer could not be started
+ */
+uint8_t startProfile(Runtime* runtime);
+
+/**
+ * Stops sampling. The samples are kept until writeProfile is called.
+ */
+void stopProfile();
+
+/**
+ * Writes the samples taken since startProfile in the folded stack format and
+ * frees them. This must be called before the profiled runtime and its modules
+ * are destroyed.
+ *
+ * @return the number of samples that were dropped because the tables were
+ *      full
+ */
+uint32_t writeProfile(FILE* file);
+
+#endif /* PROFILE_H_ */
@@ -25,36 +25,111 @@ struct Scope {
     //has no parent scope.
     struct Scope* parent;
     //Map of const char* to Thing*. Represents variables bound in the current
-    //scope.
+    //scope. Only module level scopes have this map; it is NULL for the scopes
+    //of function invocations, which use slots instead.
     Map* locals;
+    //the FuncThing whose invocation this scope belongs to, or NULL for module
+    //level scopes. The function's OP_DEF_FUNC header names the slots.
+    Thing* func;
+    //Variables of function invocations are stored in an array of slots. The
+    //compiler assigns each local variable a slot. Unassigned slots are NULL.
+    Thing** slots;
+    uint32_t slotCount;
+    //set by the garbage collector if the scope is reachable
+    uint8_t marked;
 };
 
 typedef struct Scope Scope;
 
+/**
+ * Describes which symbols an object has and which slot holds the value of
+ * each. Objects that were given the same symbols in the same order share a
+ * shape, so a symbol's slot can be remembered for the shape rather than
+ * looked up in every object.
+ *
+ * Shapes form a tree whose root has no symbols. Each shape's children add one
+ * more symbol. Like symbol ids, shapes are shared by all runtimes; they are
+ * freed by deinitThing.
+ */
+struct Shape {
+    //the shape without the last symbol, or NULL for the root
+    struct Shape* parent;
+    //the last symbol, whose slot is slotCount - 1
+    uint32_t symbol;
+    uint32_t slotCount;
+    //maps each symbol id of the shape to its slot as a boxed uint32_t
+    Map* slots;
+    //maps symbol ids to the child shape that adds the symbol
+    Map* transitions;
+};
+
+typedef struct Shape Shape;
+
 /**
  * The runtime object type. This is a singleton that stores information
  * pertaining to the execution and is used in many different operations.
  */
 typedef struct {
-    //Stacks are stored as lists. The first item is the top of the stack.
-    //List of StackFrames.
-    List* stackFrame;
-    //List of stack items. There is no designated start or stop for different
-    //stackframes. So, different items pertaining to each stackFrame are just
-    //stored right after the other.
-    List* stack;
+    //Array of StackFrames; the last item is the top of the call stack. It is
+    //allocated up front with room for stackFrameLimit frames, so pointers to
+    //frames stay valid while other frames are pushed.
+    struct StackFrame_* stackFrame;
+    uint32_t stackFrameLength;
+    //the maximum call depth. Going any deeper raises a stack overflow error.
+    uint32_t stackFrameLimit;
+    //the number of executeCode invocations that are running. Native code
+    //that calls blerg code enters executeCode again, which uses the C stack,
+    //so this is limited separately from the call depth.
+    uint32_t executeDepth;
+    uint32_t executeDepthLimit;
+    //Array of stack items; the last item is the top of the stack. There is no
+    //designated start or stop for different stackframes. So, different items
+    //pertaining to each stackFrame are just stored right after the other.
+    Thing** stack;
+    uint32_t stackLength;
+    uint32_t stackCapacity;
+    //Arrays that the stack has outgrown. Native functions receive their
+    //arguments as a pointer into the stack, so the old arrays are kept around
+    //until the runtime is destroyed instead of being freed when the stack
+    //grows.
+    List* oldStacks;
     //reference to the singleton NoneThing
     Thing* noneThing;
-    //list of things that were allocated. They are deleted once the runtime
-    //is destroyed.
+    //list of things that were allocated. Unreachable things are deleted by
+    //the garbage collector and the rest once the runtime is destroyed.
     List* allocatedThings;
-    //list of allocated scopes. They are deleted once the runtime is destroyed.
+    //list of allocated scopes. They are collected like things are.
     List* allocatedScopes;
+    //Things that native code is holding onto. Native code keeps things in C
+    //variables, which the garbage collector cannot see, so anything allocated
+    //while native code runs is pinned until its native stack frame ends.
+    Thing** pinned;
+    uint32_t pinnedLength;
+    uint32_t pinnedCapacity;
+    //number of things and scopes allocated since the last collection
+    uint32_t allocationCount;
+    //a collection is done once allocationCount reaches this
+    uint32_t collectThreshold;
+    //number of things and scopes allocated since the runtime was created
+    uint64_t allocationTotal;
+    //things that have been marked but whose children have not been marked yet
+    Thing** markStack;
+    uint32_t markStackLength;
+    uint32_t markStackCapacity;
     Map* operators;
+    //the symbols of the operator opcodes, indexed by opcode - OP_ADD. They
+    //are also in operators.
+    Thing* operatorSymbols[OPERATOR_OPCODES];
     Scope* builtins;
     Map* modules;
     List* moduleBytecode;
     const char* execDir;
+    //the statistics executeCode collects, or NULL if it does not collect any.
+    //See stats.h.
+    struct ExecStats* stats;
+    //the allocations counted so far, or NULL if they are not counted. See
+    //allocs.h.
+    struct AllocStats* allocStats;
 } Runtime;
 
 typedef RetVal (*ExecFunc)(Runtime*, Thing*, Thing**, uint8_t);
@@ -78,12 +153,25 @@ extern ThingType TYPE_SYMBOL;
 extern ThingType TYPE_VARARG;
 extern ThingType TYPE_UNDEF;
 
+//the number of thing types, TYPE_UNDEF included
+#define THING_TYPES 16
+
 class Thing {
 public:
+    //set by the garbage collector if the thing is reachable
+    uint8_t marked;
+    //the result of type(), stored when the thing is created so that
+    //typeOfThing does not need a virtual call
+    ThingType thingType;
+
+    Thing() : marked(0), thingType(TYPE_UNDEF) {}
     virtual ~Thing() = 0;
     virtual RetVal call(Runtime*, Thing*, Thing**, uint8_t) = 0;
     virtual RetVal dispatch(Runtime*, Thing*, Thing**, uint8_t) = 0;
     virtual ThingType type() = 0;
+    //marks the things and scopes this thing references. Things that do not
+    //reference others do not need to override this.
+    virtual void markChildren(Runtime*);
 };
 
 RetVal throwMsg(Runtime* runtime, const char* msg);
@@ -92,14 +180,16 @@ Thing* createErrorThing(Runtime* runtime, const char* msg);
 typedef struct {
     //the module that is currently executing.
     Module* module;
-    //the current bytecode index
+    //the index of the current instruction in module->code
     uint32_t index;
     //the current scope
     Scope* scope;
 } StackFrameDef;
 
 typedef struct {
-    char dummy;
+    //the value of runtime->pinnedLength when the frame was created. Things
+    //pinned after that are unpinned when the frame ends.
+    uint32_t pinnedLength;
 } StackFrameNative;
 
 typedef enum {
@@ -116,7 +206,7 @@ typedef enum {
  * for native code. The blerg code type keeps track of the execution state,
  * while the native code type simply denotes that native code is being executed.
  */
-typedef struct {
+typedef struct StackFrame_ {
     STACK_FRAME_TYPE type;
     union {
         StackFrameDef def;
@@ -124,4 +214,16 @@ typedef struct {
     };
 } StackFrame;
 
+/**
+ * The maximum call depth of a new runtime.
+ */
+#define DEFAULT_STACK_FRAME_LIMIT 65536
+
+/**
+ * The maximum number of nested executeCode invocations of a new runtime.
+ * Each one takes a few kilobytes of C stack at most, so this fits in the
+ * usual 8MB stack even with sanitizers.
+ */
+#define DEFAULT_EXECUTE_DEPTH_LIMIT 1000
+
 #endif /* RUNTIME_HPP_ */
@@ -0,0 +1,73 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "main/bytecode.h"
+#include "main/runtime.h"
+
+/**
+ * Execution statistics, collected by executeCode while runtime->stats is
+ * set. executeCode is instantiated separately for counting, so runtimes
+ * without statistics do not check for them as they run.
+ */
+
+//how many of the most frequent opcode pairs and functions are reported
+#define STATS_REPORTED 20
+
+typedef struct {
+    //the module and the index in its code of the function's first
+    //instruction, or the module's entry for module level code
+    const Module* module;
+    uint32_t index;
+    //the number of calls, or zero if the entry is unused
+    uint64_t count;
+} StatsFunc;
+
+struct ExecStats {
+    uint64_t opcodes[OPCODES];
+    //indexed by the previous opcode and then the opcode. The previous opcode
+    //of the first instruction is OPCODES.
+    uint64_t pairs[OPCODES + 1][OPCODES];
+    uint8_t previous;
+    //indexed by the type of the called thing
+    uint64_t callees[THING_TYPES];
+    //indexed by the type of the receiver of called symbols
+    uint64_t receivers[THING_TYPES];
+    //the functions that have been entered, an open addressing hash table with
+    //linear probing. funcsCapacity is a power of two.
+    StatsFunc* funcs;
+    uint32_t funcsLength;
+    uint32_t funcsCapacity;
+};
+
+typedef struct ExecStats ExecStats;
+
+ExecStats* createExecStats();
+void destroyExecStats(ExecStats* stats);
+
+inline void countOpcode(ExecStats* stats, uint8_t opcode) {
+    stats->opcodes[opcode]++;
+    stats->pairs[stats->previous][opcode]++;
+    stats->previous = opcode;
+}
+
+/**
+ * Counts a call of the thing with the given arguments.
+ */
+void countCall(ExecStats* stats, Thing* callee, Thing** args, uint8_t arity);
+
+/**
+ * Counts the start of a function, whose first instruction is at the given
+ * index of the module's code.
+ */
+void countFunc(ExecStats* stats, const Module* module, uint32_t index);
+
+/**
+ * Prints the statistics. This must be done before the modules that were
+ * executed are destroyed.
+ */
+void printExecStats(ExecStats* stats, FILE* file);
+
+#endif /* STATS_H_ */
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "main/execute.h"
 #include "main/runtime.h"
@@ -22,19 +23,93 @@ void deinitThing();
 
 void destroyThing(Thing* thing);
 
-Thing* createIntThing(Runtime* runtime, int32_t value);
-Thing* createFloatThing(Runtime* runtime, float value);
+/**
+ * Ints, floats, bools and none are immediate: they are not allocated, but
+ * stored in the Thing* itself. The lowest byte of an immediate is its tag and
+ * the upper 32 bits are its value. Allocated things are aligned, so the lowest
+ * bit of their pointers is never set, while it is set in every tag.
+ */
+static_assert(sizeof(uintptr_t) >= 8, "immediate things need 64 bit pointers");
 
-Thing* createStrThing(Runtime* runtime, const char* value, uint8_t literal);
+#define THING_TAG_MASK 0xff
+#define THING_TAG_INT 0x01
+#define THING_TAG_FLOAT 0x03
+#define THING_TAG_BOOL 0x05
+#define THING_TAG_NONE 0x07
+
+inline uint8_t isThingImmediate(Thing* thing) {
+    return (uintptr_t) thing & 1;
+}
+
+inline Thing* createImmediateThing(uintptr_t tag, uint32_t value) {
+    return (Thing*) (((uintptr_t) value << 32) | tag);
+}
+
+inline uint32_t immediateThingValue(Thing* thing) {
+    return (uint32_t) ((uintptr_t) thing >> 32);
+}
+
+inline Thing* createIntThing(Runtime* runtime, int32_t value) {
+    (void) runtime;
+    return createImmediateThing(THING_TAG_INT, (uint32_t) value);
+}
+
+inline Thing* createFloatThing(Runtime* runtime, float value) {
+    (void) runtime;
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return createImmediateThing(THING_TAG_FLOAT, bits);
+}
+
+inline Thing* createBoolThing(Runtime* runtime, uint8_t value) {
+    (void) runtime;
+    return createImmediateThing(THING_TAG_BOOL, value != 0);
+}
 
-Thing* createBoolThing(Runtime* runtime, uint8_t value);
-uint8_t thingAsBool(Thing* thing);
+inline Thing* createNoneThing(Runtime* runtime) {
+    (void) runtime;
+    return createImmediateThing(THING_TAG_NONE, 0);
+}
+
+inline uint8_t thingAsBool(Thing* thing) {
+    return (uint8_t) immediateThingValue(thing);
+}
 
 /**
  * Returns the integer value of the given IntThing. If the thing is not an
  * IntThing, this results in undefined behavior.
  */
-int32_t thingAsInt(Thing* thing);
+inline int32_t thingAsInt(Thing* thing) {
+    return (int32_t) immediateThingValue(thing);
+}
+
+/**
+ * Returns the value of the given FloatThing. If the thing is not a
+ * FloatThing, this results in undefined behavior.
+ */
+inline float thingAsFloat(Thing* thing) {
+    uint32_t bits = immediateThingValue(thing);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * Returns the thing whose methods implement the given thing's behavior. This
+ * is the thing itself unless it is immediate, in which case it is a shared
+ * instance for its type. Use this instead of calling methods on things
+ * directly.
+ */
+Thing* thingBehavior(Thing* thing);
+
+Thing* createStrThing(Runtime* runtime, const char* value, uint8_t literal);
+
+/**
+ * Creates a StrThing for a literal that is not owned by any runtime, so that
+ * it can be shared by every execution of a module. The garbage collector
+ * never frees it; it must be freed with destroyThing.
+ */
+Thing* createLiteralStrThing(const char* value);
 
 const char* thingAsStr(Thing* thing);
 
@@ -48,13 +123,35 @@ Thing* getModuleProperty(Thing* thing, const char* name);
  * Returns the type of the given thing. Use this to check its type before
  * passing it to functions which require a certain type.
  */
-ThingType typeOfThing(Thing* thing);
+inline ThingType typeOfThing(Thing* thing) {
+    if(!isThingImmediate(thing)) {
+        return thing->thingType;
+    }
+    switch((uintptr_t) thing & THING_TAG_MASK) {
+    case THING_TAG_INT:
+        return TYPE_INT;
+    case THING_TAG_FLOAT:
+        return TYPE_FLOAT;
+    case THING_TAG_BOOL:
+        return TYPE_BOOL;
+    default:
+        return TYPE_NONE;
+    }
+}
 
 unsigned int getFuncEntry(Thing*);
 Module* getFuncModule(Thing*);
 Scope* getFuncParentScope(Thing*);
-
-Thing* createNoneThing(Runtime* runtime);
+Thing** getFuncCaptured(Thing*);
+/**
+ * Sets how many of the function's captured values are still NULL. Once none
+ * are, the function drops the scopes between it and the module level scope.
+ */
+void setFuncUnresolved(Thing* func, uint32_t unresolved);
+/**
+ * Stores a captured value that was not assigned when the function was created.
+ */
+void resolveFuncCaptured(Thing* func, uint32_t index, Thing* value);
 
 extern uint32_t SYM_ADD;
 extern uint32_t SYM_SUB;
@@ -78,9 +175,14 @@ extern uint32_t SYM_UNPACK;
 Thing* createSymbolThing(Runtime* runtime, uint32_t id, uint8_t arity);
 uint32_t newSymbolId();
 uint32_t getSymbolId(Thing* symbol);
+uint8_t getSymbolArity(Thing* symbol);
 
+/**
+ * Creates a function. Its capturedCount captured values start out NULL and are
+ * filled in through getFuncCaptured.
+ */
 Thing* createFuncThing(Runtime* runtime, uint32_t entry,
-        Module* module, Scope* parentScope);
+        Module* module, Scope* parentScope, uint32_t capturedCount);
 
 Thing* createModuleThing(Runtime* runtime, Map* map);
 
@@ -98,8 +200,42 @@ Thing* getListTail(Thing*);
 
 Thing* createListThing(Runtime* runtime, Thing* head, Thing* tail);
 
-Thing* createObjectThing(Runtime* runtime, Map* map);
-Map* getObjectMap(Thing* object);
+/**
+ * Creates an object. The object takes the slots array, which holds the value
+ * of each of the shape's slots.
+ */
+Thing* createObjectThing(Runtime* runtime, Shape* shape, Thing** slots);
+Shape* getObjectShape(Thing* object);
+Thing** getObjectSlots(Thing* object);
+
+/**
+ * Returns the object's value for the symbol with the given id, or NULL if the
+ * object does not have the symbol.
+ */
+Thing* getObjectProperty(Thing* object, uint32_t symbol);
+
+/**
+ * Returns the shape of objects without any symbols.
+ */
+Shape* emptyShape();
+
+/**
+ * Returns the shape of objects with the given shape's symbols followed by the
+ * given symbol, which must not be in the shape already.
+ */
+Shape* addShapeSymbol(Shape* shape, uint32_t symbol);
+
+/**
+ * Sets slot to the slot of the symbol in objects of the given shape.
+ *
+ * @return 0 if objects of the shape do not have the symbol
+ */
+uint8_t findShapeSlot(Shape* shape, uint32_t symbol, uint32_t* slot);
+
+/**
+ * Frees every shape. Called by deinitThing.
+ */
+void destroyShapes();
 
 Thing* createCellThing(Runtime* runtime, Thing* value);
 Thing* getCellValue(Thing* cell);
@@ -110,9 +246,57 @@ RetVal typeCheck(Runtime* runtime, Thing* self, Thing** args, uint8_t arity,
 
 void destroySimpleThing(Thing* thing);
 RetVal errorCall(Runtime* runtime, Thing* thing, Thing** args, uint8_t arity);
-Thing* createThing(Runtime* runtime, Thing* type);
+/**
+ * Creates a thing from one that was just allocated with new. The thing is
+ * destroyed once the garbage collector finds it unreachable, or when the
+ * runtime is destroyed.
+ *
+ * @param size the number of bytes the thing takes up, including the buffers
+ *      it owns. This is only used for allocation statistics.
+ */
+Thing* createThingSized(Runtime* runtime, Thing* thing, size_t size);
+
+/**
+ * Like createThingSized, for things that do not own any buffers.
+ */
+template<typename T>
+inline Thing* createThing(Runtime* runtime, T* thing) {
+    return createThingSized(runtime, thing, sizeof(T));
+}
+
+/**
+ * Returns the name of the type, such as "int" for TYPE_INT.
+ */
+const char* thingTypeName(ThingType type);
 
 RetVal symbolDispatch(Runtime*, Thing*, Thing**, uint8_t);
+
+/**
+ * Sets the function that handles the symbol with the given id when it is sent
+ * to things of the given type. Only the symbols created by initThing can have
+ * handlers.
+ */
+void setSymbolHandler(ThingType type, uint32_t symbol, ExecFunc handler);
+
+/**
+ * Returns the function that handles the symbol with the given id for things of
+ * the given type, or NULL if they do not respond to it.
+ */
+ExecFunc getSymbolHandler(ThingType type, uint32_t symbol);
+
+/**
+ * Sends the symbol self to args[0], whose type is given, through the type's
+ * handlers. Throws error if the type does not respond to the symbol.
+ */
+RetVal handlerDispatch(Runtime* runtime, ThingType type, Thing* self,
+        Thing** args, uint8_t arity, const char* error);
+
+/**
+ * Handles responds_to for types with handlers. args[0] responds to the symbol
+ * args[1] if its type has a handler for it.
+ */
+RetVal respondsToHandler(Runtime* runtime, Thing* self, Thing** args,
+        uint8_t arity);
 RetVal callFail(Runtime* runtime);
 
 #endif /* THING_H_ */
@@ -3,11 +3,10 @@
 
 #include "main/runtime.h"
 
+//bools are immediate; this class only implements their behavior
 class BoolThing : public Thing {
 public:
-    uint8_t value;
-
-    BoolThing(uint8_t value);
+    BoolThing();
     ~BoolThing();
 
     RetVal call(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
@@ -15,4 +14,9 @@ public:
     ThingType type();
 };
 
+/**
+ * Sets the handlers of the symbols bools respond to. Called by initThing.
+ */
+void initBoolHandlers();
+
 #endif /* THING_BOOL_H_ */
@@ -11,6 +11,7 @@ public:
     RetVal call(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
     RetVal dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
     ThingType type();
+    void markChildren(Runtime* runtime);
 };
 
 #endif /* THING_CELL_H_ */
@@ -3,11 +3,10 @@
 
 #include "main/runtime.h"
 
+//floats are immediate; this class only implements their behavior
 class FloatThing : public Thing {
 public:
-    float value;
-
-    FloatThing(float value);
+    FloatThing();
     ~FloatThing();
 
     RetVal call(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
@@ -15,5 +14,9 @@ public:
     ThingType type();
 };
 
+/**
+ * Sets the handlers of the symbols floats respond to. Called by initThing.
+ */
+void initFloatHandlers();
 
 #endif /* THING_FLOAT_H_ */
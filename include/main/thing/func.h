@@ -9,15 +9,26 @@ public:
     unsigned int entry;
     //module the function was declared in
     Module* module;
-    //the scope the function was declared in
+    //the scope the function was declared in. Once every captured value is
+    //known, only the module level scope is kept, so that the function does not
+    //keep the scopes of the functions that created it alive.
     Scope* parentScope;
+    //values of the variables the function captures, in the order given by the
+    //function's OP_DEF_FUNC header. Values that were not yet assigned when the
+    //function was created are NULL until they are first used.
+    Thing** captured;
+    uint32_t capturedCount;
+    //the number of captured values that are still NULL
+    uint32_t unresolved;
 
-    FuncThing(unsigned int entry, Module* module, Scope* parentScope);
+    FuncThing(unsigned int entry, Module* module, Scope* parentScope,
+            uint32_t capturedCount);
     ~FuncThing();
 
     RetVal call(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
     RetVal dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
     ThingType type();
+    void markChildren(Runtime* runtime);
 };
 
 #endif /* THING_FUNC_H_ */
@@ -5,11 +5,10 @@
 
 #include "main/runtime.h"
 
+//ints are immediate; this class only implements their behavior
 class IntThing : public Thing {
 public:
-    int32_t value;
-
-    IntThing(int32_t value);
+    IntThing();
     ~IntThing();
 
     RetVal call(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
@@ -17,4 +16,9 @@ public:
     ThingType type();
 };
 
+/**
+ * Sets the handlers of the symbols ints respond to. Called by initThing.
+ */
+void initIntHandlers();
+
 #endif /* THING_INT_H_ */
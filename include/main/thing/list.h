@@ -14,6 +14,7 @@ public:
     RetVal call(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
     RetVal dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
     ThingType type();
+    void markChildren(Runtime* runtime);
 };
 
 #endif /* THING_LIST_H_ */
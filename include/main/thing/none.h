@@ -4,6 +4,7 @@
 #include "main/runtime.h"
 #include "main/thing.h"
 
+//none is immediate; this class only implements its behavior
 class NoneThing : public Thing {
 public:
     NoneThing();
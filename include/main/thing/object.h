@@ -5,14 +5,18 @@
 
 class ObjectThing : public Thing {
 public:
-    Map* map;
+    //which symbols the object has and the slot of each
+    Shape* shape;
+    //the value of each of the shape's slots
+    Thing** slots;
 
-    ObjectThing(Map* map);
+    ObjectThing(Shape* shape, Thing** slots);
     ~ObjectThing();
 
     RetVal call(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
     RetVal dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
     ThingType type();
+    void markChildren(Runtime* runtime);
 };
 
 #endif /* THING_OBJECT_H_ */
@@ -16,4 +16,9 @@ public:
     ThingType type();
 };
 
+/**
+ * Sets the handlers of the symbols strs respond to. Called by initThing.
+ */
+void initStrHandlers();
+
 #endif /* THING_STR_H_ */
@@ -14,6 +14,12 @@ public:
     RetVal call(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
     RetVal dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_t arity);
     ThingType type();
+    void markChildren(Runtime* runtime);
 };
 
+/**
+ * Sets the handlers of the symbols tuples respond to. Called by initThing.
+ */
+void initTupleHandlers();
+
 #endif /* THING_TUPLE_H_ */
@@ -58,9 +58,13 @@ typedef struct Token* (*CopyVisitor)(struct Token*, void*);
 class Token {
 public:
     SrcLoc location;
+    //whether the token was allocated from the token arena
+    uint8_t inArena;
 
-    Token(SrcLoc location) : location(location) {}
+    Token(SrcLoc location);
     virtual ~Token() {};
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
     virtual TokenType type() = 0;
     virtual void print(uint8_t) = 0;
     virtual uint8_t equals(Token*) = 0;
@@ -293,6 +297,9 @@ public:
     IdentifierToken* name;
     List* args;
     BlockToken* body;
+    //list of IdentifierTokens naming the variables that the function uses
+    //from enclosing functions. This is filled in by transformCaptures.
+    List* captured;
 
     FuncToken(SrcLoc loc, IdentifierToken* name, List* args, BlockToken* body);
     ~FuncToken();
@@ -306,6 +313,8 @@ IdentifierToken* getFuncTokenName(FuncToken* token);
 void setFuncTokenName(FuncToken* token, IdentifierToken* name);
 List* getFuncTokenArgs(FuncToken* token);
 BlockToken* getFuncTokenBody(FuncToken* token);
+List* getFuncTokenCaptured(FuncToken* token);
+void setFuncTokenCaptured(FuncToken* token, List* captured);
 
 class ReturnToken : public Token {
 public:
@@ -514,16 +523,53 @@ void printToken(Token* token);
 void printIndent(uint8_t indent);
 
 /**
- * Frees the token, its fields and subtokens.
+ * Sets the arena that tokens are allocated from, or NULL to allocate each
+ * token separately. While an arena is set, new tokens take the strings and
+ * lists passed to them and move them into the arena. Tokens in an arena, along
+ * with everything they own, are only freed when the arena is destroyed.
+ */
+void setTokenArena(Arena* arena);
+
+/**
+ * Returns the arena set by setTokenArena, or NULL if there is none.
+ */
+Arena* getTokenArena();
+
+/**
+ * Like sliceStr, but the string is allocated from the token arena if one is
+ * set. Tokens take such strings without copying them.
+ */
+char* sliceTokenStr(const char* str, uint32_t start, uint32_t end);
+
+/**
+ * Like consList, but the cell is allocated from the token arena if one is set.
+ * Tokens do not need to copy such lists into the arena.
+ */
+List* consTokenList(void* head, List* tail);
+
+/**
+ * Like destroyList, but for lists made with consTokenList.
+ */
+void destroyTokenList(List* list, void(*func)(void*));
+
+/**
+ * Frees the token, its fields and subtokens. Does nothing for tokens in an
+ * arena.
  */
 void destroyToken(Token* token);
 void destroyTokenVoid(void*);
 void destroyIfBranch(void*);
 
 uint8_t tokensEqual(Token* a, Token* b);
+uint8_t tokensEqualVoid(void* a, void* b);
 
 Token* copyToken(Token*, CopyVisitor, void*);
 
+/**
+ * Copies each token in the list with the visitor, in order.
+ */
+List* copyTokenList(List* old, CopyVisitor visitor, void* data);
+
 #if INCLUDE_TESTS
 IntToken* createIntToken(SrcLoc, int32_t);
 FloatToken* createFloatToken(SrcLoc, float);
@@ -27,6 +27,21 @@ char* readFile(const char* filename);
 
 Module* sourceToModule(const char* name, const char* src, char** error);
 
+/**
+ * Like sourceToModule, but loads the module from the cache of the source file
+ * at path if it is up to date. Otherwise the module is compiled and the cache
+ * is rewritten.
+ */
+Module* loadModule(const char* path, const char* src, char** error);
+
+/**
+ * Transforms the source and prints how many tokens each pass of
+ * transformModule produced and how long it took.
+ *
+ * @return whether the source parsed
+ */
+uint8_t printTransformStats(const char* src);
+
 ExecFuncOut execFunc(ExecFuncIn in);
 void cleanupExecFunc(ExecFuncIn in, ExecFuncOut out);
 
@@ -3,7 +3,10 @@
 
 #include "main/tokens.h"
 
+#include <stdint.h>
+
 BlockToken* transformControlToJumps(BlockToken* module);
+BlockToken* transformListToCons(BlockToken* module);
 BlockToken* transformFlattenBlocks(BlockToken* module);
 Token* transformObjectDesugar(Token* module);
 Token* transformDestructure(Token* module);
@@ -16,4 +19,34 @@ Token* transformFuncAssignToName(Token* module);
  */
 BlockToken* transformModule(BlockToken* module);
 
+/**
+ * transformModule makes two passes over the AST. The first (lower) rewrites
+ * closures, lists, control structures, assignments and objects into simpler
+ * tokens. The second (functions) flattens blocks, creates $init and records
+ * the variables each function captures.
+ */
+#define TRANSFORM_PASSES 2
+
+typedef struct {
+    const char* name;
+    //the number of tokens in the output of the pass
+    uint32_t tokens;
+    //how long the pass took
+    double seconds;
+    //the number of allocations the pass made from the token arena, or zero
+    //if there is no arena
+    uint64_t allocations;
+} TransformPassStats;
+
+/**
+ * Like transformModule, but also fills in stats for each pass.
+ */
+BlockToken* transformModuleStats(BlockToken* module,
+        TransformPassStats stats[TRANSFORM_PASSES]);
+
+/**
+ * Returns the number of tokens in the tree.
+ */
+uint32_t countTokens(Token* token);
+
 #endif /* TRANSFORM_H_ */
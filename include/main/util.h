@@ -2,6 +2,7 @@
 #define UTIL_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
 /**
  * Copies the given string
@@ -81,17 +82,31 @@ List* reverseList(List* list);
 /**
  * Internal data structure for maps
  */
-typedef struct Entry_ {
-    struct Entry_* tail;
-    void* key;
+typedef struct {
+    //the hash of the key, or zero if the entry is unused
+    uint32_t hash;
+    union {
+        //the key of maps with string keys
+        void* key;
+        //the key of maps with integer keys
+        uint32_t num;
+    };
     void* value;
 } Entry;
 
 /**
  * The map type. Unlike lists, operations on maps mutate the map.
+ *
+ * Maps are open addressing hash tables with linear probing. A map either has
+ * string keys or integer keys; the two kinds of functions must not be mixed on
+ * the same map. Entries cannot be removed.
  */
 typedef struct {
-    Entry* entry;
+    //array of capacity entries. capacity is zero or a power of two.
+    Entry* entries;
+    uint32_t capacity;
+    //the number of used entries
+    uint32_t length;
 } Map;
 
 Map* createMap();
@@ -118,6 +133,61 @@ void* getMapStr(Map* map, const char* key);
 //holds the reference to key passed to putMap
 void putMapStr(Map* map, const char* key, void* value);
 
+/**
+ * Returns the hash of the string. Use it with getMapStrHashed and
+ * putMapStrHashed to avoid rehashing strings which are looked up repeatedly.
+ */
+uint32_t hashStr(const char* str);
+
+/**
+ * Like getMapStr and putMapStr, but hash must be hashStr(key).
+ */
+void* getMapStrHashed(Map* map, const char* key, uint32_t hash);
+void putMapStrHashed(Map* map, const char* key, uint32_t hash, void* value);
+
+/**
+ * Returns the first used entry of the map, or NULL if the map is empty.
+ * Together with nextEntryMap this iterates over the map in no particular
+ * order. The map must not be modified while iterating.
+ */
+Entry* firstEntryMap(Map* map);
+
+/**
+ * Returns the used entry after the given one, or NULL if there is none.
+ */
+Entry* nextEntryMap(Map* map, Entry* entry);
+
+typedef struct ArenaChunk_ ArenaChunk;
+
+/**
+ * A region of memory that objects are allocated from one after another.
+ * Objects in an arena cannot be freed individually; destroying the arena frees
+ * all of them at once.
+ */
+typedef struct {
+    //the chunk being allocated from, followed by the full chunks
+    ArenaChunk* chunks;
+    //the number of allocations made from the arena so far
+    uint64_t allocations;
+} Arena;
+
+Arena* createArena();
+
+/**
+ * Returns size bytes of memory from the arena, aligned for any type.
+ */
+void* allocArena(Arena* arena, size_t size);
+
+/**
+ * Returns whether the memory was allocated from the arena.
+ */
+uint8_t containsArena(Arena* arena, const void* ptr);
+
+/**
+ * Frees the arena and everything allocated from it.
+ */
+void destroyArena(Arena* arena);
+
 /**
  * Allocates memory that holds the given integer value. Useful for storing an
  * integer where a pointer is expected.
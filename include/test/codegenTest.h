@@ -4,5 +4,9 @@
 const char* codegenTestSimple();
 const char* codegenTestJumps();
 const char* codegenTestLiteralUnaryOp();
+const char* codegenTestTranslate();
+const char* codegenTestCache();
+const char* codegenTestManyConstants();
+const char* codegenTestPeephole();
 
 #endif /* CODEGENTEST_H_ */
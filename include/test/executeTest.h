@@ -23,5 +23,19 @@ const char* executeTestAssignment();
 const char* executeTestWhileLoop();
 const char* executeTestNativeFunc();
 const char* executeTestRecFunc();
+const char* executeTestGarbageCollection();
+const char* executeTestStackOverflow();
+const char* executeTestImmediateThings();
+const char* executeTestLiteralThings();
+const char* executeTestTailCall();
+const char* executeTestCallCache();
+const char* executeTestClosureScope();
+const char* executeTestObjectShapes();
+const char* executeTestSymbolHandlers();
+const char* executeTestProfile();
+const char* executeTestProfileDeep();
+const char* executeTestStats();
+const char* executeTestAllocStats();
+const char* executeTestPhaseTimes();
 
 #endif /* EXECUTETEST_H_ */
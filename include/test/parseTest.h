@@ -19,5 +19,6 @@ const char* parseTestFloat();
 const char* parseTestTuple();
 const char* parseTestCons();
 const char* parseTestObject();
+const char* parseTestArena();
 
 #endif /* PARSETEST_H_ */
@@ -4,5 +4,6 @@
 const char* transformTestControlToJumps();
 const char* transformationTestObjectDesugar();
 const char* transformationTestDestructureTuple();
+const char* transformTestCaptures();
 
 #endif /* TRANSFORMTEST_H_ */
@@ -0,0 +1,7 @@
+#ifndef UTILTEST_H_
+#define UTILTEST_H_
+
+const char* utilTestMapStr();
+const char* utilTestMapUint32();
+
+#endif /* UTILTEST_H_ */
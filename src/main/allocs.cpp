@@ -0,0 +1,211 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "main/util.h"
+#include "main/thing.h"
+#include "main/gc.h"
+#include "main/allocs.h"
+
+AllocStats* createAllocStats() {
+    AllocStats* stats = (AllocStats*) calloc(1, sizeof(AllocStats));
+    stats->sitesCapacity = 64;
+    stats->sites = (AllocSite*) calloc(stats->sitesCapacity,
+            sizeof(AllocSite));
+    return stats;
+}
+
+void destroyAllocStats(AllocStats* stats) {
+    free(stats->sites);
+    free(stats);
+}
+
+/**
+ * Returns the entry of the site in the table, or the unused entry where it
+ * belongs.
+ */
+static AllocSite* findSite(AllocSite* sites, uint32_t capacity,
+        const Module* module, uint32_t index, uint32_t type) {
+    //FNV-1a over the module, the index and the type
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ (uint32_t) (uintptr_t) module) * 16777619u;
+    hash = (hash ^ index) * 16777619u;
+    hash = (hash ^ type) * 16777619u;
+
+    uint32_t mask = capacity - 1;
+    for(uint32_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        AllocSite* site = &sites[slot];
+        if(site->count == 0 || (site->module == module &&
+                site->index == index && site->type == type)) {
+            return site;
+        }
+    }
+}
+
+void countAlloc(Runtime* runtime, uint32_t type, size_t size) {
+    AllocStats* stats = runtime->allocStats;
+    stats->counts[type]++;
+    stats->bytes[type] += size;
+
+    //native frames are attributed to the blerg code that called them
+    const Module* module = NULL;
+    uint32_t index = 0;
+    for(uint32_t i = runtime->stackFrameLength; i > 0; i--) {
+        StackFrame* frame = &runtime->stackFrame[i - 1];
+        if(frame->type == STACK_FRAME_DEF) {
+            module = frame->def.module;
+            index = frame->def.index;
+            break;
+        }
+    }
+
+    //the table is kept at most half full
+    if(stats->sitesLength * 2 >= stats->sitesCapacity) {
+        uint32_t capacity = stats->sitesCapacity * 2;
+        AllocSite* sites = (AllocSite*) calloc(capacity, sizeof(AllocSite));
+        for(uint32_t i = 0; i < stats->sitesCapacity; i++) {
+            AllocSite* site = &stats->sites[i];
+            if(site->count != 0) {
+                *findSite(sites, capacity, site->module, site->index,
+                        site->type) = *site;
+            }
+        }
+        free(stats->sites);
+        stats->sites = sites;
+        stats->sitesCapacity = capacity;
+    }
+
+    AllocSite* site = findSite(stats->sites, stats->sitesCapacity, module,
+            index, type);
+    if(site->count == 0) {
+        site->module = module;
+        site->index = index;
+        site->type = type;
+        stats->sitesLength++;
+    }
+    site->count++;
+    site->bytes += size;
+}
+
+typedef struct {
+    //freed once the row is printed
+    char* name;
+    uint64_t count;
+    uint64_t bytes;
+} AllocRow;
+
+static int compareRows(const void* a, const void* b) {
+    uint64_t bytesA = ((const AllocRow*) a)->bytes;
+    uint64_t bytesB = ((const AllocRow*) b)->bytes;
+    //the rows with the most bytes come first
+    return (bytesA < bytesB) - (bytesA > bytesB);
+}
+
+/**
+ * Prints at most limit of the rows, from the most bytes to the least, and
+ * frees their names.
+ */
+static void printRows(FILE* file, const char* title, AllocRow* rows,
+        uint32_t length, uint32_t limit) {
+    qsort(rows, length, sizeof(AllocRow), compareRows);
+    fprintf(file, "%s\n", title);
+    for(uint32_t i = 0; i < length; i++) {
+        if(i < limit) {
+            fprintf(file, "    %-40s %12llu %14llu\n", rows[i].name,
+                    (unsigned long long) rows[i].count,
+                    (unsigned long long) rows[i].bytes);
+        }
+        free(rows[i].name);
+    }
+}
+
+static const char* allocTypeName(uint32_t type) {
+    return type == ALLOC_SCOPE ? "scope" : thingTypeName(type);
+}
+
+void printAllocStats(Runtime* runtime, FILE* file) {
+    AllocStats* stats = runtime->allocStats;
+
+    //different instructions on the same line have the same name, so their
+    //sites are merged
+    Map* merged = createMap();
+    for(uint32_t i = 0; i < stats->sitesCapacity; i++) {
+        AllocSite* site = &stats->sites[i];
+        if(site->count == 0) {
+            continue;
+        }
+
+        char* name;
+        if(site->module == NULL) {
+            name = (char*) formatStr("[native code] %s",
+                    allocTypeName(site->type));
+        } else {
+            SrcLoc location = findSrcLoc(site->module, site->index);
+            const char* moduleName = site->module->name;
+            name = (char*) formatStr("%s:%i:%i %s",
+                    moduleName == NULL ? "[unknown]" : moduleName,
+                    location.line, location.column, allocTypeName(site->type));
+        }
+
+        AllocRow* row = (AllocRow*) getMapStr(merged, name);
+        if(row == NULL) {
+            row = (AllocRow*) malloc(sizeof(AllocRow));
+            row->name = name;
+            row->count = 0;
+            row->bytes = 0;
+            putMapStr(merged, name, row);
+        } else {
+            free(name);
+        }
+        row->count += site->count;
+        row->bytes += site->bytes;
+    }
+
+    AllocRow* rows = (AllocRow*) malloc(sizeof(AllocRow) *
+            (stats->sitesLength + ALLOC_TYPES));
+    uint32_t length = 0;
+    for(Entry* entry = firstEntryMap(merged); entry != NULL;
+            entry = nextEntryMap(merged, entry)) {
+        rows[length++] = *(AllocRow*) entry->value;
+    }
+    //the names are now owned by the rows
+    destroyMap(merged, nothing, free);
+    printRows(file, "allocation sites:", rows, length, ALLOC_REPORTED);
+
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    length = 0;
+    for(uint32_t i = 0; i < ALLOC_TYPES; i++) {
+        if(stats->counts[i] != 0) {
+            rows[length].name = newStr(allocTypeName(i));
+            rows[length].count = stats->counts[i];
+            rows[length].bytes = stats->bytes[i];
+            count += stats->counts[i];
+            bytes += stats->bytes[i];
+            length++;
+        }
+    }
+    fprintf(file, "allocations: %llu, bytes: %llu\n",
+            (unsigned long long) count, (unsigned long long) bytes);
+    printRows(file, "types:", rows, length, ALLOC_TYPES);
+    free(rows);
+
+    collectGarbage(runtime);
+    uint64_t live[ALLOC_TYPES];
+    memset(live, 0, sizeof(live));
+    for(List* node = runtime->allocatedThings; node != NULL;
+            node = node->tail) {
+        live[typeOfThing((Thing*) node->head)]++;
+    }
+    for(List* node = runtime->allocatedScopes; node != NULL;
+            node = node->tail) {
+        live[ALLOC_SCOPE]++;
+    }
+    fprintf(file, "live at exit:\n");
+    for(uint32_t i = 0; i < ALLOC_TYPES; i++) {
+        if(live[i] != 0) {
+            fprintf(file, "    %-40s %12llu\n", allocTypeName(i),
+                    (unsigned long long) live[i]);
+        }
+    }
+}
@@ -1,4 +1,7 @@
+#include <stdlib.h>
+
 #include "main/bytecode.h"
+#include "main/thing.h"
 
 BytecodeSrcLoc createBytecodeSrcLoc(uint32_t index, SrcLoc location) {
     BytecodeSrcLoc srcLoc;
@@ -6,3 +9,550 @@ BytecodeSrcLoc createBytecodeSrcLoc(uint32_t index, SrcLoc location) {
     srcLoc.location = location;
     return srcLoc;
 }
+
+/**
+ * Reads a big endian operand at the given index in the bytecode.
+ */
+uint32_t readOperand(const unsigned char* bytecode, uint32_t index) {
+    return ((uint32_t) bytecode[index] << 24) |
+            ((uint32_t) bytecode[index + 1] << 16) |
+            ((uint32_t) bytecode[index + 2] << 8) |
+            (uint32_t) bytecode[index + 3];
+}
+
+/**
+ * Sets the instruction's operand to the constant at the given index in the
+ * bytecode.
+ */
+void decodeConstant(Module* module, Instruction* instr, uint32_t index) {
+    uint32_t constant = readOperand(module->bytecode, index);
+    instr->arg.str = module->constants[constant];
+    instr->extra = module->constantHashes[constant];
+}
+
+uint32_t instructionSize(const unsigned char* bytecode, uint32_t index) {
+    switch(bytecode[index]) {
+        case OP_PUSH_INT:
+        case OP_PUSH_FLOAT:
+        case OP_CALL:
+        case OP_TAIL_CALL:
+        case OP_LOAD_LOCAL:
+        case OP_STORE_LOCAL:
+        case OP_LOAD_CAPTURED:
+        case OP_COND_JUMP_TRUE:
+        case OP_COND_JUMP_FALSE:
+        case OP_ABS_JUMP:
+        case OP_PUSH_BUILTIN:
+        case OP_PUSH_LITERAL:
+        case OP_LOAD:
+        case OP_STORE:
+            return 5;
+        case OP_CREATE_FUNC:
+            return 9 + readOperand(bytecode, index + 5) * 5;
+        case OP_DEF_FUNC: {
+            uint32_t slotNum = readOperand(bytecode, index + 2);
+            uint32_t capturedNum = readOperand(bytecode, index + 6 + slotNum * 4);
+            return 10 + slotNum * 4 + capturedNum * 4;
+        }
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Decodes the instruction at the given index of the bytecode.
+ *
+ * @param instr where to store the instruction. This may be NULL if only the
+ *      sizes are needed.
+ * @param size set to the number of bytes the instruction occupies
+ * @return the number of Instructions the bytecode instruction decodes to
+ */
+uint32_t decodeInstruction(Module* module, uint32_t index, Instruction* instr,
+        uint32_t* size) {
+    const unsigned char* bytecode = module->bytecode;
+    uint8_t opcode = bytecode[index];
+    uint32_t count = 1;
+    *size = instructionSize(bytecode, index);
+
+    if(instr != NULL) {
+        instr->handler = NULL;
+        instr->opcode = opcode;
+        instr->arg.u = 0;
+        instr->extra = 0;
+        instr->offset = index;
+    }
+
+    switch(opcode) {
+        case OP_PUSH_INT:
+        case OP_PUSH_FLOAT:
+        case OP_CALL:
+        case OP_TAIL_CALL:
+        case OP_LOAD_LOCAL:
+        case OP_STORE_LOCAL:
+        case OP_LOAD_CAPTURED:
+        case OP_COND_JUMP_TRUE:
+        case OP_COND_JUMP_FALSE:
+        case OP_ABS_JUMP:
+            //the jump targets are translated once every instruction's index
+            //is known
+            if(instr != NULL) {
+                instr->arg.u = readOperand(bytecode, index + 1);
+            }
+            break;
+        case OP_PUSH_BUILTIN:
+        case OP_PUSH_LITERAL:
+        case OP_LOAD:
+        case OP_STORE:
+            if(instr != NULL) {
+                decodeConstant(module, instr, index + 1);
+            }
+            break;
+        case OP_CREATE_FUNC: {
+            uint32_t capturedNum = readOperand(bytecode, index + 5);
+            if(instr != NULL) {
+                instr->arg.u = readOperand(bytecode, index + 1);
+                instr->extra = capturedNum;
+                for(uint32_t i = 0; i < capturedNum; i++) {
+                    uint32_t capture = index + 9 + i * 5;
+                    Instruction* captureInstr = &instr[i + 1];
+                    captureInstr->handler = NULL;
+                    captureInstr->opcode = bytecode[capture];
+                    captureInstr->offset = capture;
+                    if(bytecode[capture] == CAPTURE_NAME) {
+                        decodeConstant(module, captureInstr, capture + 1);
+                    } else {
+                        captureInstr->arg.u = readOperand(bytecode, capture + 1);
+                        captureInstr->extra = 0;
+                    }
+                }
+            }
+            count += capturedNum;
+            break;
+        }
+        case OP_DEF_FUNC:
+            //the names are read from the bytecode when they are needed
+            if(instr != NULL) {
+                instr->arg.u = bytecode[index + 1];
+                instr->extra = readOperand(bytecode, index + 2);
+            }
+            break;
+        default:
+            break;
+    }
+
+    return count;
+}
+
+//marks the depth of the stack at an instruction that has not been reached
+#define NO_DEPTH UINT32_MAX
+
+/**
+ * Returns whether the instruction at the given index is a known opcode whose
+ * operands fit in the bytecode. instructionSize can only be used on such
+ * instructions.
+ */
+static uint8_t instructionFits(const unsigned char* bytecode, uint32_t length,
+        uint32_t index) {
+    uint64_t left = length - index;
+    switch(bytecode[index]) {
+        case OP_CREATE_FUNC:
+            return left >= 9 &&
+                    left >= 9 + (uint64_t) readOperand(bytecode, index + 5) * 5;
+        case OP_DEF_FUNC: {
+            if(left < 10) {
+                return 0;
+            }
+            uint64_t slotNum = readOperand(bytecode, index + 2);
+            if(left < 10 + slotNum * 4) {
+                return 0;
+            }
+            uint64_t capturedNum = readOperand(bytecode,
+                    index + 6 + slotNum * 4);
+            return left >= 10 + slotNum * 4 + capturedNum * 4;
+        }
+        default:
+            return bytecode[index] < OPCODES &&
+                    left >= instructionSize(bytecode, index);
+    }
+}
+
+static uint8_t isConstant(const Module* module, uint32_t index) {
+    return readOperand(module->bytecode, index) < module->constantsLength;
+}
+
+/**
+ * Gives the number of values the instruction at the given index pops off the
+ * stack and the number it pushes.
+ */
+static void stackEffect(const unsigned char* bytecode, uint32_t index,
+        uint32_t* pops, uint32_t* pushes) {
+    *pops = 0;
+    *pushes = 0;
+    switch(bytecode[index]) {
+        case OP_PUSH_INT:
+        case OP_PUSH_FLOAT:
+        case OP_PUSH_BUILTIN:
+        case OP_PUSH_LITERAL:
+        case OP_PUSH_NONE:
+        case OP_CREATE_FUNC:
+        case OP_LOAD:
+        case OP_LOAD_LOCAL:
+        case OP_LOAD_CAPTURED:
+            *pushes = 1;
+            break;
+        case OP_CALL:
+        case OP_TAIL_CALL:
+            *pops = readOperand(bytecode, index + 1) + 1;
+            *pushes = 1;
+            break;
+        case OP_RETURN:
+        case OP_STORE:
+        case OP_STORE_LOCAL:
+        case OP_COND_JUMP_TRUE:
+        case OP_COND_JUMP_FALSE:
+        case OP_POP:
+        case OP_CHECK_NONE:
+            *pops = 1;
+            break;
+        case OP_DUP:
+            *pops = 1;
+            *pushes = 2;
+            break;
+        case OP_ROT3:
+            *pops = 3;
+            *pushes = 3;
+            break;
+        case OP_SWAP:
+            *pops = 2;
+            *pushes = 2;
+            break;
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_EQ:
+        case OP_NOT_EQ:
+        case OP_LESS_THAN:
+        case OP_LESS_THAN_EQ:
+        case OP_GREATER_THAN:
+        case OP_GREATER_THAN_EQ:
+            *pops = 2;
+            *pushes = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Checks the operands of an instruction of a function.
+ *
+ * @param starts whether an instruction starts at each index of the bytecode
+ * @param slotNum the number of slots of the function. This is 0 for the code
+ *      of $init, which has no OP_DEF_FUNC header.
+ * @param capturedNum the number of variables the function captures
+ * @param isInit whether the instruction belongs to $init
+ */
+static uint8_t checkOperands(const Module* module, const uint8_t* starts,
+        uint32_t index, uint32_t slotNum, uint32_t capturedNum,
+        uint8_t isInit) {
+    const unsigned char* bytecode = module->bytecode;
+    switch(bytecode[index]) {
+        case OP_PUSH_BUILTIN:
+        case OP_PUSH_LITERAL:
+        case OP_LOAD:
+            return isConstant(module, index + 1);
+        case OP_STORE:
+            //only $init has a map of named variables
+            return isInit && isConstant(module, index + 1);
+        case OP_LOAD_LOCAL:
+        case OP_STORE_LOCAL:
+            return readOperand(bytecode, index + 1) < slotNum;
+        case OP_LOAD_CAPTURED:
+            return readOperand(bytecode, index + 1) < capturedNum;
+        case OP_CALL:
+        case OP_TAIL_CALL:
+            return readOperand(bytecode, index + 1) <= UINT8_MAX;
+        case OP_CREATE_FUNC: {
+            uint32_t entry = readOperand(bytecode, index + 1);
+            uint32_t count = readOperand(bytecode, index + 5);
+            if(entry >= module->bytecodeLength || !starts[entry] ||
+                    bytecode[entry] != OP_DEF_FUNC) {
+                return 0;
+            }
+            uint32_t entrySlots = readOperand(bytecode, entry + 2);
+            if(readOperand(bytecode, entry + 6 + entrySlots * 4) != count) {
+                return 0;
+            }
+            for(uint32_t i = 0; i < count; i++) {
+                uint32_t capture = index + 9 + i * 5;
+                uint32_t operand = readOperand(bytecode, capture + 1);
+                if(!(bytecode[capture] == CAPTURE_LOCAL && operand < slotNum) &&
+                        !(bytecode[capture] == CAPTURE_CAPTURED &&
+                            operand < capturedNum) &&
+                        !(bytecode[capture] == CAPTURE_NAME &&
+                            isConstant(module, capture + 1))) {
+                    return 0;
+                }
+            }
+            return 1;
+        }
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Checks the code of one function, which runs from start to end. The code of
+ * $init has no OP_DEF_FUNC header. Every jump must stay in the function and no
+ * instruction may pop more values than the stack holds. Statements may leave
+ * values on the stack, so the stack can be deeper each time a loop runs; the
+ * smallest depth that reaches each instruction is used, which takes more than
+ * one pass over code with loops. The function must end with an instruction
+ * that does not continue into the next function.
+ */
+static uint8_t checkFunction(const Module* module, const uint8_t* starts,
+        uint32_t* depths, uint32_t start, uint32_t end) {
+    const unsigned char* bytecode = module->bytecode;
+    uint8_t isInit = bytecode[start] != OP_DEF_FUNC;
+    uint32_t slotNum = 0;
+    uint32_t capturedNum = 0;
+    uint32_t first = start;
+    if(!isInit) {
+        slotNum = readOperand(bytecode, start + 2);
+        capturedNum = readOperand(bytecode, start + 6 + slotNum * 4);
+        if(bytecode[start + 1] > slotNum) {
+            return 0;
+        }
+        for(uint32_t i = 0; i < slotNum; i++) {
+            if(!isConstant(module, start + 6 + i * 4)) {
+                return 0;
+            }
+        }
+        for(uint32_t i = 0; i < capturedNum; i++) {
+            if(!isConstant(module, start + 10 + slotNum * 4 + i * 4)) {
+                return 0;
+            }
+        }
+        first += instructionSize(bytecode, start);
+    }
+    if(first == end) {
+        return 0;
+    }
+
+    for(uint32_t i = first; i < end; i++) {
+        depths[i] = NO_DEPTH;
+    }
+
+    uint8_t last = OP_RETURN;
+    uint8_t changed = 1;
+    while(changed) {
+        changed = 0;
+        //the depth of the stack after the previous instruction, if execution
+        //can continue from it
+        uint32_t depth = 0;
+        uint8_t reachable = 1;
+        uint32_t size;
+        for(uint32_t i = first; i < end; i += size) {
+            size = instructionSize(bytecode, i);
+            last = bytecode[i];
+            if(reachable && depth < depths[i]) {
+                depths[i] = depth;
+                changed = 1;
+            }
+            if(depths[i] == NO_DEPTH) {
+                //only reached by a jump later in the code, if at all
+                reachable = 0;
+                continue;
+            }
+            depth = depths[i];
+            reachable = 1;
+
+            if(!checkOperands(module, starts, i, slotNum, capturedNum,
+                    isInit)) {
+                return 0;
+            }
+
+            uint32_t pops;
+            uint32_t pushes;
+            stackEffect(bytecode, i, &pops, &pushes);
+            if(depth < pops) {
+                return 0;
+            }
+            depth = depth - pops + pushes;
+
+            if(last == OP_ABS_JUMP || last == OP_COND_JUMP_TRUE ||
+                    last == OP_COND_JUMP_FALSE) {
+                uint32_t target = readOperand(bytecode, i + 1);
+                if(target < first || target >= end || !starts[target]) {
+                    return 0;
+                }
+                if(depth < depths[target]) {
+                    depths[target] = depth;
+                    changed = 1;
+                }
+            }
+            if(last == OP_RETURN || last == OP_ABS_JUMP) {
+                reachable = 0;
+            }
+        }
+    }
+    return last == OP_RETURN || last == OP_ABS_JUMP;
+}
+
+uint8_t checkBytecode(const Module* module) {
+    const unsigned char* bytecode = module->bytecode;
+    uint32_t length = module->bytecodeLength;
+    //the code of $init comes first
+    if(length == 0 || module->entryIndex != 0 || bytecode[0] == OP_DEF_FUNC) {
+        return 0;
+    }
+
+    uint8_t* starts = (uint8_t*) calloc(length, 1);
+    uint8_t valid = 1;
+    uint32_t size;
+    for(uint32_t i = 0; valid && i < length; i += size) {
+        valid = instructionFits(bytecode, length, i);
+        if(valid) {
+            starts[i] = 1;
+            size = instructionSize(bytecode, i);
+        }
+    }
+
+    //each OP_DEF_FUNC starts the code of a new function
+    uint32_t* depths = (uint32_t*) malloc(sizeof(uint32_t) * length);
+    uint32_t start = 0;
+    for(uint32_t i = 0; valid && i <= length; i += size) {
+        if(i == length || (i != start && bytecode[i] == OP_DEF_FUNC)) {
+            valid = checkFunction(module, starts, depths, start, i);
+            start = i;
+        }
+        if(i == length) {
+            break;
+        }
+        size = instructionSize(bytecode, i);
+    }
+
+    free(starts);
+    free(depths);
+    return valid;
+}
+
+void translateModule(Module* module) {
+    //first find the index of each instruction
+    uint32_t* codeIndex = (uint32_t*) malloc(sizeof(uint32_t) *
+            (module->bytecodeLength + 1));
+    uint32_t codeLength = 0;
+    uint32_t size;
+    for(uint32_t i = 0; i < module->bytecodeLength; i += size) {
+        codeIndex[i] = codeLength;
+        codeLength += decodeInstruction(module, i, NULL, &size);
+    }
+    codeIndex[module->bytecodeLength] = codeLength;
+
+    Instruction* code = (Instruction*) malloc(sizeof(Instruction) *
+            (codeLength + 1));
+    for(uint32_t i = 0; i < module->bytecodeLength; i += size) {
+        Instruction* instr = &code[codeIndex[i]];
+        decodeInstruction(module, i, instr, &size);
+        if(instr->opcode == OP_COND_JUMP_TRUE ||
+                instr->opcode == OP_COND_JUMP_FALSE ||
+                instr->opcode == OP_ABS_JUMP) {
+            instr->arg.u = codeIndex[instr->arg.u];
+        }
+    }
+
+    //the code always ends with an instruction that is never executed so that
+    //the instruction after the last one can be referred to
+    code[codeLength].handler = NULL;
+    code[codeLength].opcode = OP_RETURN;
+    code[codeLength].arg.u = 0;
+    code[codeLength].extra = 0;
+    code[codeLength].offset = module->bytecodeLength;
+
+    module->codeLength = codeLength;
+    module->code = code;
+    module->codeIndex = codeIndex;
+    module->threaded = 0;
+    module->literals = NULL;
+    module->callCachesLength = 0;
+    module->callCaches = NULL;
+}
+
+void destroyModuleCode(Module* module) {
+    free(module->code);
+    module->code = NULL;
+    free(module->codeIndex);
+    module->codeIndex = NULL;
+    module->codeLength = 0;
+    if(module->literals != NULL) {
+        for(uint32_t i = 0; i < module->constantsLength; i++) {
+            if(module->literals[i] != NULL) {
+                destroyThing(module->literals[i]);
+            }
+        }
+        free(module->literals);
+        module->literals = NULL;
+    }
+    free(module->callCaches);
+    module->callCaches = NULL;
+    module->callCachesLength = 0;
+}
+
+SrcLoc findSrcLoc(const Module* module, uint32_t index) {
+    SrcLoc location = {0, 0};
+    if(index >= module->codeLength) {
+        return location;
+    }
+
+    //srcLoc is in bytecode order
+    uint32_t offset = module->code[index].offset;
+    for(uint32_t i = 0; i < module->srcLocLength &&
+            module->srcLoc[i].index <= offset; i++) {
+        location = module->srcLoc[i].location;
+    }
+    return location;
+}
+
+static const char* const OPCODE_NAMES[OPCODES] = {
+    "PUSH_INT",
+    "PUSH_FLOAT",
+    "PUSH_BUILTIN",
+    "PUSH_LITERAL",
+    "PUSH_NONE",
+    "CALL",
+    "RETURN",
+    "CREATE_FUNC",
+    "LOAD",
+    "STORE",
+    "COND_JUMP_TRUE",
+    "COND_JUMP_FALSE",
+    "ABS_JUMP",
+    "DUP",
+    "ROT3",
+    "SWAP",
+    "POP",
+    "CHECK_NONE",
+    "DEF_FUNC",
+    "LOAD_LOCAL",
+    "STORE_LOCAL",
+    "LOAD_CAPTURED",
+    "ADD",
+    "SUB",
+    "MUL",
+    "DIV",
+    "EQ",
+    "NOT_EQ",
+    "LESS_THAN",
+    "LESS_THAN_EQ",
+    "GREATER_THAN",
+    "GREATER_THAN_EQ",
+    "TAIL_CALL"
+};
+
+const char* opcodeName(uint8_t opcode) {
+    if(opcode >= OPCODES) {
+        return "UNKNOWN";
+    }
+    return OPCODE_NAMES[opcode];
+}
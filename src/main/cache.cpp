@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "main/util.h"
+#include "main/bytecode.h"
+#include "main/cache.h"
+
+static const char CACHE_MAGIC[4] = {'B', 'L', 'G', 'C'};
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t buildId;
+    uint64_t sourceHash;
+    uint32_t sourceLength;
+    uint32_t constantsLength;
+    uint32_t constantDataLength;
+    uint32_t bytecodeLength;
+    uint32_t srcLocLength;
+    uint32_t entryIndex;
+} CacheHeader;
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+        hash ^= ((const uint8_t*) data)[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * The 64 bit FNV-1a hash of the source.
+ */
+uint64_t hashSource(const char* src) {
+    return hashBytes(14695981039346656037ull, src, strlen(src));
+}
+
+/**
+ * Identifies the build of blerg that is running, so that caches written by a
+ * different compiler are not loaded. It is a hash of the names of the opcodes
+ * and of the size and modification time of the executable, or of the time it
+ * was compiled if the executable cannot be found.
+ */
+static uint64_t buildId() {
+    static uint64_t id = 0;
+    if(id != 0) {
+        return id;
+    }
+
+    uint64_t hash = 14695981039346656037ull;
+    for(int i = 0; i < OPCODES; i++) {
+        const char* name = opcodeName((uint8_t) i);
+        hash = hashBytes(hash, name, strlen(name) + 1);
+    }
+
+    struct stat exeStat;
+    if(stat("/proc/self/exe", &exeStat) == 0) {
+        hash = hashBytes(hash, &exeStat.st_size, sizeof(exeStat.st_size));
+        hash = hashBytes(hash, &exeStat.st_mtim, sizeof(exeStat.st_mtim));
+    } else {
+        const char* stamp = __DATE__ " " __TIME__;
+        hash = hashBytes(hash, stamp, strlen(stamp));
+    }
+    id = hash;
+    return id;
+}
+
+/**
+ * Returns the offset of each section in the cache and the size of the whole
+ * cache.
+ */
+void cacheLayout(CacheHeader* header, size_t* hashes, size_t* offsets,
+        size_t* srcLoc, size_t* bytecode, size_t* constantData, size_t* size) {
+    *hashes = sizeof(CacheHeader);
+    *offsets = *hashes + sizeof(uint32_t) * header->constantsLength;
+    *srcLoc = *offsets + sizeof(uint32_t) * header->constantsLength;
+    *bytecode = *srcLoc + sizeof(BytecodeSrcLoc) * header->srcLocLength;
+    *constantData = *bytecode + header->bytecodeLength;
+    *size = *constantData + header->constantDataLength;
+}
+
+char* cachePath(const char* path) {
+    return (char*) formatStr("%sc", path);
+}
+
+Module* loadModuleCache(const char* path, const char* src) {
+    char* file = cachePath(path);
+    int fd = open(file, O_RDONLY);
+    free(file);
+    if(fd == -1) {
+        return NULL;
+    }
+
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0 ||
+            (size_t) fileStat.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t length = fileStat.st_size;
+    const uint8_t* cache = (const uint8_t*) mmap(NULL, length, PROT_READ,
+            MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(cache == MAP_FAILED) {
+        return NULL;
+    }
+
+    CacheHeader* header = (CacheHeader*) cache;
+    size_t hashes, offsets, srcLoc, bytecode, constantData, size;
+    cacheLayout(header, &hashes, &offsets, &srcLoc, &bytecode, &constantData,
+            &size);
+
+    uint8_t valid = memcmp(header->magic, CACHE_MAGIC, 4) == 0 &&
+            header->version == CACHE_VERSION &&
+            header->buildId == buildId() &&
+            header->sourceLength == strlen(src) &&
+            header->sourceHash == hashSource(src) &&
+            size == length &&
+            header->entryIndex < header->bytecodeLength &&
+            header->constantDataLength != 0 &&
+            cache[length - 1] == 0;
+
+    const uint32_t* constantOffsets = (const uint32_t*) (cache + offsets);
+    for(uint32_t i = 0; valid && i < header->constantsLength; i++) {
+        valid = constantOffsets[i] < header->constantDataLength;
+    }
+
+    if(!valid) {
+        munmap((void*) cache, length);
+        return NULL;
+    }
+
+    const char** constants = (const char**) malloc(
+            sizeof(char*) * header->constantsLength);
+    for(uint32_t i = 0; i < header->constantsLength; i++) {
+        constants[i] = (const char*) cache + constantData + constantOffsets[i];
+    }
+
+    Module* module = (Module*) malloc(sizeof(Module));
+    module->constantsLength = header->constantsLength;
+    module->constants = constants;
+    module->constantHashes = (const uint32_t*) (cache + hashes);
+    module->bytecodeLength = header->bytecodeLength;
+    module->bytecode = cache + bytecode;
+    module->srcLocLength = header->srcLocLength;
+    module->srcLoc = (const BytecodeSrcLoc*) (cache + srcLoc);
+    module->entryIndex = header->entryIndex;
+    module->name = path;
+    module->cache = cache;
+    module->cacheLength = length;
+
+    //the cache may have been damaged, so the bytecode is checked before it is
+    //trusted
+    if(!checkBytecode(module)) {
+        free(constants);
+        free(module);
+        munmap((void*) cache, length);
+        return NULL;
+    }
+    translateModule(module);
+    return module;
+}
+
+uint8_t saveModuleCache(const char* path, const char* src, Module* module) {
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.buildId = buildId();
+    header.sourceHash = hashSource(src);
+    header.sourceLength = strlen(src);
+    header.constantsLength = module->constantsLength;
+    header.bytecodeLength = module->bytecodeLength;
+    header.srcLocLength = module->srcLocLength;
+    header.entryIndex = module->entryIndex;
+
+    uint32_t* constantOffsets = (uint32_t*) malloc(
+            sizeof(uint32_t) * module->constantsLength);
+    header.constantDataLength = 0;
+    for(uint32_t i = 0; i < module->constantsLength; i++) {
+        constantOffsets[i] = header.constantDataLength;
+        header.constantDataLength += strlen(module->constants[i]) + 1;
+    }
+    //keeps the data from being empty, so that it always ends with a 0 byte
+    if(header.constantDataLength == 0) {
+        header.constantDataLength = 1;
+    }
+
+    char* file = cachePath(path);
+    const char* temp = formatStr("%s.%i", file, (int) getpid());
+    FILE* out = fopen(temp, "wb");
+    uint8_t written = 0;
+
+    if(out != NULL) {
+        written = fwrite(&header, sizeof(CacheHeader), 1, out) == 1 &&
+            fwrite(module->constantHashes, sizeof(uint32_t),
+                    module->constantsLength, out) == module->constantsLength &&
+            fwrite(constantOffsets, sizeof(uint32_t),
+                    module->constantsLength, out) == module->constantsLength &&
+            fwrite(module->srcLoc, sizeof(BytecodeSrcLoc),
+                    module->srcLocLength, out) == module->srcLocLength &&
+            fwrite(module->bytecode, 1, module->bytecodeLength, out) ==
+                    module->bytecodeLength;
+        for(uint32_t i = 0; written && i < module->constantsLength; i++) {
+            const char* constant = module->constants[i];
+            size_t size = strlen(constant) + 1;
+            written = fwrite(constant, 1, size, out) == size;
+        }
+        if(written && module->constantsLength == 0) {
+            written = fputc(0, out) != EOF;
+        }
+        written = fclose(out) == 0 && written;
+        written = written && rename(temp, file) == 0;
+        if(!written) {
+            remove(temp);
+        }
+    }
+
+    free(constantOffsets);
+    free((char*) temp);
+    free(file);
+    return written;
+}
+
+void destroyModuleCache(Module* module) {
+    free((void*) module->constants);
+    module->constants = NULL;
+    munmap((void*) module->cache, module->cacheLength);
+    module->cache = NULL;
+    module->cacheLength = 0;
+}
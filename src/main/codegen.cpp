@@ -5,57 +5,74 @@
 
 #include "main/bytecode.h"
 #include "main/codegen.h"
+#include "main/cache.h"
+#include "main/peephole.h"
 
-//when the module is being compiled, the constant table and the bytecode are
-//split into 'segments'. Each segment contains SEGMENT_SIZE elements.
-const uint32_t SEGMENT_SIZE = 1024;
+//the capacity of the builder's arrays when they are first used
+const uint32_t INITIAL_CAPACITY = 64;
+
+/**
+ * Makes room in an array for one more element, doubling its capacity if it is
+ * full.
+ *
+ * @param array the array, which may be NULL if capacity is zero
+ * @param capacity the number of elements the array can hold. It is updated
+ *      if the array grows.
+ * @param length the number of elements in the array
+ * @param elemSize the size of each element
+ * @return the array, which may have moved
+ */
+void* reserveArray(void* array, uint32_t* capacity, uint32_t length,
+        size_t elemSize) {
+    if(length < *capacity) {
+        return array;
+    }
+    *capacity = *capacity == 0 ? INITIAL_CAPACITY : *capacity * 2;
+    return realloc(array, *capacity * elemSize);
+}
 
 ModuleBuilder* createModuleBuilder() {
     ModuleBuilder* builder = (ModuleBuilder*) malloc(sizeof(ModuleBuilder));
     builder->constantsLength = 0;
+    builder->constantsCapacity = 0;
     builder->constants = NULL;
+    builder->constantHashes = NULL;
+    builder->constantIndices = createMap();
     builder->bytecodeLength = 0;
+    builder->bytecodeCapacity = 0;
     builder->bytecode = NULL;
     builder->srcLocLength = 0;
+    builder->srcLocCapacity = 0;
     builder->srcLoc = NULL;
     builder->nextLabel = 0;
-    builder->labelRefs = createMap();
-    builder->labelDefs = createMap();
+    builder->labelsCapacity = 0;
+    builder->labelDefs = NULL;
+    builder->labelRefsLength = 0;
+    builder->labelRefsCapacity = 0;
+    builder->labelRefs = NULL;
+    builder->callEnd = 0;
     return builder;
 }
 
-void destroyIntList(void* list) {
-    destroyList((List*) list, free);
-}
-
 void destroyModuleBuilder(ModuleBuilder* builder) {
-    builder->constantsLength = 0;
-    destroyList(builder->constants, free);
-    builder->constants = NULL;
-
-    builder->bytecodeLength = 0;
-    destroyList(builder->bytecode, free);
-    builder->bytecode = NULL;
-
-    builder->srcLocLength = 0;
-    destroyList(builder->srcLoc, free);
-    builder->srcLoc = NULL;
-
-    destroyMap(builder->labelRefs, free, destroyIntList);
-    destroyMap(builder->labelDefs, free, free);
-
+    //the arrays are NULL if builderToModule took them
+    for(uint32_t i = 0; i < builder->constantsLength; i++) {
+        free((void*) builder->constants[i]);
+    }
+    free(builder->constants);
+    free(builder->constantHashes);
+    destroyMap(builder->constantIndices, nothing, free);
+    free(builder->bytecode);
+    free(builder->srcLoc);
+    free(builder->labelDefs);
+    free(builder->labelRefs);
     free(builder);
 }
 
 void emitByte(ModuleBuilder* builder, uint8_t byte) {
-    uint32_t segmentOffset = builder->bytecodeLength % SEGMENT_SIZE;
-    //if the current bytecode segment has no space left, create a new one
-    if(segmentOffset == 0) {
-        builder->bytecode = consList(malloc(SEGMENT_SIZE), builder->bytecode);
-    }
-    unsigned char* currentSegment = (uint8_t*) builder->bytecode->head;
-    currentSegment[segmentOffset] = byte;
-    builder->bytecodeLength++;
+    builder->bytecode = (uint8_t*) reserveArray(builder->bytecode,
+            &builder->bytecodeCapacity, builder->bytecodeLength, sizeof(uint8_t));
+    builder->bytecode[builder->bytecodeLength++] = byte;
 }
 
 void emitInt(ModuleBuilder* builder, int32_t num) {
@@ -86,51 +103,52 @@ void emitFloat(ModuleBuilder* builder, float num) {
  * constant table.
  */
 uint32_t internConstant(ModuleBuilder* builder, const char* constant) {
-    //find the constant and return its index
-    uint32_t i = 0;
-    for(List* segment = builder->constants; segment != NULL; segment = segment->tail) {
-        for(uint32_t k = 0; k < SEGMENT_SIZE; k++) {
-            if(i >= builder->constantsLength) {
-                break;
-            }
-            char** segmentData = (char**) segment->head;
-            if(strcmp(segmentData[i], constant) == 0) {
-                return i;
-            }
-            i++;
-        }
+    uint32_t hash = hashStr(constant);
+    uint32_t* index = (uint32_t*) getMapStrHashed(builder->constantIndices,
+            constant, hash);
+    if(index != NULL) {
+        return *index;
     }
 
-    uint32_t segmentOffset = builder->constantsLength % SEGMENT_SIZE;
-    //create a new segment if necessary
-    if(segmentOffset == 0) {
-        char** newSegment = (char**) malloc(SEGMENT_SIZE * sizeof(char*));
-        builder->constants = consList(newSegment, builder->constants);
-    }
-
-    //create a copy of the constant and store it if it was not already present
-    char** currentSegment = (char**) builder->constants->head;
-    currentSegment[segmentOffset] = newStr(constant);
+    //the two arrays have the same capacity, so they grow together
+    uint32_t capacity = builder->constantsCapacity;
+    builder->constants = (const char**) reserveArray(builder->constants,
+            &capacity, builder->constantsLength, sizeof(char*));
+    builder->constantHashes = (uint32_t*) reserveArray(builder->constantHashes,
+            &builder->constantsCapacity, builder->constantsLength,
+            sizeof(uint32_t));
+
+    //the map's key is the copy in the constant table
+    const char* copy = newStr(constant);
+    builder->constants[builder->constantsLength] = copy;
+    builder->constantHashes[builder->constantsLength] = hash;
+    putMapStrHashed(builder->constantIndices, copy, hash,
+            boxUint32(builder->constantsLength));
     return builder->constantsLength++;
 }
 
 void emitLabelRef(ModuleBuilder* builder, uint32_t label) {
     //record where the label is referenced
-    List* value = consList(
-            boxUint32(builder->bytecodeLength),
-            (List*) getMapUint32(builder->labelRefs, label));
-    putMapUint32(builder->labelRefs, label, value);
+    builder->labelRefs = (LabelRef*) reserveArray(builder->labelRefs,
+            &builder->labelRefsCapacity, builder->labelRefsLength,
+            sizeof(LabelRef));
+    LabelRef* ref = &builder->labelRefs[builder->labelRefsLength++];
+    ref->label = label;
+    ref->position = builder->bytecodeLength;
     //emit a dummy address. This will be patched later, even if the label was
     //already emitted.
     emitUInt(builder, 0);
 }
 
 uint32_t createLabel(ModuleBuilder* builder) {
+    builder->labelDefs = (uint32_t*) reserveArray(builder->labelDefs,
+            &builder->labelsCapacity, builder->nextLabel, sizeof(uint32_t));
+    builder->labelDefs[builder->nextLabel] = 0;
     return builder->nextLabel++;
 }
 
 void emitLabel(ModuleBuilder* builder, uint32_t label) {
-    putMapUint32(builder->labelDefs, label, boxUint32(builder->bytecodeLength));
+    builder->labelDefs[label] = builder->bytecodeLength;
 }
 
 void emitPushInt(ModuleBuilder* builder, int32_t num) {
@@ -160,15 +178,30 @@ void emitPushNone(ModuleBuilder* builder) {
 void emitCall(ModuleBuilder* builder, uint32_t arity) {
     emitByte(builder, OP_CALL);
     emitUInt(builder, arity);
+    builder->callEnd = builder->bytecodeLength;
 }
 
 void emitReturn(ModuleBuilder* builder) {
+    if(builder->callEnd != 0 && builder->callEnd == builder->bytecodeLength) {
+        builder->bytecode[builder->callEnd - 5] = OP_TAIL_CALL;
+    }
     emitByte(builder, OP_RETURN);
 }
 
-void emitCreateFunc(ModuleBuilder* builder, uint32_t location) {
+void emitCreateFunc(ModuleBuilder* builder, uint32_t location,
+        uint32_t capturedNum) {
     emitByte(builder, OP_CREATE_FUNC);
     emitLabelRef(builder, location);
+    emitUInt(builder, capturedNum);
+}
+
+void emitCapture(ModuleBuilder* builder, uint8_t source, uint32_t index) {
+    emitByte(builder, source);
+    emitUInt(builder, index);
+}
+
+void emitCaptureName(ModuleBuilder* builder, const char* name) {
+    emitCapture(builder, CAPTURE_NAME, internConstant(builder, name));
 }
 
 void emitLoad(ModuleBuilder* builder, const char* name) {
@@ -181,6 +214,25 @@ void emitStore(ModuleBuilder* builder, const char* name) {
     emitUInt(builder, internConstant(builder, name));
 }
 
+void emitLoadLocal(ModuleBuilder* builder, uint32_t slot) {
+    emitByte(builder, OP_LOAD_LOCAL);
+    emitUInt(builder, slot);
+}
+
+void emitStoreLocal(ModuleBuilder* builder, uint32_t slot) {
+    emitByte(builder, OP_STORE_LOCAL);
+    emitUInt(builder, slot);
+}
+
+void emitLoadCaptured(ModuleBuilder* builder, uint32_t index) {
+    emitByte(builder, OP_LOAD_CAPTURED);
+    emitUInt(builder, index);
+}
+
+void emitOperator(ModuleBuilder* builder, uint8_t opcode) {
+    emitByte(builder, opcode);
+}
+
 void emitCondJump(ModuleBuilder* builder, uint32_t label, uint8_t when) {
     if(when) {
         emitByte(builder, OP_COND_JUMP_TRUE);
@@ -215,109 +267,115 @@ void emitCheckNone(ModuleBuilder* builder) {
     emitByte(builder, OP_CHECK_NONE);
 }
 
-void emitDefFunc(ModuleBuilder* builder, uint8_t argNum, const char** args,
+void emitDefFunc(ModuleBuilder* builder, uint8_t argNum, uint32_t slotNum,
+        const char** slots, uint32_t capturedNum, const char** captured,
         uint8_t isInit) {
     if(!isInit) {
         emitByte(builder, OP_DEF_FUNC);
         emitByte(builder, argNum);
-        for(uint8_t i = 0; i < argNum; i++) {
-            emitUInt(builder, internConstant(builder, args[i]));
+        emitUInt(builder, slotNum);
+        for(uint32_t i = 0; i < slotNum; i++) {
+            emitUInt(builder, internConstant(builder, slots[i]));
+        }
+        emitUInt(builder, capturedNum);
+        for(uint32_t i = 0; i < capturedNum; i++) {
+            emitUInt(builder, internConstant(builder, captured[i]));
         }
     }
 }
 
 void emitSrcLoc(ModuleBuilder* builder, SrcLoc location) {
-    uint32_t segmentOffset = builder->srcLocLength % SEGMENT_SIZE;
-    //if the current bytecode segment has no space left, create a new one
-    if(segmentOffset == 0) {
-        size_t size = SEGMENT_SIZE * sizeof(BytecodeSrcLoc);
-        builder->srcLoc = consList(malloc(size), builder->srcLoc);
-    }
-    BytecodeSrcLoc* currentSegment = (BytecodeSrcLoc*) builder->srcLoc->head;
-    uint32_t index = builder->bytecodeLength;
-    currentSegment[segmentOffset] = createBytecodeSrcLoc(index, location);
-    builder->srcLocLength++;
-}
-
-/**
- * Takes a list of segments and copies them to a single array. Each segment is
- * assumed to be filled to the capacity of SEGMENT_SIZE, except the first one
- * (which occurs at the end of the bytecode).
- *
- * @param numElems the number of elements in all the segments.
- * @param segment list of segments
- * @param elemSize the size of each element
- * @return an array of compacted elements
- */
-char* compactSegments(uint32_t numElems, List* segment, uint8_t elemSize) {
-    //reverse the segments to the order that they actually occur in
-    List* revSegment = reverseList(segment);
-    segment = revSegment;
-
-    //size of the compacted array in bytes
-    uint32_t length = numElems * elemSize;
-
-    //size of each segment in bytes
-    uint32_t segmentSize = SEGMENT_SIZE * elemSize;
-    char* compacted = (char*) malloc(length);
-    uint32_t i;
-    for(i = 0; i + segmentSize < length; i += segmentSize) {
-        memcpy(&compacted[i], segment->head, segmentSize);
-        segment = segment->tail;
-    }
-    if(segment != NULL) {
-        memcpy(&compacted[i], segment->head, length % segmentSize);
-    }
-
-    destroyShallowList(revSegment);
-    return compacted;
+    builder->srcLoc = (BytecodeSrcLoc*) reserveArray(builder->srcLoc,
+            &builder->srcLocCapacity, builder->srcLocLength,
+            sizeof(BytecodeSrcLoc));
+    builder->srcLoc[builder->srcLocLength++] = createBytecodeSrcLoc(
+            builder->bytecodeLength, location);
 }
 
 Module* builderToModule(ModuleBuilder* builder, uint32_t entryLabel) {
-    char** constants = (char**) compactSegments(builder->constantsLength,
-            builder->constants, sizeof(char*));
-    uint8_t* bytecode = (unsigned char*) compactSegments(
-            builder->bytecodeLength, builder->bytecode, sizeof(unsigned char));
-    BytecodeSrcLoc* srcLoc = (BytecodeSrcLoc*) compactSegments(builder->srcLocLength,
-            builder->srcLoc, sizeof(BytecodeSrcLoc));
-
     //patch the labels
-    for(Entry* i = builder->labelRefs->entry; i != NULL; i = i->tail) {
-        //TODO change ot getMapUint32_t
-        uint32_t* definition = (uint32_t*) getMapStr(builder->labelDefs, (char*) i->key);
-        for(List* k = (List*) i->value; k != NULL; k = k->tail) {
-            uint32_t reference = *((uint32_t*) k->head);
-            bytecode[reference] = (*definition & 0xFF000000) >> 24;
-            bytecode[reference + 1] = (*definition & 0x00FF0000) >> 16;
-            bytecode[reference + 2] = (*definition & 0x0000FF00) >> 8;
-            bytecode[reference + 3] = *definition & 0x000000FF;
-        }
+    uint8_t* bytecode = builder->bytecode;
+    for(uint32_t i = 0; i < builder->labelRefsLength; i++) {
+        uint32_t reference = builder->labelRefs[i].position;
+        uint32_t definition = builder->labelDefs[builder->labelRefs[i].label];
+        bytecode[reference] = (definition & 0xFF000000) >> 24;
+        bytecode[reference + 1] = (definition & 0x00FF0000) >> 16;
+        bytecode[reference + 2] = (definition & 0x0000FF00) >> 8;
+        bytecode[reference + 3] = definition & 0x000000FF;
     }
 
+    //the module takes the builder's arrays
     Module* module = (Module*) malloc(sizeof(Module));
     module->constantsLength = builder->constantsLength;
-    module->constants = (const char**) constants;
+    module->constants = builder->constants;
+    module->constantHashes = builder->constantHashes;
     module->bytecodeLength = builder->bytecodeLength;
     module->bytecode = bytecode;
     module->srcLocLength = builder->srcLocLength;
-    module->srcLoc = srcLoc;
-    uint32_t* entryIndex = (uint32_t*) getMapUint32(builder->labelDefs, entryLabel);
-    module->entryIndex = *entryIndex;
+    module->srcLoc = builder->srcLoc;
+    module->entryIndex = builder->labelDefs[entryLabel];
     module->name = NULL;
+    module->cache = NULL;
+    module->cacheLength = 0;
+
+    builder->constantsLength = 0;
+    builder->constants = NULL;
+    builder->constantHashes = NULL;
+    builder->bytecodeLength = 0;
+    builder->bytecode = NULL;
+    builder->srcLocLength = 0;
+    builder->srcLoc = NULL;
+
+    translateModule(module);
     return module;
 }
 
+/**
+ * Finds the opcode of a binary operator.
+ *
+ * @param op the operator
+ * @param opcode set to the operator's opcode if it has one
+ * @return whether the operator has an opcode
+ */
+uint8_t operatorOpcode(const char* op, uint8_t* opcode) {
+    static const char* names[OPERATOR_OPCODES] = {
+        "+", "-", "*", "/", "==", "!=", "<", "<=", ">", ">="
+    };
+    for(uint8_t i = 0; i < OPERATOR_OPCODES; i++) {
+        if(strcmp(op, names[i]) == 0) {
+            *opcode = OP_ADD + i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Information about the function being compiled.
+ */
+typedef struct {
+    //maps function names to function entry labels
+    Map* globalFuncs;
+    //maps function names to their FuncTokens
+    Map* funcs;
+    //maps local label names to label integer values generated by createLabel
+    Map* labels;
+    //maps local variable names to their slots, or NULL if the variables are
+    //looked up by name (as in $init)
+    Map* locals;
+    //maps captured variable names to their indices, or NULL in $init
+    Map* captured;
+} CompileState;
+
 /**
  * Converts statement, expression and jump tokens into bytecode.
  * Recursively compiles tokens.
  *
  * @param builder the ModuleBuilder instance
- * @param labels maps local label names to label integer values generated by
- *          createLabel
+ * @param state information about the function being compiled
  * @param token the token to compile
  */
-void compileToken(ModuleBuilder* builder, Map* globalFuncs, Map* labels,
-        Token* token) {
+void compileToken(ModuleBuilder* builder, CompileState* state, Token* token) {
     if(getTokenType(token) == TOKEN_INT) {
         emitSrcLoc(builder, tokenLocation(token));
         emitPushInt(builder, getIntTokenValue((IntToken*) token));
@@ -329,21 +387,34 @@ void compileToken(ModuleBuilder* builder, Map* globalFuncs, Map* labels,
         emitPushLiteral(builder, getLiteralTokenValue((LiteralToken*) token));
     } else if(getTokenType(token) == TOKEN_IDENTIFIER) {
         emitSrcLoc(builder, tokenLocation(token));
-        emitLoad(builder, getIdentifierTokenValue((IdentifierToken*) token));
+        const char* name = getIdentifierTokenValue((IdentifierToken*) token);
+        uint32_t* slot = NULL;
+        uint32_t* captured = NULL;
+        if(state->locals != NULL) {
+            slot = (uint32_t*) getMapStr(state->locals, name);
+            captured = (uint32_t*) getMapStr(state->captured, name);
+        }
+        if(slot != NULL) {
+            emitLoadLocal(builder, *slot);
+        } else if(captured != NULL) {
+            emitLoadCaptured(builder, *captured);
+        } else {
+            emitLoad(builder, name);
+        }
     } else if(getTokenType(token) == TOKEN_LABEL) {
-        uint32_t* label = (uint32_t*) getMapStr(labels,
+        uint32_t* label = (uint32_t*) getMapStr(state->labels,
                 getLabelTokenName((LabelToken*) token));
         emitLabel(builder, *label);
     } else if(getTokenType(token) == TOKEN_ABS_JUMP) {
-        uint32_t* label = (uint32_t*) getMapStr(labels,
+        uint32_t* label = (uint32_t*) getMapStr(state->labels,
                 getAbsJumpTokenLabel((AbsJumpToken*) token));
         emitSrcLoc(builder, tokenLocation(token));
         emitAbsJump(builder, *label);
     } else if(getTokenType(token) == TOKEN_COND_JUMP) {
         CondJumpToken* condJump = (CondJumpToken*) token;
-        compileToken(builder, globalFuncs, labels, getCondJumpTokenCondition(condJump));
+        compileToken(builder, state, getCondJumpTokenCondition(condJump));
 
-        uint32_t* label = (uint32_t*) getMapStr(labels, getCondJumpTokenLabel(condJump));
+        uint32_t* label = (uint32_t*) getMapStr(state->labels, getCondJumpTokenLabel(condJump));
         emitSrcLoc(builder, tokenLocation(token));
         emitCondJump(builder, *label, getCondJumpTokenWhen(condJump));
     } else if(getTokenType(token) == TOKEN_TUPLE) {
@@ -355,7 +426,7 @@ void compileToken(ModuleBuilder* builder, Map* globalFuncs, Map* labels,
         uint8_t count = 0;
 
         while(elements != NULL) {
-            compileToken(builder, globalFuncs, labels, (Token*) elements->head);
+            compileToken(builder, state, (Token*) elements->head);
             elements = elements->tail;
             count++;
         }
@@ -367,7 +438,7 @@ void compileToken(ModuleBuilder* builder, Map* globalFuncs, Map* labels,
         List* children = getCallTokenChildren(call);
         uint32_t count = 0;
         while(children != NULL) {
-            compileToken(builder, globalFuncs, labels, (Token*) children->head);
+            compileToken(builder, state, (Token*) children->head);
             children = children->tail;
             count++;
         }
@@ -379,22 +450,32 @@ void compileToken(ModuleBuilder* builder, Map* globalFuncs, Map* labels,
         UnaryOpToken* unaryOp = (UnaryOpToken*) token;
         emitPushBuiltin(builder, getUnaryOpTokenOp(unaryOp));
 
-        compileToken(builder, globalFuncs, labels, getUnaryOpTokenChild(unaryOp));
+        compileToken(builder, state, getUnaryOpTokenChild(unaryOp));
 
         emitSrcLoc(builder, tokenLocation(token));
         emitCall(builder, 1);
     } else if(getTokenType(token) == TOKEN_BINARY_OP) {
-        emitSrcLoc(builder, tokenLocation(token));
         BinaryOpToken* binaryOp = (BinaryOpToken*) token;
-        emitPushBuiltin(builder, getBinaryOpTokenOp(binaryOp));
-        compileToken(builder, globalFuncs, labels, getBinaryOpTokenLeft(binaryOp));
-        compileToken(builder, globalFuncs, labels, getBinaryOpTokenRight(binaryOp));
-
-        emitSrcLoc(builder, tokenLocation(token));
-        emitCall(builder, 2);
+        uint8_t opcode;
+        //arithmetic and comparisons have their own instructions
+        if(operatorOpcode(getBinaryOpTokenOp(binaryOp), &opcode)) {
+            compileToken(builder, state, getBinaryOpTokenLeft(binaryOp));
+            compileToken(builder, state, getBinaryOpTokenRight(binaryOp));
+
+            emitSrcLoc(builder, tokenLocation(token));
+            emitOperator(builder, opcode);
+        } else {
+            emitSrcLoc(builder, tokenLocation(token));
+            emitPushBuiltin(builder, getBinaryOpTokenOp(binaryOp));
+            compileToken(builder, state, getBinaryOpTokenLeft(binaryOp));
+            compileToken(builder, state, getBinaryOpTokenRight(binaryOp));
+
+            emitSrcLoc(builder, tokenLocation(token));
+            emitCall(builder, 2);
+        }
     } else if(getTokenType(token) == TOKEN_RETURN) {
         ReturnToken* ret = (ReturnToken*) token;
-        compileToken(builder, globalFuncs, labels, getReturnTokenBody(ret));
+        compileToken(builder, state, getReturnTokenBody(ret));
 
         emitSrcLoc(builder, tokenLocation(token));
         emitReturn(builder);
@@ -409,13 +490,20 @@ void compileToken(ModuleBuilder* builder, Map* globalFuncs, Map* labels,
         emitCall(builder, getCallOpTokenArity((CallOpToken*) token));
     } else if(getTokenType(token) == TOKEN_STORE) {
         emitSrcLoc(builder, tokenLocation(token));
-        emitStore(builder, getStoreTokenName((StoreToken*) token));
+        const char* name = getStoreTokenName((StoreToken*) token);
+        if(state->locals != NULL) {
+            //every store in a function is given a slot by compileFunc
+            emitStoreLocal(builder, *((uint32_t*) getMapStr(state->locals,
+                    name)));
+        } else {
+            emitStore(builder, name);
+        }
     } else if(getTokenType(token) == TOKEN_DUP) {
         emitSrcLoc(builder, tokenLocation(token));
         emitDup(builder);
     } else if(getTokenType(token) == TOKEN_PUSH) {
         emitSrcLoc(builder, tokenLocation(token));
-        compileToken(builder, globalFuncs, labels, getPushTokenValue((PushToken*) token));
+        compileToken(builder, state, getPushTokenValue((PushToken*) token));
     } else if(getTokenType(token) == TOKEN_ROT3) {
         emitSrcLoc(builder, tokenLocation(token));
         emitRot3(builder);
@@ -433,9 +521,32 @@ void compileToken(ModuleBuilder* builder, Map* globalFuncs, Map* labels,
         emitCheckNone(builder);
     } else if(getTokenType(token) == TOKEN_NEW_FUNC) {
         emitSrcLoc(builder, tokenLocation(token));
-        uint32_t* label = (uint32_t*) getMapStr(globalFuncs,
-                getNewFuncTokenName((NewFuncToken*) token));
-        emitCreateFunc(builder, *label);
+        const char* name = getNewFuncTokenName((NewFuncToken*) token);
+        uint32_t* label = (uint32_t*) getMapStr(state->globalFuncs, name);
+        List* captured = getFuncTokenCaptured(
+                (FuncToken*) getMapStr(state->funcs, name));
+        emitCreateFunc(builder, *label, lengthList(captured));
+
+        //tell the runtime where to find each variable the new function
+        //captures
+        for(; captured != NULL; captured = captured->tail) {
+            const char* capturedName = getIdentifierTokenValue(
+                    (IdentifierToken*) captured->head);
+            uint32_t* index = NULL;
+            if(state->locals != NULL) {
+                index = (uint32_t*) getMapStr(state->locals, capturedName);
+                if(index != NULL) {
+                    emitCapture(builder, CAPTURE_LOCAL, *index);
+                    continue;
+                }
+                index = (uint32_t*) getMapStr(state->captured, capturedName);
+                if(index != NULL) {
+                    emitCapture(builder, CAPTURE_CAPTURED, *index);
+                    continue;
+                }
+            }
+            emitCaptureName(builder, capturedName);
+        }
     } else {
         printf("warning: unknown token type\n");
     }
@@ -446,26 +557,76 @@ void compileToken(ModuleBuilder* builder, Map* globalFuncs, Map* labels,
  *
  * @param builder the ModuleBuilder instance
  * @param globalFuncs maps function names to function entry labels
+ * @param funcs maps function names to their FuncTokens
  * @param func the function to compile
  */
-void compileFunc(ModuleBuilder* builder, Map* globalFuncs, FuncToken* func) {
+void compileFunc(ModuleBuilder* builder, Map* globalFuncs, Map* funcs,
+        FuncToken* func) {
     //record the start of the function
     emitLabel(builder, *((uint32_t*) getMapStr(globalFuncs,
             getIdentifierTokenValue(getFuncTokenName(func)))));
 
-    //convert the argument list to an array be passed to emitDefFunc
+    uint8_t isInit = strcmp(getIdentifierTokenValue(getFuncTokenName(func)), "$init") == 0;
+
+    //Each local variable is assigned a slot. The arguments come first, then
+    //every other name stored to in the order they first appear. The
+    //variables of $init are exported by the module, so they are looked up by
+    //name instead.
+    List* slotNames = NULL;
+    Map* locals = isInit ? NULL : createMap();
+    uint32_t slotNum = 0;
     uint8_t argNum = lengthList(getFuncTokenArgs(func));
-    char** args = (char**) malloc(sizeof(char*) * lengthList(getFuncTokenArgs(func)));
-    List* arg = getFuncTokenArgs(func);
-    for(uint8_t i = 0; i < argNum; i++) {
-        args[i] = (char*) getIdentifierTokenValue((IdentifierToken*) arg->head);
-        arg = arg->tail;
+    for(List* arg = getFuncTokenArgs(func); arg != NULL; arg = arg->tail) {
+        const char* name = getIdentifierTokenValue((IdentifierToken*) arg->head);
+        slotNames = consList((void*) name, slotNames);
+        if(locals != NULL) {
+            putMapStr(locals, name, boxUint32(slotNum));
+        }
+        slotNum++;
+    }
+    if(locals != NULL) {
+        for(List* list = getBlockTokenChildren(getFuncTokenBody(func));
+                list != NULL; list = list->tail) {
+            Token* token = (Token*) list->head;
+            if(getTokenType(token) != TOKEN_STORE) {
+                continue;
+            }
+            const char* name = getStoreTokenName((StoreToken*) token);
+            if(getMapStr(locals, name) == NULL) {
+                slotNames = consList((void*) name, slotNames);
+                putMapStr(locals, name, boxUint32(slotNum));
+                slotNum++;
+            }
+        }
     }
+
+    //convert the slot names to an array be passed to emitDefFunc
+    const char** slots = (const char**) malloc(sizeof(char*) * slotNum);
+    List* slotName = slotNames;
+    for(uint32_t i = slotNum; i > 0; i--) {
+        slots[i - 1] = (const char*) slotName->head;
+        slotName = slotName->tail;
+    }
+    destroyShallowList(slotNames);
+
+    //the captured variables are numbered in the order transformCaptures
+    //found them
+    Map* capturedIndices = isInit ? NULL : createMap();
+    uint32_t capturedNum = lengthList(getFuncTokenCaptured(func));
+    const char** captured = (const char**) malloc(sizeof(char*) * capturedNum);
+    List* capturedName = getFuncTokenCaptured(func);
+    for(uint32_t i = 0; i < capturedNum; i++) {
+        captured[i] = getIdentifierTokenValue(
+                (IdentifierToken*) capturedName->head);
+        putMapStr(capturedIndices, captured[i], boxUint32(i));
+        capturedName = capturedName->tail;
+    }
+
     //indicate the beginning of the function
     emitSrcLoc(builder, tokenLocation((Token*) func));
-    uint8_t isInit = strcmp(getIdentifierTokenValue(getFuncTokenName(func)), "$init") == 0;
-    emitDefFunc(builder, argNum, (const char**) args, isInit);
-    free(args);
+    emitDefFunc(builder, argNum, slotNum, slots, capturedNum, captured, isInit);
+    free(slots);
+    free(captured);
 
     //create a label for each LabelToken and map its name to the value
     //associated with the ModuleBuilder
@@ -478,12 +639,23 @@ void compileFunc(ModuleBuilder* builder, Map* globalFuncs, FuncToken* func) {
         }
     }
 
+    CompileState state;
+    state.globalFuncs = globalFuncs;
+    state.funcs = funcs;
+    state.labels = labels;
+    state.locals = locals;
+    state.captured = capturedIndices;
+
     //finally, generate each statement / jump
     for(List* list = getBlockTokenChildren(getFuncTokenBody(func)); list != NULL; list = list->tail) {
-        compileToken(builder, globalFuncs, labels, (Token*) list->head);
+        compileToken(builder, &state, (Token*) list->head);
     }
 
     destroyMap(labels, nothing, free);
+    if(locals != NULL) {
+        destroyMap(locals, nothing, free);
+        destroyMap(capturedIndices, nothing, free);
+    }
 
     emitPushNone(builder);
     emitReturn(builder);
@@ -494,6 +666,8 @@ Module* compileModule(Token* ast) {
 
     //globalFuncs maps function names to labels
     Map* globalFuncs = createMap();
+    //funcs maps function names to FuncTokens
+    Map* funcs = createMap();
     BlockToken* block = (BlockToken*) ast;
     //create the module object / global scope as the local scope
     for(List* list = getBlockTokenChildren(block); list != NULL; list = list->tail) {
@@ -504,6 +678,8 @@ Module* compileModule(Token* ast) {
             putMapStr(globalFuncs,
                     newStr(getIdentifierTokenValue(getFuncTokenName(func))),
                     boxUint32(label));
+            putMapStr(funcs, getIdentifierTokenValue(getFuncTokenName(func)),
+                    func);
 
             //emitSrcLoc(builder, func->token.location);
             //emitCreateFunc(builder, label);
@@ -524,30 +700,39 @@ Module* compileModule(Token* ast) {
     for(List* list = getBlockTokenChildren(block); list != NULL; list = list->tail) {
         Token* token = (Token*) list->head;
         if(getTokenType(token) == TOKEN_FUNC) {
-            compileFunc(builder, globalFuncs, (FuncToken*) token);
+            compileFunc(builder, globalFuncs, funcs, (FuncToken*) token);
         }
     }
 
     uint32_t* labelEntry = (uint32_t*) getMapStr(globalFuncs, "$init");
+    optimizeBuilder(builder, *labelEntry);
     Module* module = builderToModule(builder, *labelEntry);
     destroyModuleBuilder(builder);
     destroyMap(globalFuncs, free, free);
+    destroyMap(funcs, nothing, nothing);
     return module;
 }
 
 void destroyModule(Module* module) {
-    for(uint32_t i = 0; i < module->constantsLength; i++) {
-        free((void*) module->constants[i]);
+    //the literals are indexed by constant, so they go first
+    destroyModuleCode(module);
+
+    if(module->cache != NULL) {
+        destroyModuleCache(module);
+    } else {
+        for(uint32_t i = 0; i < module->constantsLength; i++) {
+            free((void*) module->constants[i]);
+        }
+        free((void*) module->constants);
+        free((void*) module->constantHashes);
+        free((void*) module->bytecode);
+        free((void*) module->srcLoc);
     }
-    free((void*) module->constants);
     module->constants = NULL;
+    module->constantHashes = NULL;
     module->constantsLength = 0;
-
-    free((void*) module->bytecode);
     module->bytecode = NULL;
     module->bytecodeLength = 0;
-
-    free((void*) module->srcLoc);
     module->srcLoc = NULL;
     module->srcLocLength = 0;
 
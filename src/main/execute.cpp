@@ -2,76 +2,151 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <atomic>
 
+#include "main/allocs.h"
 #include "main/bytecode.h"
 #include "main/execute.h"
+#include "main/flags.h"
+#include "main/gc.h"
 #include "main/lib.h"
+#include "main/phases.h"
+#include "main/stats.h"
 #include "main/std_lib/modules.h"
 
 #define UNUSED(x) (void)(x)
 
+//offset of the first slot name from the start of an OP_DEF_FUNC header
+#define DEF_FUNC_SLOT_NAMES 6
+
+uint32_t readU32Module(Module* module, uint32_t index);
+const char* readConstantModule(Module* module, uint32_t index);
+uint32_t readConstantHashModule(Module* module, uint32_t index);
+
 Scope* createScope(Runtime* runtime, Scope* parent) {
     Scope* scope = (Scope*) malloc(sizeof(Scope));
     scope->parent = parent;
     scope->locals = createMap();
+    scope->func = NULL;
+    scope->slots = NULL;
+    scope->slotCount = 0;
+    scope->marked = 0;
     runtime->allocatedScopes = consList(scope, runtime->allocatedScopes);
+    runtime->allocationCount++;
+    runtime->allocationTotal++;
+    if(runtime->allocStats != NULL) {
+        countAlloc(runtime, ALLOC_SCOPE, sizeof(Scope));
+    }
     return scope;
 }
 
-void destroyScope(void* scope) {
-    destroyMap(((Scope*) scope)->locals, nothing, nothing);
-    free(scope);
+Scope* createSlotScope(Runtime* runtime, Scope* parent, Thing* func,
+        uint32_t slotCount) {
+    //the slots are allocated along with the scope
+    Scope* scope = (Scope*) malloc(sizeof(Scope) + sizeof(Thing*) * slotCount);
+    scope->parent = parent;
+    scope->locals = NULL;
+    scope->func = func;
+    scope->slots = (Thing**) (scope + 1);
+    scope->slotCount = slotCount;
+    for(uint32_t i = 0; i < slotCount; i++) {
+        scope->slots[i] = NULL;
+    }
+    scope->marked = 0;
+    runtime->allocatedScopes = consList(scope, runtime->allocatedScopes);
+    runtime->allocationCount++;
+    runtime->allocationTotal++;
+    if(runtime->allocStats != NULL) {
+        countAlloc(runtime, ALLOC_SCOPE,
+                sizeof(Scope) + sizeof(Thing*) * slotCount);
+    }
+    return scope;
 }
 
-Thing* getScopeValue(Scope* scope, const char* name) {
-    Thing* value = (Thing*) getMapStr(scope->locals, name);
-    if(value != NULL) {
-        return value;
-    } else if(scope->parent != NULL) {
-        return getScopeValue(scope->parent, name);
-    } else {
-        return NULL;
+void destroyScope(void* scope) {
+    if(((Scope*) scope)->locals != NULL) {
+        destroyMap(((Scope*) scope)->locals, nothing, nothing);
     }
+    free(scope);
 }
 
-void setScopeLocal(Scope* scope, const char* name, Thing* value) {
-    putMapStr(scope->locals, name, value);
+/**
+ * Returns the bytecode index of the name of the given slot in the scope's
+ * OP_DEF_FUNC header.
+ */
+uint32_t slotNameIndex(Scope* scope, uint32_t slot) {
+    return getFuncEntry(scope->func) + DEF_FUNC_SLOT_NAMES + slot * 4;
 }
 
-Scope* copyScope(Runtime* runtime, Scope* oldScope) {
-    Scope* newScope = createScope(runtime, oldScope);
-
-    while(oldScope != NULL) {
-        Entry* locals = oldScope->locals->entry;
+/**
+ * Returns the bytecode index of the name of the function's captured variable
+ * in its OP_DEF_FUNC header.
+ */
+uint32_t capturedNameIndex(Thing* func, uint32_t captured) {
+    Module* module = getFuncModule(func);
+    uint32_t index = getFuncEntry(func) + DEF_FUNC_SLOT_NAMES - 4;
+    uint32_t slotNum = readU32Module(module, index);
+    return index + 4 + slotNum * 4 + 4 + captured * 4;
+}
 
-        while(locals != NULL) {
-            if(getMapStr(newScope->locals, (const char*) locals->key) == NULL) {
-                setScopeLocal(newScope, (const char*) locals->key, (Thing*) locals->value);
+/**
+ * Looks up the name in the scope and its parents. hash must be hashStr(name).
+ */
+Thing* getScopeValue(Scope* scope, const char* name, uint32_t hash) {
+    while(scope != NULL) {
+        if(scope->locals != NULL) {
+            Thing* value = (Thing*) getMapStrHashed(scope->locals, name, hash);
+            if(value != NULL) {
+                return value;
+            }
+        } else {
+            Module* module = getFuncModule(scope->func);
+            for(uint32_t i = 0; i < scope->slotCount; i++) {
+                uint32_t index = slotNameIndex(scope, i);
+                if(scope->slots[i] != NULL &&
+                        readConstantHashModule(module, index) == hash &&
+                        strcmp(readConstantModule(module, index), name) == 0) {
+                    return scope->slots[i];
+                }
+            }
+            //the function's captured variables are visible too
+            Thing** captured = getFuncCaptured(scope->func);
+            uint32_t capturedNum = readU32Module(module,
+                    slotNameIndex(scope, scope->slotCount));
+            for(uint32_t i = 0; i < capturedNum; i++) {
+                uint32_t index = capturedNameIndex(scope->func, i);
+                if(captured[i] != NULL &&
+                        readConstantHashModule(module, index) == hash &&
+                        strcmp(readConstantModule(module, index), name) == 0) {
+                    return captured[i];
+                }
             }
-            locals = locals->tail;
         }
-
-        oldScope = oldScope->parent;
+        scope = scope->parent;
     }
+    return NULL;
+}
 
-    return newScope;
+void setScopeLocal(Scope* scope, const char* name, Thing* value) {
+    putMapStr(scope->locals, name, value);
 }
 
 /**
  * Creates a StackFrame for the invocation of the function.
  */
-StackFrame* createStackFrameDef(Module* module, uint32_t index, Scope* scope) {
-    StackFrame* frame = (StackFrame*) malloc(sizeof(StackFrame));
-    frame->type = STACK_FRAME_DEF;
-    frame->def.module = module;
-    frame->def.index = index;
-    frame->def.scope = scope;
+StackFrame createStackFrameDef(Module* module, uint32_t index, Scope* scope) {
+    StackFrame frame;
+    frame.type = STACK_FRAME_DEF;
+    frame.def.module = module;
+    frame.def.index = index;
+    frame.def.scope = scope;
     return frame;
 }
 
-StackFrame* createStackFrameNative() {
-    StackFrame* frame = (StackFrame*) malloc(sizeof(StackFrame));
-    frame->type = STACK_FRAME_NATIVE;
+StackFrame createStackFrameNative(Runtime* runtime) {
+    StackFrame frame;
+    frame.type = STACK_FRAME_NATIVE;
+    frame.native.pinnedLength = runtime->pinnedLength;
     return frame;
 }
 
@@ -79,13 +154,33 @@ Runtime* createRuntime(uint8_t argc, const char* args[]) {
     UNUSED(argc);
 
     Runtime* runtime = (Runtime*) malloc(sizeof(Runtime));
+    runtime->stackFrameLength = 0;
+    runtime->stackFrameLimit = 0;
     runtime->stackFrame = NULL;
-    runtime->stack = NULL;
+    setStackFrameLimit(runtime, DEFAULT_STACK_FRAME_LIMIT);
+    runtime->executeDepth = 0;
+    runtime->executeDepthLimit = DEFAULT_EXECUTE_DEPTH_LIMIT;
+    runtime->stackLength = 0;
+    runtime->stackCapacity = 256;
+    runtime->stack = (Thing**) malloc(sizeof(Thing*) * runtime->stackCapacity);
+    runtime->oldStacks = NULL;
     runtime->allocatedThings = NULL;
     runtime->allocatedScopes = NULL;
+    runtime->pinnedLength = 0;
+    runtime->pinnedCapacity = 64;
+    runtime->pinned = (Thing**) malloc(sizeof(Thing*) * runtime->pinnedCapacity);
+    runtime->allocationCount = 0;
+    runtime->collectThreshold = GC_INITIAL_THRESHOLD;
+    runtime->allocationTotal = 0;
+    runtime->markStackLength = 0;
+    runtime->markStackCapacity = 64;
+    runtime->markStack = (Thing**) malloc(sizeof(Thing*) *
+            runtime->markStackCapacity);
     runtime->noneThing = createNoneThing(runtime);
     runtime->modules = createMap();
     runtime->moduleBytecode = NULL;
+    runtime->stats = NULL;
+    runtime->allocStats = NULL;
 
     uint32_t i;
     for(i = strlen(args[0]); i > 0; i--) {
@@ -109,6 +204,15 @@ Runtime* createRuntime(uint8_t argc, const char* args[]) {
     putMapStr(ops, "<=", createSymbolThing(runtime, SYM_LESS_THAN_EQ, 2));
     putMapStr(ops, ">", createSymbolThing(runtime, SYM_GREATER_THAN, 2));
     putMapStr(ops, ">=", createSymbolThing(runtime, SYM_GREATER_THAN_EQ, 2));
+
+    //the operator opcodes use these directly
+    const char* operatorNames[OPERATOR_OPCODES] = {
+        "+", "-", "*", "/", "==", "!=", "<", "<=", ">", ">="
+    };
+    for(uint32_t k = 0; k < OPERATOR_OPCODES; k++) {
+        runtime->operatorSymbols[k] = (Thing*) getMapStr(ops, operatorNames[k]);
+    }
+
     putMapStr(ops, "and", createSymbolThing(runtime, SYM_AND, 2));
     putMapStr(ops, "or", createSymbolThing(runtime, SYM_OR, 2));
     putMapStr(ops, "not", createSymbolThing(runtime, SYM_NOT, 1));
@@ -153,47 +257,78 @@ Runtime* createRuntime(uint8_t argc, const char* args[]) {
     return runtime;
 }
 
+/**
+ * Destroys an imported module. Imported modules own their name, which is the
+ * path they were loaded from.
+ */
 void destroyModuleVoid(void* module) {
+    free((char*) ((Module*) module)->name);
     destroyModule((Module*) module);
 }
 
+void setStackFrameLimit(Runtime* runtime, uint32_t limit) {
+    runtime->stackFrameLimit = limit;
+    runtime->stackFrame = (StackFrame*) realloc(runtime->stackFrame,
+            sizeof(StackFrame) * limit);
+}
+
 void destroyRuntime(Runtime* runtime) {
-    destroyList(runtime->stackFrame, free);
-    destroyShallowList(runtime->stack);
+    free(runtime->stackFrame);
+    free(runtime->stack);
+    destroyList(runtime->oldStacks, free);
     destroyList(runtime->allocatedThings, (void (*)(void*)) destroyThing);
     destroyList(runtime->allocatedScopes, destroyScope);
     destroyMap(runtime->operators, nothing, nothing);
-    destroyMap(runtime->modules, nothing, nothing);
+    destroyMap(runtime->modules, free, nothing);
     destroyList(runtime->moduleBytecode, destroyModuleVoid);
+    free(runtime->pinned);
+    free(runtime->markStack);
     free((char*) runtime->execDir);
     free(runtime);
     destroyBuiltinModules();
 }
 
-StackFrame* currentStackFrame(Runtime* runtime) {
-    return (StackFrame*) runtime->stackFrame->head;
+inline StackFrame* currentStackFrame(Runtime* runtime) {
+    return &runtime->stackFrame[runtime->stackFrameLength - 1];
 }
 
-void pushStackFrame(Runtime* runtime, StackFrame* frame) {
-    runtime->stackFrame = consList(frame, runtime->stackFrame);
+/**
+ * Pushes a copy of the given frame onto the call stack.
+ *
+ * @return nonzero if the stack frame limit has been reached, in which case
+ *      nothing is pushed.
+ */
+inline uint8_t pushStackFrame(Runtime* runtime, StackFrame frame) {
+    if(runtime->stackFrameLength == runtime->stackFrameLimit) {
+        return 1;
+    }
+    runtime->stackFrame[runtime->stackFrameLength] = frame;
+    //the profiler's signal handler reads the frames below stackFrameLength,
+    //so the frame must be written first
+    std::atomic_signal_fence(std::memory_order_release);
+    runtime->stackFrameLength++;
+    return 0;
 }
 
-void popStackFrame(Runtime* runtime) {
-    List* toDelete = runtime->stackFrame;
-    runtime->stackFrame = runtime->stackFrame->tail;
-    free(toDelete->head);
-    free(toDelete);
+inline void popStackFrame(Runtime* runtime) {
+    StackFrame* frame = currentStackFrame(runtime);
+    if(frame->type == STACK_FRAME_NATIVE) {
+        runtime->pinnedLength = frame->native.pinnedLength;
+    }
+    runtime->stackFrameLength--;
 }
 
-uint32_t stackFrameSize(Runtime* runtime) {
-    return lengthList(runtime->stackFrame);
+inline uint32_t stackFrameSize(Runtime* runtime) {
+    return runtime->stackFrameLength;
 }
 
-uint32_t stackSize(Runtime* runtime) {
-    return lengthList(runtime->stack);
+RetVal throwStackOverflow(Runtime* runtime) {
+    return throwMsg(runtime, newStr("stack overflow"));
 }
 
-Thing* popStack(Runtime* runtime);
+uint32_t stackSize(Runtime* runtime) {
+    return runtime->stackLength;
+}
 
 void unwindStackFrame(Runtime* runtime, uint32_t initStackFrameSize,
         uint32_t initStackSize) {
@@ -201,40 +336,37 @@ void unwindStackFrame(Runtime* runtime, uint32_t initStackFrameSize,
         popStackFrame(runtime);
     }
 
-    while(stackSize(runtime) > initStackSize) {
-        popStack(runtime);
-    }
+    runtime->stackLength = initStackSize;
 }
 
-void pushStack(Runtime* runtime, Thing* thing) {
-    runtime->stack = consList(thing, runtime->stack);
+/**
+ * Doubles the capacity of the stack. The old array is not freed since native
+ * functions may still be reading their arguments from it.
+ */
+void growStack(Runtime* runtime) {
+    Thing** old = runtime->stack;
+    runtime->stackCapacity *= 2;
+    runtime->stack = (Thing**) malloc(sizeof(Thing*) * runtime->stackCapacity);
+    memcpy(runtime->stack, old, sizeof(Thing*) * runtime->stackLength);
+    runtime->oldStacks = consList(old, runtime->oldStacks);
 }
 
-Thing* popStack(Runtime* runtime) {
-    Thing* thing = (Thing*) runtime->stack->head;
-    List* toDelete = runtime->stack;
-    runtime->stack = runtime->stack->tail;
-    free(toDelete);
-    return thing;
+inline void pushStack(Runtime* runtime, Thing* thing) {
+    if(runtime->stackLength == runtime->stackCapacity) {
+        growStack(runtime);
+    }
+    runtime->stack[runtime->stackLength++] = thing;
 }
 
-Thing* peekStackIndex(Runtime* runtime, uint32_t index) {
-    List* stack = runtime->stack;
-    for(uint32_t i = 0; i < index; i++) {
-        stack = stack->tail;
-    }
-    return (Thing*) stack->head;
+inline Thing* popStack(Runtime* runtime) {
+    return runtime->stack[--runtime->stackLength];
 }
 
 /**
- * Reads an unsigned int operand at the given index in the given module.
+ * Returns the item that is index items below the top of the stack.
  */
-int32_t readI32Module(Module* module, uint32_t index) {
-    int32_t arg = module->bytecode[index] << 24;
-    arg |= module->bytecode[index + 1] << 16;
-    arg |= module->bytecode[index + 2] << 8;
-    arg |= module->bytecode[index + 3];
-    return arg;
+inline Thing* peekStackIndex(Runtime* runtime, uint32_t index) {
+    return runtime->stack[runtime->stackLength - index - 1];
 }
 
 /**
@@ -248,242 +380,866 @@ uint32_t readU32Module(Module* module, uint32_t index) {
     return arg;
 }
 
-float readFloatModule(Module* module, uint32_t index) {
-    //bitwise cast uint32_t to float
-    uint32_t arg = readU32Module(module, index);
-    return *((float*) &arg);
-}
-
 const char* readConstantModule(Module* module, uint32_t index) {
     return module->constants[readU32Module(module, index)];
 }
 
-StackFrame* createFrameCall(Runtime* runtime, Thing* func, uint32_t argNo,
+/**
+ * Returns the hash of the constant that readConstantModule would return.
+ */
+uint32_t readConstantHashModule(Module* module, uint32_t index) {
+    return module->constantHashes[readU32Module(module, index)];
+}
+
+/**
+ * Fills in the call cache entry for calling the given function with argNo
+ * arguments.
+ *
+ * @return 0 if the function cannot be called with that many arguments
+ */
+uint8_t resolveFuncCall(Thing* func, uint32_t argNo, CallCacheEntry* entry) {
+    Module* module = getFuncModule(func);
+    uint32_t index = module->codeIndex[getFuncEntry(func)];
+    Instruction* header = &module->code[index];
+    if(header->opcode != OP_DEF_FUNC) {
+        return 0;
+    }
+
+    //check that the provided number of arguments equals the function's arity
+    if(header->arg.u != argNo) {
+        return 0;
+    }
+
+    entry->kind = CALL_CACHE_FUNC;
+    entry->opcode = 0;
+    entry->arity = argNo;
+    entry->key = getFuncEntry(func);
+    entry->module = module;
+    entry->receiverType = TYPE_UNDEF;
+    entry->shape = NULL;
+    entry->index = index + 1;
+    entry->slotNum = header->extra;
+    return 1;
+}
+
+/**
+ * Creates the frame of a call to a function resolved by resolveFuncCall.
+ */
+inline StackFrame createFrameResolved(Runtime* runtime, Thing* func,
+        uint32_t argNo, Thing** args, CallCacheEntry* entry) {
+    Scope* scope = createSlotScope(runtime, getFuncParentScope(func), func,
+            entry->slotNum);
+
+    //the arguments occupy the first slots
+    for(uint32_t i = 0; i < argNo; i++) {
+        scope->slots[i] = args[i];
+    }
+
+    return createStackFrameDef((Module*) entry->module, entry->index, scope);
+}
+
+StackFrame createFrameCall(Runtime* runtime, Thing* func, uint32_t argNo,
         Thing** args, uint8_t* error) {
+    StackFrame frame = {};
+    CallCacheEntry entry;
+
     //currently, native code can only call blerg code
-    if(typeOfThing(func) != TYPE_FUNC) {
+    if(typeOfThing(func) != TYPE_FUNC || !resolveFuncCall(func, argNo, &entry)) {
         *error = 1;
-        return NULL;
+        return frame;
     }
-    uint32_t index = getFuncEntry(func);
-    uint8_t opcode = getFuncModule(func)->bytecode[index++];
-    if(opcode != OP_DEF_FUNC) {
-        *error = 1;
-        return NULL;
+
+    return createFrameResolved(runtime, func, argNo, args, &entry);
+}
+
+/**
+ * Fills in the call cache entry for sending the given symbol to the receiver.
+ *
+ * @return 0 if the symbol cannot be called with that many arguments
+ */
+uint8_t resolveSymbolCall(Runtime* runtime, Thing* symbol, uint8_t arity,
+        Thing* receiver, CallCacheEntry* entry) {
+    if(arity != getSymbolArity(symbol)) {
+        return 0;
     }
 
-    //check that the provided number of arguments equals the function's arity
-    if(getFuncModule(func)->bytecode[index++] != argNo) {
-        *error = 1;
-        return NULL;
+    uint32_t id = getSymbolId(symbol);
+    ThingType receiverType = typeOfThing(receiver);
+    entry->kind = CALL_CACHE_DISPATCH;
+    entry->opcode = 0;
+    entry->arity = arity;
+    entry->key = id;
+    entry->module = NULL;
+    entry->receiverType = receiverType;
+    entry->shape = NULL;
+    entry->index = 0;
+    entry->slotNum = 0;
+
+    if(receiverType == TYPE_OBJECT) {
+        //objects without the symbol dispatch it themselves
+        entry->shape = getObjectShape(receiver);
+        if(findShapeSlot(getObjectShape(receiver), id, &entry->index)) {
+            entry->kind = CALL_CACHE_PROPERTY;
+        }
+    } else if(arity == 2 &&
+            (receiverType == TYPE_INT || receiverType == TYPE_FLOAT)) {
+        for(uint8_t i = 0; i < OPERATOR_OPCODES; i++) {
+            if(getSymbolId(runtime->operatorSymbols[i]) == id) {
+                entry->kind = CALL_CACHE_OPERATOR;
+                entry->opcode = OP_ADD + i;
+            }
+        }
     }
+    return 1;
+}
 
-    //if its the init function, the local scope is the parent scope
-    Scope* scope = createScope(runtime, getFuncParentScope(func));
+/**
+ * Returns the call site's entry for the given function, or NULL if the call
+ * site has not called it with that many arguments.
+ */
+inline CallCacheEntry* findFuncCache(CallCache* cache, Thing* func,
+        uint8_t arity) {
+    Module* module = getFuncModule(func);
+    uint32_t entry = getFuncEntry(func);
+    for(uint32_t i = 0; i < cache->length; i++) {
+        CallCacheEntry* cached = &cache->entries[i];
+        if(cached->module == module && cached->key == entry &&
+                cached->arity == arity) {
+            return cached;
+        }
+    }
+    return NULL;
+}
 
-    //assign the arguments provided to the names of the variables in the local
-    //scope.
-    for(uint32_t i = 0; i < argNo; i++) {
-        const char* constant = readConstantModule(getFuncModule(func), index);
-        setScopeLocal(scope, constant, args[i]);
-        index += 4;
+/**
+ * Returns the call site's entry for sending the symbol with the given id to
+ * a receiver of the given type and shape, or NULL if the call site has not
+ * done so.
+ */
+inline CallCacheEntry* findSymbolCache(CallCache* cache, uint32_t id,
+        ThingType receiverType, Shape* shape) {
+    for(uint32_t i = 0; i < cache->length; i++) {
+        CallCacheEntry* cached = &cache->entries[i];
+        if(cached->module == NULL && cached->key == id &&
+                cached->receiverType == receiverType &&
+                cached->shape == shape) {
+            return cached;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Adds the resolved entry to the call site's cache if there is room. Returns
+ * the entry to use for the call.
+ */
+CallCacheEntry* addCallCache(CallCache* cache, CallCacheEntry* resolved) {
+    if(cache->length == CALL_CACHE_ENTRIES) {
+        return resolved;
+    }
+    CallCacheEntry* entry = &cache->entries[cache->length++];
+    *entry = *resolved;
+    return entry;
+}
+
+/**
+ * Applies the operator of an operator opcode to two ints or two floats, just
+ * as the opcode's instruction does.
+ */
+Thing* applyNumericOperator(Runtime* runtime, uint8_t opcode, Thing* left,
+        Thing* right) {
+    if(typeOfThing(left) == TYPE_INT) {
+        int32_t a = thingAsInt(left);
+        int32_t b = thingAsInt(right);
+        switch(opcode) {
+        case OP_ADD: return createIntThing(runtime, a + b);
+        case OP_SUB: return createIntThing(runtime, a - b);
+        case OP_MUL: return createIntThing(runtime, a * b);
+        case OP_DIV: return createIntThing(runtime, a / b);
+        case OP_EQ: return createBoolThing(runtime, a == b);
+        case OP_NOT_EQ: return createBoolThing(runtime, a != b);
+        case OP_LESS_THAN: return createBoolThing(runtime, a < b);
+        case OP_LESS_THAN_EQ: return createBoolThing(runtime, a <= b);
+        case OP_GREATER_THAN: return createBoolThing(runtime, a > b);
+        default: return createBoolThing(runtime, a >= b);
+        }
+    } else {
+        float a = thingAsFloat(left);
+        float b = thingAsFloat(right);
+        switch(opcode) {
+        case OP_ADD: return createFloatThing(runtime, a + b);
+        case OP_SUB: return createFloatThing(runtime, a - b);
+        case OP_MUL: return createFloatThing(runtime, a * b);
+        case OP_DIV: return createFloatThing(runtime, a / b);
+        case OP_EQ: return createBoolThing(runtime, a == b);
+        case OP_NOT_EQ: return createBoolThing(runtime, a != b);
+        case OP_LESS_THAN: return createBoolThing(runtime, a < b);
+        case OP_LESS_THAN_EQ: return createBoolThing(runtime, a <= b);
+        case OP_GREATER_THAN: return createBoolThing(runtime, a > b);
+        default: return createBoolThing(runtime, a >= b);
+        }
     }
+}
 
-    return createStackFrameDef(getFuncModule(func), index, scope);
+/**
+ * Calls the symbol of an operator opcode with the top two values of the stack
+ * as its arguments. The arguments are left on the stack.
+ */
+RetVal callOperator(Runtime* runtime, uint8_t opcode) {
+    Thing* symbol = runtime->operatorSymbols[opcode - OP_ADD];
+    Thing** args = &runtime->stack[runtime->stackLength - 2];
+    if(pushStackFrame(runtime, createStackFrameNative(runtime))) {
+        return throwStackOverflow(runtime);
+    }
+    RetVal ret = symbol->call(runtime, symbol, args, 2);
+    popStackFrame(runtime);
+    return ret;
 }
 
 /**
- * Executes the given bytecode. Since there are so many arguments, the
- * arguments are stored in a struct.
+ * Fills in the handler of each of the module's instructions. The first time
+ * a module is threaded, its literals are also created, so that
+ * OP_PUSH_LITERAL pushes the same thing every time it executes instead of
+ * allocating one, and each call site is given a cache.
+ *
+ * @param handlers the handler of each opcode
+ * @param handlerCount the length of handlers
+ * @param unknown the handler of opcodes without one
+ * @param threaded identifies the version of executeCode the handlers belong
+ *      to
+ */
+void threadModule(Module* module, const void* const* handlers,
+        uint32_t handlerCount, const void* unknown, uint8_t threaded) {
+    uint8_t first = !module->threaded;
+    if(first) {
+        module->literals = (Thing**) calloc(module->constantsLength,
+                sizeof(Thing*));
+    }
+    for(uint32_t i = 0; i <= module->codeLength; i++) {
+        Instruction* instr = &module->code[i];
+        if(instr->opcode < handlerCount && handlers[instr->opcode] != NULL) {
+            instr->handler = handlers[instr->opcode];
+        } else {
+            instr->handler = unknown;
+        }
+        if(!first) {
+            continue;
+        } else if(instr->opcode == OP_PUSH_LITERAL) {
+            uint32_t constant = readU32Module(module, instr->offset + 1);
+            if(module->literals[constant] == NULL) {
+                module->literals[constant] = createLiteralStrThing(
+                        instr->arg.str);
+            }
+            instr->arg.thing = module->literals[constant];
+        } else if(instr->opcode == OP_CALL || instr->opcode == OP_TAIL_CALL) {
+            instr->extra = module->callCachesLength++;
+        }
+    }
+    if(first) {
+        module->callCaches = (CallCache*) calloc(module->callCachesLength,
+                sizeof(CallCache));
+    }
+    module->threaded = threaded;
+}
+
+/**
+ * The statistics policy of executeCode when runtime->stats is NULL. Nothing
+ * is counted, so the calls compile to nothing.
+ */
+struct NoStats {
+    //the value of Module.threaded for this version of executeCode
+    static const uint8_t THREADED = 1;
+
+    static inline void instruction(Runtime*, uint8_t) {}
+    static inline void call(Runtime*, Thing*, Thing**, uint8_t) {}
+    static inline void func(Runtime*, const Module*, uint32_t) {}
+};
+
+/**
+ * The statistics policy of executeCode when runtime->stats is set.
+ */
+struct CountStats {
+    static const uint8_t THREADED = 2;
+
+    static inline void instruction(Runtime* runtime, uint8_t opcode) {
+        countOpcode(runtime->stats, opcode);
+    }
+
+    static inline void call(Runtime* runtime, Thing* callee, Thing** args,
+            uint8_t arity) {
+        countCall(runtime->stats, callee, args, arity);
+    }
+
+    static inline void func(Runtime* runtime, const Module* module,
+            uint32_t index) {
+        countFunc(runtime->stats, module, index);
+    }
+};
+
+//taking the address of a label is a GCC extension
+#if USE_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+/**
+ * Executes the code of the given frame until it returns.
  *
- * @param allArgs.runtime the runtime object
- * @param allArgs.entryModule the module of the code being executed
- * @param allArgs.entryIndex the index to start execution
- * @param allArgs.bottomScope the scope that the code is executed under. It is
- *          the scope of the bottom stackframe.
- * @param error set to a nonzero value upon error
+ * @param runtime the runtime object
+ * @param frame the frame to execute. It becomes the bottom stackframe of this
+ *          invocation.
  * @returns the value returned from the invocation / bottom stackframe.
+ * @tparam Stats NoStats or CountStats
  */
-RetVal executeCode(Runtime* runtime, StackFrame* frame) {
-    //TODO have index increments in the readXModule functions
+template<typename Stats>
+static RetVal executeCodeWith(Runtime* runtime, StackFrame frame) {
     //TODO check if stack is empty
     uint32_t initStackFrameSize = stackFrameSize(runtime);
     uint32_t initStackSize = stackSize(runtime);
 
-    pushStackFrame(runtime, frame);
+    if(pushStackFrame(runtime, frame)) {
+        return throwStackOverflow(runtime);
+    }
+    Stats::func(runtime, frame.def.module, frame.def.index);
 
-    while(stackFrameSize(runtime) > initStackFrameSize) {
-        StackFrame* currentFrame = currentStackFrame(runtime);
+    //the state of the current frame. The frame's index is kept up to date
+    //before each instruction for error messages.
+    StackFrame* currentFrame;
+    Module* module;
+    Instruction* code;
+    Instruction* ip;
+    RetVal error;
+
+#if USE_COMPUTED_GOTO
+    static const void* const handlers[] = {
+        &&label_OP_PUSH_INT,
+        &&label_OP_PUSH_FLOAT,
+        &&label_OP_PUSH_BUILTIN,
+        &&label_OP_PUSH_LITERAL,
+        &&label_OP_PUSH_NONE,
+        &&label_OP_CALL,
+        &&label_OP_RETURN,
+        &&label_OP_CREATE_FUNC,
+        &&label_OP_LOAD,
+        &&label_OP_STORE,
+        NULL, //OP_COND_JUMP_TRUE is never used
+        &&label_OP_COND_JUMP_FALSE,
+        &&label_OP_ABS_JUMP,
+        &&label_OP_DUP,
+        &&label_OP_ROT3,
+        &&label_OP_SWAP,
+        &&label_OP_POP,
+        &&label_OP_CHECK_NONE,
+        NULL, //OP_DEF_FUNC is never executed
+        &&label_OP_LOAD_LOCAL,
+        &&label_OP_STORE_LOCAL,
+        &&label_OP_LOAD_CAPTURED,
+        &&label_OP_ADD,
+        &&label_OP_SUB,
+        &&label_OP_MUL,
+        &&label_OP_DIV,
+        &&label_OP_EQ,
+        &&label_OP_NOT_EQ,
+        &&label_OP_LESS_THAN,
+        &&label_OP_LESS_THAN_EQ,
+        &&label_OP_GREATER_THAN,
+        &&label_OP_GREATER_THAN_EQ,
+        &&label_OP_TAIL_CALL
+    };
+    const uint32_t handlerCount = sizeof(handlers) / sizeof(handlers[0]);
+
+#define CASE(opcode) label_##opcode:
+#define DEFAULT label_default:
+#define DISPATCH() \
+    do { \
+        maybeCollectGarbage(runtime); \
+        currentFrame->def.index = ip - code; \
+        Stats::instruction(runtime, ip->opcode); \
+        goto *ip->handler; \
+    } while(0)
+#define THREAD() \
+    if(module->threaded != Stats::THREADED) { \
+        threadModule(module, handlers, handlerCount, &&label_default, \
+                Stats::THREADED); \
+    }
+#else
+#define CASE(opcode) case opcode:
+#define DEFAULT default:
+#define DISPATCH() goto dispatch
+#define THREAD() \
+    if(!module->threaded) { \
+        threadModule(module, NULL, 0, NULL, Stats::THREADED); \
+    }
+#endif
+
+//loads the state of the frame on top of the stack
+#define LOAD_FRAME() \
+    do { \
+        currentFrame = currentStackFrame(runtime); \
+        module = currentFrame->def.module; \
+        THREAD(); \
+        code = module->code; \
+        ip = &code[currentFrame->def.index]; \
+    } while(0)
+
+#define THROW(msg) \
+    do { \
+        error = throwMsg(runtime, msg); \
+        goto unwind; \
+    } while(0)
+
+//Handles an operator opcode. intResult and floatResult create the result from
+//the operands a and b when they are both ints or both floats.
+#define OPERATOR(opcode, intResult, floatResult) \
+    CASE(opcode) { \
+        Thing* left = runtime->stack[runtime->stackLength - 2]; \
+        Thing* right = runtime->stack[runtime->stackLength - 1]; \
+        ThingType leftType = typeOfThing(left); \
+        ThingType rightType = typeOfThing(right); \
+        Thing* result; \
+        if(leftType == TYPE_INT && rightType == TYPE_INT) { \
+            int32_t a = thingAsInt(left); \
+            int32_t b = thingAsInt(right); \
+            result = intResult; \
+        } else if(leftType == TYPE_FLOAT && rightType == TYPE_FLOAT) { \
+            float a = thingAsFloat(left); \
+            float b = thingAsFloat(right); \
+            result = floatResult; \
+        } else { \
+            RetVal ret = callOperator(runtime, opcode); \
+            if(isRetValError(ret)) { \
+                error = ret; \
+                goto unwind; \
+            } \
+            result = getRetVal(ret); \
+        } \
+        runtime->stackLength -= 2; \
+        pushStack(runtime, result); \
+        ip++; \
+        DISPATCH(); \
+    }
+
+    LOAD_FRAME();
+
+#if USE_COMPUTED_GOTO
+    DISPATCH();
+    {
+#else
+dispatch:
+    //everything live is reachable from the roots between instructions
+    maybeCollectGarbage(runtime);
+    currentFrame->def.index = ip - code;
+    Stats::instruction(runtime, ip->opcode);
+    switch(ip->opcode) {
+#endif
+    CASE(OP_PUSH_INT) {
+        pushStack(runtime, createIntThing(runtime, ip->arg.i));
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_PUSH_FLOAT) {
+        pushStack(runtime, createFloatThing(runtime, ip->arg.f));
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_PUSH_BUILTIN) {
+        Thing* value = (Thing*) getMapStrHashed(runtime->operators,
+                ip->arg.str, ip->extra);
+        if(value == NULL) {
+            const char* format = "internal error: builtin '%s' not found";
+            THROW(formatStr(format, ip->arg.str));
+        }
+        pushStack(runtime, value);
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_PUSH_LITERAL) {
+        pushStack(runtime, ip->arg.thing);
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_PUSH_NONE) {
+        pushStack(runtime, runtime->noneThing);
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_RETURN) {
+        Thing* retVal = popStack(runtime);
+        popStackFrame(runtime);
+        if(stackFrameSize(runtime) == initStackFrameSize) {
+            return createRetVal(retVal, 0);
+        }
+        pushStack(runtime, retVal);
 
         //sanity check, native frames should end before the interpreter loop.
         //if this fails then there is some sort of internal error.
-        if(currentFrame->type != STACK_FRAME_DEF) {
+        if(currentStackFrame(runtime)->type != STACK_FRAME_DEF) {
             //unwindStackFrame is not called here since the stack is messed up
             //anyway
             const char* msg = "internal error: native frame not ended before def frame";
             return throwMsg(runtime, newStr(msg));
         }
-
-        Module* module = currentFrame->def.module;
-        uint32_t index = currentFrame->def.index;
-        unsigned char opcode = module->bytecode[index];
-        index++;
-        uint8_t storeIndex = 1;
-
-        if(opcode == OP_PUSH_INT) {
-            int32_t value = readI32Module(module, index);
-            index += 4;
-            pushStack(runtime, createIntThing(runtime, value));
-        } else if(opcode == OP_PUSH_FLOAT) {
-            float value = readFloatModule(module, index);
-            index += 4;
-            pushStack(runtime, createFloatThing(runtime, value));
-        } else if(opcode == OP_PUSH_BUILTIN) {
-            const char* constant = readConstantModule(module, index);
-            index += 4;
-            Thing* value = (Thing*) getMapStr(runtime->operators, constant);
+        LOAD_FRAME();
+        DISPATCH();
+    }
+    CASE(OP_CREATE_FUNC) {
+        uint32_t capturedNum = ip->extra;
+        Scope* scope = currentFrame->def.scope;
+        Thing* toPush = createFuncThing(runtime, ip->arg.u, module, scope,
+                capturedNum);
+        Thing** captured = getFuncCaptured(toPush);
+        uint32_t unresolved = 0;
+        for(uint32_t i = 0; i < capturedNum; i++) {
+            Instruction* capture = &ip[i + 1];
+            if(capture->opcode == CAPTURE_LOCAL) {
+                captured[i] = scope->slots[capture->arg.u];
+            } else if(capture->opcode == CAPTURE_CAPTURED) {
+                captured[i] = getFuncCaptured(scope->func)[capture->arg.u];
+            } else {
+                captured[i] = getScopeValue(scope, capture->arg.str,
+                        capture->extra);
+            }
+            //variables not assigned yet are looked up in the current scope
+            //as it is right now
+            if(captured[i] == NULL && capture->opcode != CAPTURE_NAME) {
+                uint32_t nameIndex = capturedNameIndex(toPush, i);
+                captured[i] = getScopeValue(scope,
+                        readConstantModule(module, nameIndex),
+                        readConstantHashModule(module, nameIndex));
+            }
+            if(captured[i] == NULL) {
+                unresolved++;
+            }
+        }
+        setFuncUnresolved(toPush, unresolved);
+        pushStack(runtime, toPush);
+        ip += 1 + capturedNum;
+        DISPATCH();
+    }
+    CASE(OP_LOAD) {
+        Thing* value = getScopeValue(currentFrame->def.scope, ip->arg.str,
+                ip->extra);
+        if(value == NULL) {
+            THROW(formatStr("'%s' is undefined", ip->arg.str));
+        }
+        pushStack(runtime, value);
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_STORE) {
+        Thing* value = popStack(runtime);
+        putMapStrHashed(currentFrame->def.scope->locals, ip->arg.str,
+                ip->extra, value);
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_LOAD_LOCAL) {
+        Scope* scope = currentFrame->def.scope;
+        Thing* value = scope->slots[ip->arg.u];
+        if(value == NULL) {
+            //the variable is not assigned yet, so it may refer to a
+            //variable of the same name in an enclosing scope. The function
+            //captures the variable if it belongs to an enclosing function.
+            uint32_t nameIndex = slotNameIndex(scope, ip->arg.u);
+            const char* constant = readConstantModule(module, nameIndex);
+            value = getScopeValue(scope, constant,
+                    readConstantHashModule(module, nameIndex));
             if(value == NULL) {
-                const char* format = "internal error: builtin '%s' not found";
-                RetVal error = throwMsg(runtime, formatStr(format, constant));
-                unwindStackFrame(runtime, initStackFrameSize, initStackSize);
-                return error;
+                THROW(formatStr("'%s' is undefined", constant));
             }
-            pushStack(runtime, value);
-        } else if(opcode == OP_PUSH_LITERAL) {
-            const char* constant = readConstantModule(module, index);
-            index += 4;
-            Thing* value = createStrThing(runtime, constant, 1);
-            pushStack(runtime, value);
-        } else if(opcode == OP_PUSH_NONE) {
-            pushStack(runtime, runtime->noneThing);
-        } else if(opcode == OP_RETURN) {
-            Thing* retVal = popStack(runtime);
-            popStackFrame(runtime);
-            pushStack(runtime, retVal);
-            storeIndex = 0;
-        } else if(opcode == OP_CREATE_FUNC) {
-            uint32_t entry = readU32Module(module, index);
-            index += 4;
-            Scope* scope = copyScope(runtime, currentFrame->def.scope);
-            Thing* toPush = createFuncThing(runtime, entry, module, scope);
-            pushStack(runtime, toPush);
-        } else if(opcode == OP_LOAD) {
-            const char* constant = readConstantModule(module, index);
-            index += 4;
-            Thing* value = getScopeValue(currentFrame->def.scope, constant);
+        }
+        pushStack(runtime, value);
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_STORE_LOCAL) {
+        currentFrame->def.scope->slots[ip->arg.u] = popStack(runtime);
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_LOAD_CAPTURED) {
+        Thing* func = currentFrame->def.scope->func;
+        Thing* value = getFuncCaptured(func)[ip->arg.u];
+        if(value == NULL) {
+            //the variable was not assigned when the function was created,
+            //so look it up where the function was created. The value is kept
+            //from then on, just like the values assigned at creation.
+            uint32_t nameIndex = capturedNameIndex(func, ip->arg.u);
+            const char* constant = readConstantModule(module, nameIndex);
+            value = getScopeValue(getFuncParentScope(func), constant,
+                    readConstantHashModule(module, nameIndex));
             if(value == NULL) {
-                const char* msg = formatStr("'%s' is undefined", constant);
-                RetVal error = throwMsg(runtime, msg);
-                unwindStackFrame(runtime, initStackFrameSize, initStackSize);
-                return error;
+                THROW(formatStr("'%s' is undefined", constant));
             }
-            pushStack(runtime, value);
-        } else if(opcode == OP_STORE) {
-            const char* constant = readConstantModule(module, index);
-            index += 4;
-            Thing* value = popStack(runtime);
-            putMapStr(currentFrame->def.scope->locals, constant, value);
-        } else if(opcode == OP_CALL) {
-            //TODO fix conversion
-            uint8_t arity = (unsigned int) readU32Module(module, index);
-            index += 4;
-            Thing* func = peekStackIndex(runtime, arity);
-            Thing** args = (Thing**) malloc(arity * sizeof(Thing*));
-            for(uint8_t i = 0; i < arity; i++) {
-                args[arity - i - 1] = popStack(runtime);
+            resolveFuncCaptured(func, ip->arg.u, value);
+        }
+        pushStack(runtime, value);
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_CALL)
+    CASE(OP_TAIL_CALL) {
+        //TODO fix conversion
+        uint8_t arity = (uint8_t) ip->arg.u;
+        Thing* func = peekStackIndex(runtime, arity);
+        //the arguments are read in place. The function and arguments are
+        //left on the stack during native calls so that the garbage
+        //collector can see them.
+        Thing** args = &runtime->stack[runtime->stackLength - arity];
+        CallCache* cache = &module->callCaches[ip->extra];
+        CallCacheEntry resolved;
+        CallCacheEntry* entry;
+        StackFrame frame;
+        RetVal ret;
+        Stats::call(runtime, func, args, arity);
+
+        if(typeOfThing(func) == TYPE_FUNC) {
+            goto callFunc;
+        } else if(typeOfThing(func) != TYPE_SYMBOL || arity == 0) {
+            goto callNative;
+        }
+
+        {
+            uint32_t id = getSymbolId(func);
+            ThingType receiverType = typeOfThing(args[0]);
+            Shape* shape = NULL;
+            if(receiverType == TYPE_OBJECT) {
+                shape = getObjectShape(args[0]);
             }
-            popStack(runtime); //pop the function
-            if(typeOfThing(func) == TYPE_FUNC) {
-                uint8_t error = 0;
-                StackFrame* frame = createFrameCall(runtime, func, arity, args,
-                        &error);
-                if(error) {
-                    free(args);
-                    //TODO make this error message better
-                    const char* msg = "error creating stack frame for "
-                            "function call";
-                    RetVal error = throwMsg(runtime, newStr(msg));
-                    unwindStackFrame(runtime, initStackFrameSize, initStackSize);
-                    return error;
+            entry = findSymbolCache(cache, id, receiverType, shape);
+            if(entry == NULL) {
+                if(!resolveSymbolCall(runtime, func, arity, args[0],
+                        &resolved)) {
+                    //the symbol reports the wrong number of arguments
+                    goto callNative;
                 }
-                pushStackFrame(runtime, frame);
-            } else {
-                pushStackFrame(runtime, createStackFrameNative());
-                RetVal ret = func->call(runtime, func, args, arity);
-                popStackFrame(runtime);
-
-                if(isRetValError(ret)) {
-                    unwindStackFrame(runtime, initStackFrameSize, initStackSize);
-                    free(args);
-                    return ret;
-                }
-                pushStack(runtime, getRetVal(ret));
+                entry = addCallCache(cache, &resolved);
             }
-            free(args);
-        } else if(opcode == OP_COND_JUMP_FALSE) {
-            Thing* condition = popStack(runtime);
-            uint32_t target = readU32Module(module, index);
-            index += 4;
-
-            if(typeOfThing(condition) != TYPE_BOOL) {
-                //TODO report what type was found
-                const char* msg =" boolean needed for branches, but a boolean "
-                        "was not found";
-                RetVal error = throwMsg(runtime, newStr(msg));
-                unwindStackFrame(runtime, initStackFrameSize, initStackSize);
-                return error;
+
+            if(entry->kind == CALL_CACHE_OPERATOR &&
+                    typeOfThing(args[1]) == receiverType) {
+                ret = createRetVal(applyNumericOperator(runtime,
+                        entry->opcode, args[0], args[1]), 0);
+                goto callReturned;
+            } else if(entry->kind == CALL_CACHE_PROPERTY) {
+                Thing* value = getObjectSlots(args[0])[entry->index];
+                if(arity == 1) {
+                    ret = createRetVal(value, 0);
+                    goto callReturned;
+                } else if(typeOfThing(value) == TYPE_FUNC) {
+                    //the method replaces the symbol and the object is
+                    //dropped, so the method is called like any function
+                    //instead of through callFunction
+                    Thing** base = args - 1;
+                    base[0] = value;
+                    memmove(&base[1], &args[1], sizeof(Thing*) * (arity - 1));
+                    runtime->stackLength--;
+                    arity--;
+                    func = value;
+                    args = &base[1];
+                    goto callFunc;
+                }
             }
 
-            if(!thingAsBool(condition)) {
-                index = target;
+            //the receiver handles the symbol, skipping the symbol's call.
+            //Built-in types look up the handler directly.
+            if(pushStackFrame(runtime, createStackFrameNative(runtime))) {
+                error = throwStackOverflow(runtime);
+                goto unwind;
             }
-        } else if(opcode == OP_ABS_JUMP) {
-            index = readU32Module(module, index);
-        } else if(opcode == OP_DUP) {
-            pushStack(runtime, peekStackIndex(runtime, 0));
-        } else if(opcode == OP_ROT3) {
-            Thing* value1 = popStack(runtime);
-            Thing* value2 = popStack(runtime);
-            Thing* value3 = popStack(runtime);
-            pushStack(runtime, value2);
-            pushStack(runtime, value3);
-            pushStack(runtime, value1);
-        } else if(opcode == OP_SWAP) {
-            Thing* value1 = popStack(runtime);
-            Thing* value2 = popStack(runtime);
-            pushStack(runtime, value1);
-            pushStack(runtime, value2);
-        } else if(opcode == OP_POP) {
-            popStack(runtime);
-        } else if(opcode == OP_CHECK_NONE) {
-            Thing* value = popStack(runtime);
-            if(value != runtime->noneThing) {
-                RetVal error = throwMsg(runtime, newStr("value is not none"));
-                unwindStackFrame(runtime, initStackFrameSize, initStackSize);
-                return error;
+            ExecFunc handler = getSymbolHandler(receiverType, id);
+            if(handler != NULL) {
+                ret = handler(runtime, func, args, arity);
+            } else {
+                ret = thingBehavior(args[0])->dispatch(runtime, func, args,
+                        arity);
+            }
+            popStackFrame(runtime);
+            goto callReturned;
+        }
+
+    callNative:
+        if(pushStackFrame(runtime, createStackFrameNative(runtime))) {
+            error = throwStackOverflow(runtime);
+            goto unwind;
+        }
+        ret = thingBehavior(func)->call(runtime, func, args, arity);
+        popStackFrame(runtime);
+
+    callReturned:
+        runtime->stackLength -= arity + 1;
+        if(isRetValError(ret)) {
+            error = ret;
+            goto unwind;
+        }
+        pushStack(runtime, getRetVal(ret));
+        ip++;
+        DISPATCH();
+
+    callFunc:
+        entry = findFuncCache(cache, func, arity);
+        if(entry == NULL) {
+            if(!resolveFuncCall(func, arity, &resolved)) {
+                runtime->stackLength -= arity + 1;
+                //TODO make this error message better
+                const char* msg = "error creating stack frame for "
+                        "function call";
+                THROW(newStr(msg));
             }
+            entry = addCallCache(cache, &resolved);
+        }
+        frame = createFrameResolved(runtime, func, arity, args, entry);
+        runtime->stackLength -= arity + 1;
+        Stats::func(runtime, frame.def.module, frame.def.index);
+
+        //module level frames are kept since executeModule still needs their
+        //scope
+        if(ip->opcode == OP_TAIL_CALL && currentFrame->def.scope->func != NULL) {
+            popStackFrame(runtime);
         } else {
-            const char* msg = "internal error: unknown bytecode";
-            RetVal error = throwMsg(runtime, newStr(msg));
-            unwindStackFrame(runtime, initStackFrameSize, initStackSize);
-            return error;
+            //execution continues after the call once the function returns
+            currentFrame->def.index = ip + 1 - code;
+        }
+        if(pushStackFrame(runtime, frame)) {
+            error = throwStackOverflow(runtime);
+            goto unwind;
+        }
+        LOAD_FRAME();
+        DISPATCH();
+    }
+    CASE(OP_COND_JUMP_FALSE) {
+        Thing* condition = popStack(runtime);
+
+        if(typeOfThing(condition) != TYPE_BOOL) {
+            //TODO report what type was found
+            const char* msg =" boolean needed for branches, but a boolean "
+                    "was not found";
+            THROW(newStr(msg));
         }
 
-        if(storeIndex) {
-            currentFrame->def.index = index;
+        if(!thingAsBool(condition)) {
+            ip = &code[ip->arg.u];
+        } else {
+            ip++;
         }
+        DISPATCH();
     }
+    CASE(OP_ABS_JUMP) {
+        ip = &code[ip->arg.u];
+        DISPATCH();
+    }
+    CASE(OP_DUP) {
+        pushStack(runtime, peekStackIndex(runtime, 0));
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_ROT3) {
+        Thing* value1 = popStack(runtime);
+        Thing* value2 = popStack(runtime);
+        Thing* value3 = popStack(runtime);
+        pushStack(runtime, value2);
+        pushStack(runtime, value3);
+        pushStack(runtime, value1);
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_SWAP) {
+        Thing* value1 = popStack(runtime);
+        Thing* value2 = popStack(runtime);
+        pushStack(runtime, value1);
+        pushStack(runtime, value2);
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_POP) {
+        popStack(runtime);
+        ip++;
+        DISPATCH();
+    }
+    CASE(OP_CHECK_NONE) {
+        Thing* value = popStack(runtime);
+        if(value != runtime->noneThing) {
+            THROW(newStr("value is not none"));
+        }
+        ip++;
+        DISPATCH();
+    }
+    OPERATOR(OP_ADD, createIntThing(runtime, a + b),
+            createFloatThing(runtime, a + b))
+    OPERATOR(OP_SUB, createIntThing(runtime, a - b),
+            createFloatThing(runtime, a - b))
+    OPERATOR(OP_MUL, createIntThing(runtime, a * b),
+            createFloatThing(runtime, a * b))
+    OPERATOR(OP_DIV, createIntThing(runtime, a / b),
+            createFloatThing(runtime, a / b))
+    OPERATOR(OP_EQ, createBoolThing(runtime, a == b),
+            createBoolThing(runtime, a == b))
+    OPERATOR(OP_NOT_EQ, createBoolThing(runtime, a != b),
+            createBoolThing(runtime, a != b))
+    OPERATOR(OP_LESS_THAN, createBoolThing(runtime, a < b),
+            createBoolThing(runtime, a < b))
+    OPERATOR(OP_LESS_THAN_EQ, createBoolThing(runtime, a <= b),
+            createBoolThing(runtime, a <= b))
+    OPERATOR(OP_GREATER_THAN, createBoolThing(runtime, a > b),
+            createBoolThing(runtime, a > b))
+    OPERATOR(OP_GREATER_THAN_EQ, createBoolThing(runtime, a >= b),
+            createBoolThing(runtime, a >= b))
+    DEFAULT {
+        THROW(newStr("internal error: unknown bytecode"));
+    }
+    }
+
+unwind:
+    unwindStackFrame(runtime, initStackFrameSize, initStackSize);
+    return error;
+
+#undef CASE
+#undef DEFAULT
+#undef DISPATCH
+#undef THREAD
+#undef LOAD_FRAME
+#undef THROW
+#undef OPERATOR
+}
+
+#if USE_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
 
-    return createRetVal(popStack(runtime), 0);
+RetVal executeCode(Runtime* runtime, StackFrame frame) {
+    //the call stack limit does not stop native code from recursing through
+    //here until the C stack runs out
+    if(runtime->executeDepth == runtime->executeDepthLimit) {
+        return throwStackOverflow(runtime);
+    }
+    runtime->executeDepth++;
+    RetVal ret;
+    if(runtime->stats != NULL) {
+        ret = executeCodeWith<CountStats>(runtime, frame);
+    } else {
+        ret = executeCodeWith<NoStats>(runtime, frame);
+    }
+    runtime->executeDepth--;
+    return ret;
 }
 
 RetVal executeModule(Runtime* runtime, Module* module) {
+    uint8_t timed = timingPhases();
+    double startTime = timed ? phaseClock() : 0;
+    uint64_t allocations = runtime->allocationTotal;
+
     //modules have no global scope.
     Scope* scope = createScope(runtime, runtime->builtins);
-    uint32_t start = module->entryIndex;
-    StackFrame* frame = createStackFrameDef(module, start, scope);
+    uint32_t start = module->codeIndex[module->entryIndex];
+    StackFrame frame = createStackFrameDef(module, start, scope);
     RetVal ret = executeCode(runtime, frame);
+    if(timed) {
+        recordPhase(module->name, "execute", phaseClock() - startTime,
+                runtime->allocationTotal - allocations, PHASE_UNMEASURED,
+                NULL);
+    }
     if(isRetValError(ret)) {
+        pinThing(runtime, getRetVal(ret));
         return ret;
     } else {
         return createRetVal(createModuleThing(runtime, scope->locals), 0);
@@ -493,15 +1249,20 @@ RetVal executeModule(Runtime* runtime, Module* module) {
 RetVal callFunction(Runtime* runtime, Thing* func, uint32_t argNo, Thing** args) {
     if(typeOfThing(func) == TYPE_FUNC) {
         uint8_t error = 0;
-        StackFrame* frame = createFrameCall(runtime, func, argNo, args, &error);
+        StackFrame frame = createFrameCall(runtime, func, argNo, args, &error);
         if(error) {
-            return throwMsg(runtime, "error creating function stack frame");
+            return throwMsg(runtime, newStr("error creating function stack frame"));
         }
-        return executeCode(runtime, frame);
+        RetVal ret = executeCode(runtime, frame);
+        pinThing(runtime, getRetVal(ret));
+        return ret;
     } else {
-        pushStackFrame(runtime, createStackFrameNative());
-        RetVal ret = func->call(runtime, func, args, argNo);
+        if(pushStackFrame(runtime, createStackFrameNative(runtime))) {
+            return throwStackOverflow(runtime);
+        }
+        RetVal ret = thingBehavior(func)->call(runtime, func, args, argNo);
         popStackFrame(runtime);
+        pinThing(runtime, getRetVal(ret));
         return ret;
     }
 }
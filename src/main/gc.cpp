@@ -0,0 +1,131 @@
+#include <stdlib.h>
+
+#include "main/gc.h"
+#include "main/runtime.h"
+#include "main/execute.h"
+#include "main/thing.h"
+
+void pinThing(Runtime* runtime, Thing* thing) {
+    if(isThingImmediate(thing)) {
+        return;
+    }
+
+    uint32_t length = runtime->stackFrameLength;
+    if(length != 0 && runtime->stackFrame[length - 1].type == STACK_FRAME_DEF) {
+        return;
+    }
+
+    if(runtime->pinnedLength == runtime->pinnedCapacity) {
+        runtime->pinnedCapacity *= 2;
+        runtime->pinned = (Thing**) realloc(runtime->pinned,
+                sizeof(Thing*) * runtime->pinnedCapacity);
+    }
+    runtime->pinned[runtime->pinnedLength++] = thing;
+}
+
+void markThing(Runtime* runtime, Thing* thing) {
+    if(thing == NULL || isThingImmediate(thing) || thing->marked) {
+        return;
+    }
+    thing->marked = 1;
+
+    //the children are marked later instead of recursing, since long lists
+    //would otherwise overflow the C stack
+    if(runtime->markStackLength == runtime->markStackCapacity) {
+        runtime->markStackCapacity *= 2;
+        runtime->markStack = (Thing**) realloc(runtime->markStack,
+                sizeof(Thing*) * runtime->markStackCapacity);
+    }
+    runtime->markStack[runtime->markStackLength++] = thing;
+}
+
+void markMapValues(Runtime* runtime, Map* map) {
+    for(Entry* entry = firstEntryMap(map); entry != NULL;
+            entry = nextEntryMap(map, entry)) {
+        markThing(runtime, (Thing*) entry->value);
+    }
+}
+
+void markScope(Runtime* runtime, Scope* scope) {
+    while(scope != NULL && !scope->marked) {
+        scope->marked = 1;
+
+        if(scope->locals != NULL) {
+            markMapValues(runtime, scope->locals);
+        }
+        for(uint32_t i = 0; i < scope->slotCount; i++) {
+            markThing(runtime, scope->slots[i]);
+        }
+        markThing(runtime, scope->func);
+
+        scope = scope->parent;
+    }
+}
+
+void markRoots(Runtime* runtime) {
+    for(uint32_t i = 0; i < runtime->stackLength; i++) {
+        markThing(runtime, runtime->stack[i]);
+    }
+
+    for(uint32_t i = 0; i < runtime->stackFrameLength; i++) {
+        StackFrame* frame = &runtime->stackFrame[i];
+        if(frame->type == STACK_FRAME_DEF) {
+            markScope(runtime, frame->def.scope);
+        }
+    }
+
+    markScope(runtime, runtime->builtins);
+    markMapValues(runtime, runtime->operators);
+    markMapValues(runtime, runtime->modules);
+
+    for(uint32_t i = 0; i < runtime->pinnedLength; i++) {
+        markThing(runtime, runtime->pinned[i]);
+    }
+}
+
+void collectGarbage(Runtime* runtime) {
+    markRoots(runtime);
+    while(runtime->markStackLength != 0) {
+        Thing* thing = runtime->markStack[--runtime->markStackLength];
+        thing->markChildren(runtime);
+    }
+
+    uint32_t survivors = 0;
+
+    List** things = &runtime->allocatedThings;
+    while(*things != NULL) {
+        List* node = *things;
+        Thing* thing = (Thing*) node->head;
+        if(thing->marked) {
+            thing->marked = 0;
+            survivors++;
+            things = &node->tail;
+        } else {
+            *things = node->tail;
+            destroyThing(thing);
+            free(node);
+        }
+    }
+
+    List** scopes = &runtime->allocatedScopes;
+    while(*scopes != NULL) {
+        List* node = *scopes;
+        Scope* scope = (Scope*) node->head;
+        if(scope->marked) {
+            scope->marked = 0;
+            survivors++;
+            scopes = &node->tail;
+        } else {
+            *scopes = node->tail;
+            destroyScope(scope);
+            free(node);
+        }
+    }
+
+    runtime->allocationCount = 0;
+    if(survivors > GC_INITIAL_THRESHOLD) {
+        runtime->collectThreshold = survivors;
+    } else {
+        runtime->collectThreshold = GC_INITIAL_THRESHOLD;
+    }
+}
@@ -105,7 +105,7 @@ RetVal libTryCatch(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
 
 RetVal libTuple(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
     UNUSED(self);
-    //a copy must be made since args is freed after the function
+    //a copy must be made since args points into the stack
     Thing** copy = (Thing**) malloc(sizeof(Thing*) * arity);
 
     for(uint8_t i = 0 ; i < arity; i++) {
@@ -179,13 +179,22 @@ RetVal libObject(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
         return ret;
     }
 
-    Map* map = createMap();
+    //objects built from the same symbols in the same order share a shape.
+    //There is a slot for each pair, though repeated symbols use fewer.
+    Shape* shape = emptyShape();
+    uint32_t pairs = 0;
+    for(Thing* list = args[0]; typeOfThing(list) == TYPE_LIST;
+            list = getListTail(list)) {
+        pairs++;
+    }
+    Thing** slots = (Thing**) malloc(sizeof(Thing*) * pairs);
 
     //ListThing* elements = (ListThing*) args[0];
     Thing* elements = args[0];
     while(typeOfThing(elements) == TYPE_LIST) {
         //if(typeOfThing2(elements->head) != TYPE_TUPLE) {
         if(typeOfThing(getListHead(elements)) != TYPE_TUPLE) {
+            free(slots);
             const char* msg = "internal error: expected pair to be a tuple";
             return throwMsg(runtime, newStr(msg));
         }
@@ -193,24 +202,31 @@ RetVal libObject(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
         //Thing* pair = elements->head;
         Thing* pair = getListHead(elements);
         if(getTupleSize(pair) != 2) {
+            free(slots);
             const char* msg = "internal error: expected pair to have two elements";
             return throwMsg(runtime, newStr(msg));
         }
 
         Thing* key = getTupleElem(pair, 0);
         if(typeOfThing(key) != TYPE_SYMBOL) {
+            free(slots);
             const char* msg = "key is not a symbol";
             return throwMsg(runtime, newStr(msg));
         }
 
         Thing* value = getTupleElem(pair, 1);
-        putMapUint32(map, getSymbolId(key), value);
+        uint32_t slot;
+        if(!findShapeSlot(shape, getSymbolId(key), &slot)) {
+            slot = shape->slotCount;
+            shape = addShapeSymbol(shape, getSymbolId(key));
+        }
+        slots[slot] = value;
 
         //elements = (ListThing*) elements->tail;
         elements = getListTail(elements);
     }
 
-    return createRetVal(createObjectThing(runtime, map), 0);
+    return createRetVal(createObjectThing(runtime, shape, slots), 0);
 }
 
 RetVal libUnpackCons(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
@@ -301,19 +317,21 @@ RetVal libImport(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
     const char* path = getModulePath(runtime, filename);
     if(path != NULL) {
         char* src = readFile(path);
-        free((char*) path);
         char* errorMsg = NULL;
-        Module* module = sourceToModule(path, src, &errorMsg);
+        Module* module = loadModule(path, src, &errorMsg);
         free(src);
         if(errorMsg != NULL) {
+            free((char*) path);
             return throwMsg(runtime, errorMsg);
         }
+        //the module keeps the path as its name, which error messages and the
+        //profiler refer to until the module is destroyed
         runtime->moduleBytecode = consList(module, runtime->moduleBytecode);
         ret = executeModule(runtime, module);
         if(isRetValError(ret)) {
             return ret;
         }
-        putMapStr(runtime->modules, filename, getRetVal(ret));
+        putMapStr(runtime->modules, newStr(filename), getRetVal(ret));
         return ret;
     }
 
@@ -323,7 +341,7 @@ RetVal libImport(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
         return throwMsg(runtime, formatStr(format, filename));
     }
 
-    putMapStr(runtime->modules, filename, moduleThing);
+    putMapStr(runtime->modules, newStr(filename), moduleThing);
     return createRetVal(moduleThing, 0);
 }
 
@@ -4,6 +4,10 @@
 
 #include "main/flags.h"
 #include "main/top.h"
+#include "main/profile.h"
+#include "main/stats.h"
+#include "main/allocs.h"
+#include "main/phases.h"
 
 #if INCLUDE_TESTS
 #include "test/tests.h"
@@ -16,20 +20,92 @@ int main(int argc, const char* args[]) {
     }
 #endif
 
-    if(argc == 2) {
+    if(argc == 3 && strcmp(args[1], "--transform-stats") == 0) {
+        char* src = readFile(args[2]);
+        uint8_t parsed = printTransformStats(src);
+        free(src);
+        return parsed ? 0 : 1;
+    }
+
+    //options come before the file to run
+    FILE* profileFile = NULL;
+    uint8_t stats = 0;
+    uint8_t allocStats = 0;
+    uint8_t timePhases = 0;
+    int fileArg = 1;
+    for(; fileArg < argc - 1 && strncmp(args[fileArg], "--", 2) == 0;
+            fileArg++) {
+        if(strncmp(args[fileArg], "--profile=", 10) == 0) {
+            const char* path = args[fileArg] + 10;
+            profileFile = fopen(path, "w");
+            if(profileFile == NULL) {
+                printf("error: could not open '%s'\n", path);
+                return 1;
+            }
+        } else if(strcmp(args[fileArg], "--stats") == 0) {
+            stats = 1;
+        } else if(strcmp(args[fileArg], "--alloc-stats") == 0) {
+            allocStats = 1;
+        } else if(strcmp(args[fileArg], "--time-phases") == 0) {
+            timePhases = 1;
+        } else {
+            printf("error: unknown option '%s'\n", args[fileArg]);
+            return 1;
+        }
+    }
+
+    if(fileArg == argc - 1) {
         initThing();
         ExecFuncIn in;
         in.runtime = createRuntime(argc, args);
-        in.src = readFile(args[1]);
+        in.src = readFile(args[fileArg]);
         in.name = "main";
         in.arity = 1;
         in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
         in.args[0] = in.runtime->noneThing;
-        in.filename = args[1];
+        in.filename = args[fileArg];
+        if(stats) {
+            in.runtime->stats = createExecStats();
+        }
+        if(allocStats) {
+            in.runtime->allocStats = createAllocStats();
+        }
+        if(timePhases) {
+            startPhaseTimes();
+        }
+        if(profileFile != NULL && !startProfile(in.runtime)) {
+            printf("error: could not start the profiler\n");
+        }
         ExecFuncOut out = execFunc(in);
+        if(profileFile != NULL) {
+            //the profile refers to the modules, so it is written before
+            //they are destroyed
+            stopProfile();
+            uint32_t dropped = writeProfile(profileFile);
+            fclose(profileFile);
+            if(dropped != 0) {
+                printf("warning: %u samples were dropped from the profile\n",
+                        dropped);
+            }
+        }
         if(out.errorMsg != NULL) {
             printf("error: %s", out.errorMsg);
         }
+        if(stats) {
+            //the report goes to stderr so that it is kept apart from the
+            //program's output
+            printExecStats(in.runtime->stats, stderr);
+            destroyExecStats(in.runtime->stats);
+            in.runtime->stats = NULL;
+        }
+        if(timePhases) {
+            printPhaseTimes(stderr);
+        }
+        if(allocStats) {
+            printAllocStats(in.runtime, stderr);
+            destroyAllocStats(in.runtime->allocStats);
+            in.runtime->allocStats = NULL;
+        }
         free((char*) in.src);
         cleanupExecFunc(in, out);
     }
@@ -12,12 +12,34 @@
 
 BlockToken* parseBlock(ParseState*, const char**);
 
+//character classes. A character may be in several classes.
+#define CHAR_WHITESPACE 1
+#define CHAR_IDENTIFIER 2
+#define CHAR_DIGIT 4
+#define CHAR_SIGN 8
+
+/**
+ * The classes of each character. Only ' ', '\t', '\n' and '\r' are whitespace,
+ * [a-zA-Z_] are identifier characters, [0-9] are digits and '+' and '-' are
+ * signs.
+ */
+const uint8_t CHAR_CLASSES[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 0, 8, 0, 0,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0,
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 2,
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0
+    //the rest are zero
+};
+
 /**
- * Returns whether or not a string contains the given character.
- * Returns false if the character is null.
+ * Returns whether the character is in any of the given character classes.
  */
-uint8_t containsChar(const char* chars, char c) {
-    return c != 0 && strchr(chars, c);
+uint8_t isCharClass(char c, uint8_t charClass) {
+    return (CHAR_CLASSES[(uint8_t) c] & charClass) != 0;
 }
 
 ParseState* createParseState(const char* src) {
@@ -66,22 +88,20 @@ void advance(ParseState* state, uint32_t amount) {
 }*/
 
 /**
- * Advances the current character as long as the current character is a given
- * character.
+ * Advances the current character as long as the current character is in one
+ * of the given character classes.
  */
-void advanceWhile(ParseState* state, const char* chars) {
-    while(containsChar(chars, getChar(state)) != 0) {
+void advanceWhile(ParseState* state, uint8_t charClass) {
+    while(isCharClass(getChar(state), charClass)) {
         advance(state, 1);
     }
 }
 
-const char* WHITESPACE_CHARS = " \t\n\r";
-
 /**
  * Advances the current character until after the whitespace.
  */
 void skipWhitespace(ParseState* state) {
-    advanceWhile(state, WHITESPACE_CHARS);
+    advanceWhile(state, CHAR_WHITESPACE);
 
     while(getChar(state) == '#') {
         while(getChar(state) != '\n' && getChar(state) != '\r' &&
@@ -89,14 +109,55 @@ void skipWhitespace(ParseState* state) {
             advance(state, 1);
         }
 
-        advanceWhile(state, WHITESPACE_CHARS);
+        advanceWhile(state, CHAR_WHITESPACE);
+    }
+}
+
+/**
+ * Returns the length of the identifier at the current character, or zero if
+ * there is none.
+ */
+uint32_t identifierLength(ParseState* state) {
+    const char* start = state->src + state->index;
+    const char* end = start;
+    while(isCharClass(*end, CHAR_IDENTIFIER)) {
+        end++;
     }
+    return end - start;
 }
 
-const char* KEYWORDS[] = { "def", "if", "then", "do", "elif", "else", "while",
-        "end", "and", "or", "not", "return", "~" };
+#define KEYWORD_SLOTS 32
+
+/**
+ * The keywords, placed at the index given by keywordHash. The hash is perfect
+ * for these keywords, so one comparison decides whether an identifier is a
+ * keyword.
+ */
+const char* KEYWORD_TABLE[KEYWORD_SLOTS] = {
+    "else", "if", NULL, "elif", NULL, NULL, NULL, NULL,
+    NULL, NULL, "then", "or", NULL, NULL, "return", NULL,
+    NULL, NULL, NULL, "not", NULL, "while", "and", "do",
+    NULL, NULL, "end", NULL, NULL, NULL, NULL, "def"
+};
+
+uint32_t keywordHash(const char* str, uint32_t length) {
+    return (3 * length + (uint8_t) str[0] + 3 * (uint8_t) str[length - 1]) %
+            KEYWORD_SLOTS;
+}
 
-const char* IDENTIFIER_CHARS = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+/**
+ * Returns whether the identifier at the current character is a keyword.
+ */
+uint8_t keywordAhead(ParseState* state) {
+    uint32_t length = identifierLength(state);
+    if(length == 0) {
+        return 0;
+    }
+    const char* str = state->src + state->index;
+    const char* keyword = KEYWORD_TABLE[keywordHash(str, length)];
+    return keyword != NULL && strncmp(keyword, str, length) == 0 &&
+            keyword[length] == 0;
+}
 
 /**
  * Returns whether or not the next characters matches the given string. If the
@@ -107,7 +168,7 @@ const char* IDENTIFIER_CHARS = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUV
  */
 uint32_t lookAhead(ParseState* state, const char* str) {
     uint32_t i = 0;
-    if(strcmp(str, "0") == 0) {
+    if(str[0] == '0' && str[1] == 0) {
         return getChar(state) == 0;
     }
     uint32_t ret;
@@ -130,9 +191,9 @@ uint32_t lookAhead(ParseState* state, const char* str) {
         return 0;
     }
 
-    if(containsChar(IDENTIFIER_CHARS, str[0])) {
+    if(isCharClass(str[0], CHAR_IDENTIFIER)) {
         char c = state->src[state->index + i];
-        return !containsChar(IDENTIFIER_CHARS, c);
+        return !isCharClass(c, CHAR_IDENTIFIER);
     } else {
         return 1;
     }
@@ -144,7 +205,7 @@ uint32_t lookAhead(ParseState* state, const char* str) {
  * has been reached.
  */
 uint8_t lookAheadMulti(ParseState* state, const char* strs[]) {
-    for(uint8_t i = 0; strcmp(strs[i], "~") != 0; i++) {
+    for(uint8_t i = 0; strs[i][0] != '~'; i++) {
         if(lookAhead(state, strs[i])) {
             return 1;
         }
@@ -168,8 +229,6 @@ uint8_t lookAheadMulti(ParseState* state, const char* strs[]) {
  * The parsing functions return NULL on errors.
  */
 
-const char* INT_CHARS = "0123456789";
-
 Token* parseIntOrFloat(ParseState* state) {
     uint32_t start = state->index;
     SrcLoc location = state->location;
@@ -179,12 +238,12 @@ Token* parseIntOrFloat(ParseState* state) {
         advance(state, 1);
     }
 
-    advanceWhile(state, INT_CHARS);
+    advanceWhile(state, CHAR_DIGIT);
 
     if(getChar(state) == '.') {
         isFloat = 1;
         advance(state, 1);
-        advanceWhile(state, INT_CHARS);
+        advanceWhile(state, CHAR_DIGIT);
     }
 
     if(getChar(state) == 'e' || getChar(state) == 'E') {
@@ -195,20 +254,17 @@ Token* parseIntOrFloat(ParseState* state) {
             advance(state, 1);
         }
 
-        advanceWhile(state, INT_CHARS);
+        advanceWhile(state, CHAR_DIGIT);
     }
 
-    char* extracted = sliceStr(state->src, start, state->index);
-    Token* token;
+    //the number is converted in place. strtof and strtol stop at the same
+    //character the loops above do, since the source is a valid number up to it.
+    const char* number = state->src + start;
     if(isFloat) {
-        float value = strtof(extracted, NULL);
-        token = (Token*) createFloatToken(location, value);
+        return (Token*) createFloatToken(location, strtof(number, NULL));
     } else {
-        int value = atoi(extracted);
-        token = (Token*) createIntToken(location, value);
+        return (Token*) createIntToken(location, (int) strtol(number, NULL, 10));
     }
-    free(extracted);
-    return token;
 }
 
 /**
@@ -232,7 +288,7 @@ LiteralToken* parseLiteral(ParseState* state) {
         return NULL;
     }
 
-    const char* value = sliceStr(state->src, start, state->index);
+    const char* value = sliceTokenStr(state->src, start, state->index);
     advance(state, 1); //skip the '
 
     return createLiteralToken(location, value);
@@ -246,13 +302,13 @@ LiteralToken* parseLiteral(ParseState* state) {
 IdentifierToken* parseIdentifier(ParseState* state) {
     uint32_t start = state->index;
     SrcLoc location = state->location;
-    advanceWhile(state, IDENTIFIER_CHARS);
+    advanceWhile(state, CHAR_IDENTIFIER);
 
-    if(lookAheadMulti(state, KEYWORDS)) {
+    if(keywordAhead(state)) {
         state->error = "expected an identifier, but found a keyword";
         return NULL;
     }
-    const char* str = sliceStr(state->src, start, state->index);
+    const char* str = sliceTokenStr(state->src, start, state->index);
     return createIdentifierToken(location, str);
 }
 
@@ -270,20 +326,20 @@ List* parseTupleHelper(ParseState* state, uint8_t* error) {
     skipWhitespace(state);
     if(getChar(state) == ')') {
         advance(state, 1);
-        return consList(head, NULL);
+        return consTokenList(head, NULL);
     } else if(getChar(state) == ',') {
         advance(state, 1);
         skipWhitespace(state);
 
         if(getChar(state) == ')') {
-            return consList(head, NULL);
+            return consTokenList(head, NULL);
         } else {
             List* tail = parseTupleHelper(state, error);
             if(*error) {
                 destroyToken(head);
                 return NULL;
             }
-            return consList(head, tail);
+            return consTokenList(head, tail);
         }
     } else {
         destroyToken(head);
@@ -302,7 +358,7 @@ Token* parseTuple(ParseState* state, SrcLoc location, Token* first) {
         return NULL;
     }
 
-    return (Token*) createTupleToken(location, consList(first, elements));
+    return (Token*) createTupleToken(location, consTokenList(first, elements));
 }
 
 List* parseListHelper(ParseState* state, uint8_t* error) {
@@ -329,7 +385,7 @@ List* parseListHelper(ParseState* state, uint8_t* error) {
         state->error = "expected ',' or ']'";
         return NULL;
     }
-    return consList(head, tail);
+    return consTokenList(head, tail);
 }
 
 Token* parseList(ParseState* state) {
@@ -363,7 +419,7 @@ List* parseObjectHelper(ParseState* state, uint8_t* error) {
     if(getChar(state) != ':') {
         state->error = "expected ':'";
         *error = 1;
-        free(key);
+        destroyToken(key);
         return NULL;
     }
     advance(state, 1); //skip the ':'
@@ -372,7 +428,7 @@ List* parseObjectHelper(ParseState* state, uint8_t* error) {
 
     if(value == NULL) {
         *error = 1;
-        free(key);
+        destroyToken(key);
         return NULL;
     }
 
@@ -393,7 +449,7 @@ List* parseObjectHelper(ParseState* state, uint8_t* error) {
         return NULL;
     }
     ObjectPair* head = createObjectPair(key, value);
-    return consList(head, tail);
+    return consTokenList(head, tail);
 }
 
 Token* parseObject(ParseState* state) {
@@ -431,7 +487,7 @@ List* parseArgs(ParseState* state, uint8_t* error) {
     }
 
     skipWhitespace(state);
-    if(!containsChar(IDENTIFIER_CHARS, getChar(state))) {
+    if(!isCharClass(getChar(state), CHAR_IDENTIFIER)) {
         state->error = "expected an identifier";
         *error = 1;
         return NULL;
@@ -450,7 +506,7 @@ List* parseArgs(ParseState* state, uint8_t* error) {
         destroyToken((Token*) head);
         return NULL;
     }
-    return consList(head, tail);
+    return consTokenList(head, tail);
 }
 
 const char* FUNC_ENDS[] = { "end", "~" };
@@ -488,7 +544,7 @@ FuncToken* parseFunc(ParseState* state) {
     if(body == NULL) {
         //TODO fix memleak?
         destroyToken((Token*) name);
-        destroyList(args, destroyTokenVoid);
+        destroyTokenList(args, destroyTokenVoid);
         return NULL;
     }
     advance(state, strlen("end"));
@@ -524,9 +580,9 @@ Token* parseFactor(ParseState* state) {
             state->error = "expectd ')' or ','";
             return NULL;
         }
-    } else if(containsChar(INT_CHARS, c) != 0 || containsChar("+-", c) != 0) {
+    } else if(isCharClass(c, CHAR_DIGIT | CHAR_SIGN)) {
         return (Token*) parseIntOrFloat(state);
-    } else if(containsChar(IDENTIFIER_CHARS, c) != 0) {
+    } else if(isCharClass(c, CHAR_IDENTIFIER)) {
         return (Token*) parseIdentifier(state);
     } else if(c == '\'') {
         return (Token*) parseLiteral(state);
@@ -543,6 +599,7 @@ Token* parseDotAccessHelper(ParseState* state, Token* left) {
     skipWhitespace(state);
     SrcLoc location = state->location;
     if(getChar(state) == '.') {
+        uint32_t start = state->index;
         advance(state, 1);
         //TODO put in a transformation?
         IdentifierToken* id = parseIdentifier(state);
@@ -554,7 +611,8 @@ Token* parseDotAccessHelper(ParseState* state, Token* left) {
         destroyToken((Token*) id);
 
         Token* access = (Token*)
-                createBinaryOpToken(location, newStr("."), left, right);
+                createBinaryOpToken(location,
+                        sliceTokenStr(state->src, start, start + 1), left, right);
         return parseDotAccessHelper(state, access);
     } else {
         return left;
@@ -569,27 +627,38 @@ Token* parseDotAccess(ParseState* state) {
     return parseDotAccessHelper(state, left);
 }
 
-//'end' is not an operator; it signifies that the end of the array of operators
 #define OP_LEVELS 7
 #define OP_AMOUNT 8
-const char* OP_DATA[OP_LEVELS][OP_AMOUNT] = {
-        { ".", "end" },
-        { "*", "/", "end" },
-        { "+", "-", "end" },
-        { "==", "!=", ">=", "<=", "<", ">", "end" },
-        //the 'prefix' isn't an operator; it signifies that this level contains
-        //prefix unary operators.
-        { "prefix", "not", "end" },
-        { "and", "or", "end" },
-        { "right-to-left", "::", "end" }
+
+typedef enum {
+    OPS_BINARY,
+    //prefix unary operators
+    OPS_PREFIX,
+    //binary operators that group from right to left
+    OPS_RIGHT_TO_LEFT
+} OpLevelKind;
+
+typedef struct {
+    OpLevelKind kind;
+    //the operators, followed by NULL
+    const char* ops[OP_AMOUNT];
+} OpLevel;
+
+const OpLevel OP_DATA[OP_LEVELS] = {
+        { OPS_BINARY, { ".", NULL } },
+        { OPS_BINARY, { "*", "/", NULL } },
+        { OPS_BINARY, { "+", "-", NULL } },
+        { OPS_BINARY, { "==", "!=", ">=", "<=", "<", ">", NULL } },
+        { OPS_PREFIX, { "not", NULL } },
+        { OPS_BINARY, { "and", "or", NULL } },
+        { OPS_RIGHT_TO_LEFT, { "::", NULL } }
 };
 
 uint8_t factorAhead(ParseState* state) {
     char c = getChar(state);
-    return c == '(' || c == '\'' || containsChar(INT_CHARS, c) != 0 ||
+    return c == '(' || c == '\'' || isCharClass(c, CHAR_DIGIT) ||
             c == '[' || c== '{' ||
-            (containsChar(IDENTIFIER_CHARS, c) != 0 &&
-                    !lookAheadMulti(state, KEYWORDS));
+            (isCharClass(c, CHAR_IDENTIFIER) && !keywordAhead(state));
 }
 
 Token* parseCall(ParseState* state) {
@@ -608,43 +677,38 @@ Token* parseCall(ParseState* state) {
     }
 
     //its a function call
-    List* children = consList(first, NULL);
+    List* children = consTokenList(first, NULL);
+    List* last = children;
     while(factorAhead(state)) {
-        children = consList(parseDotAccess(state), children);
+        last->tail = consTokenList(parseDotAccess(state), NULL);
+        last = last->tail;
         skipWhitespace(state);
     }
 
-    List* reversed = reverseList(children);
-    destroyShallowList(children);
-    return (Token*) createCallToken(location, reversed);
+    return (Token*) createCallToken(location, children);
 }
 
 /**
- * Returns the operator for the given level.
+ * Returns the operator of the given level at the current character, or NULL if
+ * there is none. The returned string is from OP_DATA and must not be freed.
  */
 const char* getOp(ParseState* state, uint8_t level) {
-    for(uint8_t i = 0; i < OP_AMOUNT; i++) {
-        const char* checking = OP_DATA[level - 1][i];
-        //end the array of operators, exit the function
-        if(strcmp(checking, "end") == 0) {
-            break;
-        }
-        //information for other functions, skip it
-        if(strcmp(checking, "prefix") == 0) {
-            continue;
-        }
-
-        if(strcmp(checking, "right-to-left") == 0) {
-            continue;
-        }
-
-        if(lookAhead(state, checking)) {
-            return newStr(checking);
+    char c = getChar(state);
+    for(const char* const* op = OP_DATA[level - 1].ops; *op != NULL; op++) {
+        if((*op)[0] == c && lookAhead(state, *op)) {
+            return *op;
         }
     }
     return NULL;
 }
 
+/**
+ * Copies an operator returned by getOp for a token.
+ */
+char* opTokenStr(const char* op) {
+    return sliceTokenStr(op, 0, strlen(op));
+}
+
 /**
  * The following functions parse expressions.
  *
@@ -691,11 +755,11 @@ Token* parseBinaryOp(ParseState* state, uint8_t level) {
         advance(state, strlen(op));
         Token* right = parseExpressionWithLevel(state, level - 1);
         if(right == NULL) {
-            free((void*) op);
             destroyToken(token);
             return NULL;
         }
-        token = (Token*) createBinaryOpToken(location, op, token, right);
+        token = (Token*) createBinaryOpToken(location, opTokenStr(op), token,
+                right);
         skipWhitespace(state);
     }
 
@@ -717,10 +781,10 @@ Token* parseBinaryOpRightToLeft(ParseState* state, uint8_t level) {
         Token* right = parseExpressionWithLevel(state, level);
         if(right == NULL) {
             destroyToken(left);
-            free((void*) op);
             return NULL;
         }
-        return (Token*) createBinaryOpToken(location, op, left, right);
+        return (Token*) createBinaryOpToken(location, opTokenStr(op), left,
+                right);
     } else {
         return left;
     }
@@ -745,10 +809,9 @@ Token* parsePrefixUnaryOp(ParseState* state, uint8_t level) {
         advance(state, strlen(op));
         Token* child = parseExpressionWithLevel(state, level);
         if(child == NULL) {
-            free((void*) op);
             return NULL;
         }
-        return (Token*) createUnaryOpToken(location, op, child);
+        return (Token*) createUnaryOpToken(location, opTokenStr(op), child);
     } else {
         return parseExpressionWithLevel(state, level - 1);
     }
@@ -757,9 +820,9 @@ Token* parsePrefixUnaryOp(ParseState* state, uint8_t level) {
 Token* parseExpressionWithLevel(ParseState* state, uint8_t level) {
     if(level == 0) {
         return parseCall(state);
-    } else if(strcmp("prefix", OP_DATA[level - 1][0]) == 0){
+    } else if(OP_DATA[level - 1].kind == OPS_PREFIX) {
         return parsePrefixUnaryOp(state, level);
-    } else if(strcmp("right-to-left", OP_DATA[level - 1][0]) == 0) {
+    } else if(OP_DATA[level - 1].kind == OPS_RIGHT_TO_LEFT) {
         return parseBinaryOpRightToLeft(state, level);
     } else {
         return parseBinaryOp(state, level);
@@ -791,10 +854,11 @@ Token* parseAssignment(ParseState* state) {
         skipWhitespace(state);
         Token* right = parseExpression(state);
         if(right == NULL) {
+            destroyToken(left);
             return NULL;
         } else if(getChar(state) != ';') {
-            //TODO fix memleak
-            free(left);
+            destroyToken(left);
+            destroyToken(right);
             state->error = "expected ';'";
             return NULL;
         }
@@ -852,7 +916,7 @@ List* parseIfStmtBranches(ParseState* state, uint8_t* error) {
             //TODO fix memleak
             return NULL;
         }
-        return consList(head, tail);
+        return consTokenList(head, tail);
     } else if(lookAhead(state, "else") || lookAhead(state, "end")) {
         //end of the branches
         //don't advance so parseIfStmt knows there is or is not an else branch
@@ -863,7 +927,7 @@ List* parseIfStmtBranches(ParseState* state, uint8_t* error) {
         state->error = "expected 'else' or 'end'";
         return NULL;
     }
-    return consList(head, tail);
+    return consTokenList(head, tail);
 }
 
 /**
@@ -903,7 +967,7 @@ IfToken* parseIfStmt(ParseState* state) {
         return NULL;
     }
     if(!lookAhead(state, "end")) {
-        destroyList(branches, destroyIfBranch);
+        destroyTokenList(branches, destroyIfBranch);
         destroyToken((Token*) elseBranch);
         state->error = "expected 'end'";
         return NULL;
@@ -1024,7 +1088,7 @@ List* parseBlockHelper(ParseState* state, const char* ends[], uint8_t* error) {
         return NULL;
     }
     //adds the statement to the beginning of the rest of the statements
-    return consList(head, tail);
+    return consTokenList(head, tail);
 }
 
 /**
@@ -1033,7 +1097,7 @@ List* parseBlockHelper(ParseState* state, const char* ends[], uint8_t* error) {
  * <block> ::= <assignment>* END1 | END 2 ...
  *
  * The algorithm must be expressed using a stack as the first statements
- * must be passed to consList last so they are the first in the list.
+ * must be passed to consTokenList last so they are the first in the list.
  *
  * This function does not consume the ending keyword.
  *
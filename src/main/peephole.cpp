@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "main/bytecode.h"
+#include "main/codegen.h"
+#include "main/peephole.h"
+
+//an instruction without a label reference, or a position without an
+//instruction
+#define NO_INDEX UINT32_MAX
+
+typedef struct {
+    //the instruction's position in the builder's bytecode
+    uint32_t start;
+    //the number of bytes the instruction occupies in the builder's bytecode
+    uint32_t size;
+    //the number of bytes the instruction will occupy once it is rewritten.
+    //This is less than size for jumps that became returns.
+    uint32_t newSize;
+    uint8_t opcode;
+    //the index in builder->labelRefs of the instruction's label reference,
+    //or NO_INDEX
+    uint32_t ref;
+    uint8_t removed;
+} PeepholeInstr;
+
+typedef struct {
+    ModuleBuilder* builder;
+    uint32_t entryLabel;
+    PeepholeInstr* instrs;
+    uint32_t length;
+    //the index in instrs of the instruction at each position of the bytecode,
+    //or NO_INDEX if no instruction starts there. The end of the bytecode maps
+    //to length.
+    uint32_t* atPosition;
+    //the index in instrs of the instruction of each label reference
+    uint32_t* refInstrs;
+    //whether a label that is still referenced, or the entry, is defined at
+    //each position of the bytecode
+    uint8_t* targets;
+} Peephole;
+
+static uint8_t isJump(uint8_t opcode) {
+    return opcode == OP_ABS_JUMP || opcode == OP_COND_JUMP_TRUE ||
+            opcode == OP_COND_JUMP_FALSE;
+}
+
+/**
+ * Returns the index of the first instruction at or after the given index that
+ * has not been removed, or length if there is none.
+ */
+static uint32_t nextLive(Peephole* peephole, uint32_t index) {
+    while(index < peephole->length && peephole->instrs[index].removed) {
+        index++;
+    }
+    return index;
+}
+
+/**
+ * Returns the index of the instruction that execution continues at when it
+ * jumps to the label.
+ */
+static uint32_t labelInstr(Peephole* peephole, uint32_t label) {
+    uint32_t position = peephole->builder->labelDefs[label];
+    return nextLive(peephole, peephole->atPosition[position]);
+}
+
+static uint32_t* refLabel(Peephole* peephole, PeepholeInstr* instr) {
+    return &peephole->builder->labelRefs[instr->ref].label;
+}
+
+static void findInstrs(Peephole* peephole) {
+    ModuleBuilder* builder = peephole->builder;
+    uint32_t bytecodeLength = builder->bytecodeLength;
+    peephole->atPosition = (uint32_t*) malloc(sizeof(uint32_t) *
+            (bytecodeLength + 1));
+    peephole->instrs = (PeepholeInstr*) malloc(sizeof(PeepholeInstr) *
+            bytecodeLength);
+    peephole->length = 0;
+
+    for(uint32_t i = 0; i < bytecodeLength;) {
+        uint32_t size = instructionSize(builder->bytecode, i);
+        PeepholeInstr* instr = &peephole->instrs[peephole->length];
+        instr->start = i;
+        instr->size = size;
+        instr->newSize = size;
+        instr->opcode = builder->bytecode[i];
+        instr->ref = NO_INDEX;
+        instr->removed = 0;
+        for(uint32_t j = i; j < i + size; j++) {
+            peephole->atPosition[j] = j == i ? peephole->length : NO_INDEX;
+        }
+        peephole->length++;
+        i += size;
+    }
+    peephole->atPosition[bytecodeLength] = peephole->length;
+
+    //the label of an instruction is its first operand
+    peephole->refInstrs = (uint32_t*) malloc(sizeof(uint32_t) *
+            builder->labelRefsLength);
+    for(uint32_t i = 0; i < builder->labelRefsLength; i++) {
+        uint32_t index = peephole->atPosition[builder->labelRefs[i].position - 1];
+        peephole->instrs[index].ref = i;
+        peephole->refInstrs[i] = index;
+    }
+
+    peephole->targets = (uint8_t*) malloc(bytecodeLength + 1);
+}
+
+static void findTargets(Peephole* peephole) {
+    ModuleBuilder* builder = peephole->builder;
+    memset(peephole->targets, 0, builder->bytecodeLength + 1);
+    peephole->targets[builder->labelDefs[peephole->entryLabel]] = 1;
+    for(uint32_t i = 0; i < builder->labelRefsLength; i++) {
+        PeepholeInstr* instr = &peephole->instrs[peephole->refInstrs[i]];
+        if(!instr->removed && instr->ref == i) {
+            peephole->targets[builder->labelDefs[builder->labelRefs[i].label]] = 1;
+        }
+    }
+}
+
+/**
+ * Retargets jumps to unconditional jumps and turns unconditional jumps to a
+ * return into a return.
+ */
+static void threadJumps(Peephole* peephole) {
+    for(uint32_t i = 0; i < peephole->length; i++) {
+        PeepholeInstr* instr = &peephole->instrs[i];
+        if(instr->removed || !isJump(instr->opcode)) {
+            continue;
+        }
+
+        //a chain can be at most as long as the code, unless it loops
+        uint32_t* label = refLabel(peephole, instr);
+        for(uint32_t steps = 0; steps < peephole->length; steps++) {
+            uint32_t target = labelInstr(peephole, *label);
+            if(target == peephole->length ||
+                    peephole->instrs[target].opcode != OP_ABS_JUMP) {
+                break;
+            }
+            uint32_t next = *refLabel(peephole, &peephole->instrs[target]);
+            if(next == *label) {
+                break;
+            }
+            *label = next;
+        }
+
+        uint32_t target = labelInstr(peephole, *label);
+        if(instr->opcode == OP_ABS_JUMP && target != peephole->length &&
+                peephole->instrs[target].opcode == OP_RETURN) {
+            instr->opcode = OP_RETURN;
+            instr->newSize = 1;
+            instr->ref = NO_INDEX;
+        }
+    }
+}
+
+/**
+ * Removes the instructions after returns and unconditional jumps that nothing
+ * jumps to.
+ *
+ * @return whether anything was removed
+ */
+static uint8_t removeDeadCode(Peephole* peephole) {
+    uint8_t changed = 0;
+    uint8_t dead = 0;
+    for(uint32_t i = 0; i < peephole->length; i++) {
+        PeepholeInstr* instr = &peephole->instrs[i];
+        //a label on a removed instruction belongs to the next one
+        if(peephole->targets[instr->start]) {
+            dead = 0;
+        }
+        if(instr->removed) {
+            continue;
+        }
+        if(dead) {
+            instr->removed = 1;
+            changed = 1;
+        } else if(instr->opcode == OP_RETURN || instr->opcode == OP_ABS_JUMP) {
+            dead = 1;
+        }
+    }
+    return changed;
+}
+
+/**
+ * Removes unconditional jumps to the instruction after them.
+ *
+ * @return whether anything was removed
+ */
+static uint8_t removeJumpsToNext(Peephole* peephole) {
+    uint8_t changed = 0;
+    for(uint32_t i = 0; i < peephole->length; i++) {
+        PeepholeInstr* instr = &peephole->instrs[i];
+        if(!instr->removed && instr->opcode == OP_ABS_JUMP &&
+                labelInstr(peephole, *refLabel(peephole, instr)) ==
+                nextLive(peephole, i + 1)) {
+            instr->removed = 1;
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+/**
+ * Removes DUP followed by POP and SWAP followed by SWAP, unless something
+ * jumps between them.
+ *
+ * @return whether anything was removed
+ */
+static uint8_t cancelPairs(Peephole* peephole) {
+    uint8_t changed = 0;
+    for(uint32_t i = 0; i < peephole->length; i++) {
+        PeepholeInstr* first = &peephole->instrs[i];
+        if(first->removed) {
+            continue;
+        }
+        uint32_t j = nextLive(peephole, i + 1);
+        if(j == peephole->length) {
+            break;
+        }
+        PeepholeInstr* second = &peephole->instrs[j];
+        if(!(first->opcode == OP_DUP && second->opcode == OP_POP) &&
+                !(first->opcode == OP_SWAP && second->opcode == OP_SWAP)) {
+            continue;
+        }
+
+        uint8_t jumpedInto = 0;
+        for(uint32_t k = i + 1; k <= j; k++) {
+            jumpedInto |= peephole->targets[peephole->instrs[k].start];
+        }
+        if(!jumpedInto) {
+            first->removed = 1;
+            second->removed = 1;
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+/**
+ * Turns calls that are directly followed by a return into tail calls. Code
+ * that was removed may have separated them.
+ */
+static void makeTailCalls(Peephole* peephole) {
+    for(uint32_t i = 0; i < peephole->length; i++) {
+        PeepholeInstr* instr = &peephole->instrs[i];
+        if(instr->removed || instr->opcode != OP_CALL) {
+            continue;
+        }
+        uint32_t next = nextLive(peephole, i + 1);
+        if(next != peephole->length &&
+                peephole->instrs[next].opcode == OP_RETURN) {
+            instr->opcode = OP_TAIL_CALL;
+        }
+    }
+}
+
+/**
+ * Writes the instructions that were kept to a new bytecode array and moves
+ * the labels and srcLoc entries to their new positions.
+ */
+static void rewrite(Peephole* peephole) {
+    ModuleBuilder* builder = peephole->builder;
+    uint32_t bytecodeLength = builder->bytecodeLength;
+    uint8_t* bytecode = (uint8_t*) malloc(bytecodeLength);
+
+    //the position of each old position in the new bytecode. Removed
+    //instructions are replaced by the instruction after them.
+    uint32_t* positions = (uint32_t*) malloc(sizeof(uint32_t) *
+            (bytecodeLength + 1));
+    uint32_t length = 0;
+    for(uint32_t i = 0; i < peephole->length; i++) {
+        PeepholeInstr* instr = &peephole->instrs[i];
+        for(uint32_t j = 0; j < instr->size; j++) {
+            positions[instr->start + j] = length +
+                    (!instr->removed && j < instr->newSize ? j : 0);
+        }
+        if(!instr->removed) {
+            bytecode[length] = instr->opcode;
+            memcpy(&bytecode[length + 1], &builder->bytecode[instr->start + 1],
+                    instr->newSize - 1);
+            length += instr->newSize;
+        }
+    }
+    positions[bytecodeLength] = length;
+
+    for(uint32_t i = 0; i < builder->nextLabel; i++) {
+        builder->labelDefs[i] = positions[builder->labelDefs[i]];
+    }
+
+    uint32_t refsLength = 0;
+    for(uint32_t i = 0; i < builder->labelRefsLength; i++) {
+        PeepholeInstr* instr = &peephole->instrs[peephole->refInstrs[i]];
+        if(!instr->removed && instr->ref == i) {
+            LabelRef* ref = &builder->labelRefs[refsLength++];
+            ref->label = builder->labelRefs[i].label;
+            ref->position = positions[builder->labelRefs[i].position];
+        }
+    }
+    builder->labelRefsLength = refsLength;
+
+    //several entries can end up at the same instruction, in which case the
+    //last one applies to it
+    uint32_t srcLocLength = 0;
+    for(uint32_t i = 0; i < builder->srcLocLength; i++) {
+        BytecodeSrcLoc srcLoc = builder->srcLoc[i];
+        srcLoc.index = positions[srcLoc.index];
+        if(srcLocLength != 0 &&
+                builder->srcLoc[srcLocLength - 1].index == srcLoc.index) {
+            srcLocLength--;
+        }
+        builder->srcLoc[srcLocLength++] = srcLoc;
+    }
+    builder->srcLocLength = srcLocLength;
+
+    free(positions);
+    free(builder->bytecode);
+    builder->bytecode = bytecode;
+    builder->bytecodeLength = length;
+    builder->bytecodeCapacity = bytecodeLength;
+    //the calls have moved
+    builder->callEnd = 0;
+}
+
+void optimizeBuilder(ModuleBuilder* builder, uint32_t entryLabel) {
+    if(builder->bytecodeLength == 0) {
+        return;
+    }
+
+    Peephole peephole;
+    peephole.builder = builder;
+    peephole.entryLabel = entryLabel;
+    findInstrs(&peephole);
+
+    //removing code can make labels unused, which lets more code be removed
+    uint8_t changed;
+    do {
+        threadJumps(&peephole);
+        findTargets(&peephole);
+        changed = removeDeadCode(&peephole);
+        changed |= removeJumpsToNext(&peephole);
+        changed |= cancelPairs(&peephole);
+    } while(changed);
+    makeTailCalls(&peephole);
+
+    rewrite(&peephole);
+    free(peephole.instrs);
+    free(peephole.atPosition);
+    free(peephole.refInstrs);
+    free(peephole.targets);
+}
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "main/util.h"
+#include "main/phases.h"
+
+typedef struct {
+    char* module;
+    char* phase;
+    double seconds;
+    int64_t allocations;
+    int64_t size;
+    const char* unit;
+} Phase;
+
+static Phase* phases = NULL;
+static uint32_t phasesLength = 0;
+static uint32_t phasesCapacity = 0;
+static uint8_t timing = 0;
+
+static void clearPhases() {
+    for(uint32_t i = 0; i < phasesLength; i++) {
+        free(phases[i].module);
+        free(phases[i].phase);
+    }
+    free(phases);
+    phases = NULL;
+    phasesLength = 0;
+    phasesCapacity = 0;
+}
+
+void startPhaseTimes() {
+    clearPhases();
+    timing = 1;
+}
+
+uint8_t timingPhases() {
+    return timing;
+}
+
+double phaseClock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void recordPhase(const char* module, const char* phase, double seconds,
+        int64_t allocations, int64_t size, const char* unit) {
+    if(!timing) {
+        return;
+    }
+    if(phasesLength == phasesCapacity) {
+        phasesCapacity = phasesCapacity == 0 ? 32 : phasesCapacity * 2;
+        phases = (Phase*) realloc(phases, sizeof(Phase) * phasesCapacity);
+    }
+    Phase* recorded = &phases[phasesLength++];
+    recorded->module = newStr(module == NULL ? "[unknown]" : module);
+    recorded->phase = newStr(phase);
+    recorded->seconds = seconds;
+    recorded->allocations = allocations;
+    recorded->size = size;
+    recorded->unit = unit;
+}
+
+static void printPhase(FILE* file, const char* module, Phase* phase) {
+    fprintf(file, "%-40s %-20s %10.3f", module, phase->phase,
+            phase->seconds * 1000);
+    if(phase->allocations == PHASE_UNMEASURED) {
+        fprintf(file, " %12s", "-");
+    } else {
+        fprintf(file, " %12lld", (long long) phase->allocations);
+    }
+    if(phase->size == PHASE_UNMEASURED) {
+        fprintf(file, " %12s\n", "-");
+    } else {
+        fprintf(file, " %12lld %s\n", (long long) phase->size, phase->unit);
+    }
+}
+
+void printPhaseTimes(FILE* file) {
+    fprintf(file, "%-40s %-20s %10s %12s %12s\n", "module", "phase", "ms",
+            "allocations", "output");
+    for(uint32_t i = 0; i < phasesLength; i++) {
+        printPhase(file, phases[i].module, &phases[i]);
+    }
+
+    //the totals are kept in the order each phase first appears. Executing a
+    //module includes its imports, so the execute phase is not totaled.
+    Phase* totals = (Phase*) malloc(sizeof(Phase) * (phasesLength + 1));
+    uint32_t totalsLength = 0;
+    for(uint32_t i = 0; i < phasesLength; i++) {
+        Phase* phase = &phases[i];
+        if(strcmp(phase->phase, "execute") == 0) {
+            continue;
+        }
+        Phase* total = NULL;
+        for(uint32_t j = 0; j < totalsLength && total == NULL; j++) {
+            if(strcmp(totals[j].phase, phase->phase) == 0) {
+                total = &totals[j];
+            }
+        }
+        if(total == NULL) {
+            total = &totals[totalsLength++];
+            *total = *phase;
+            total->module = NULL;
+            continue;
+        }
+        total->seconds += phase->seconds;
+        if(total->allocations != PHASE_UNMEASURED) {
+            total->allocations += phase->allocations;
+        }
+        if(total->size != PHASE_UNMEASURED) {
+            total->size += phase->size;
+        }
+    }
+    for(uint32_t i = 0; i < totalsLength; i++) {
+        printPhase(file, "[total]", &totals[i]);
+    }
+    free(totals);
+
+    clearPhases();
+    timing = 0;
+}
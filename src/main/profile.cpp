@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include "main/util.h"
+#include "main/bytecode.h"
+#include "main/runtime.h"
+#include "main/profile.h"
+
+#define UNUSED(x) (void)(x)
+
+typedef struct {
+    //the frame's module, or NULL for native frames
+    const Module* module;
+    //the index of the frame's current instruction in module->code
+    uint32_t index;
+} ProfileFrame;
+
+typedef struct {
+    uint32_t hash;
+    //the stack's frames are frames[start] up to frames[start + depth - 1],
+    //from the outermost to the innermost
+    uint32_t start;
+    uint32_t depth;
+    //the number of samples of the stack, or zero if the entry is unused
+    uint32_t count;
+} ProfileStack;
+
+//the distinct stacks, an open addressing hash table with linear probing
+static ProfileStack* stacks = NULL;
+static uint32_t stacksLength = 0;
+static ProfileFrame* frames = NULL;
+static uint32_t framesLength = 0;
+static uint32_t droppedSamples = 0;
+static Runtime* profiledRuntime = NULL;
+//set while the timer is running, so that a late signal does nothing
+static volatile sig_atomic_t sampling = 0;
+static struct sigaction oldAction;
+
+static inline ProfileFrame readFrame(StackFrame* stackFrame) {
+    ProfileFrame frame;
+    if(stackFrame->type == STACK_FRAME_DEF) {
+        frame.module = stackFrame->def.module;
+        frame.index = stackFrame->def.index;
+    } else {
+        frame.module = NULL;
+        frame.index = 0;
+    }
+    return frame;
+}
+
+/**
+ * Records the current call stack. This runs in the signal handler, so it must
+ * not allocate or call anything that is not async signal safe.
+ */
+static void takeSample(int signal) {
+    UNUSED(signal);
+    if(!sampling) {
+        return;
+    }
+
+    StackFrame* stackFrame = profiledRuntime->stackFrame;
+    uint32_t depth = profiledRuntime->stackFrameLength;
+    if(depth == 0) {
+        return;
+    }
+
+    //FNV-1a over the frames
+    uint32_t hash = 2166136261u;
+    for(uint32_t i = 0; i < depth; i++) {
+        ProfileFrame frame = readFrame(&stackFrame[i]);
+        hash = (hash ^ (uint32_t) (uintptr_t) frame.module) * 16777619u;
+        hash = (hash ^ frame.index) * 16777619u;
+    }
+
+    uint32_t mask = PROFILE_STACKS_CAPACITY - 1;
+    for(uint32_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        ProfileStack* stack = &stacks[slot];
+
+        if(stack->count == 0) {
+            //the table is kept at most three quarters full so that probing
+            //stays short
+            if(stacksLength >= PROFILE_STACKS_CAPACITY / 4 * 3 ||
+                    framesLength + depth > PROFILE_FRAMES_CAPACITY) {
+                droppedSamples++;
+                return;
+            }
+            for(uint32_t i = 0; i < depth; i++) {
+                frames[framesLength + i] = readFrame(&stackFrame[i]);
+            }
+            stack->hash = hash;
+            stack->start = framesLength;
+            stack->depth = depth;
+            stack->count = 1;
+            framesLength += depth;
+            stacksLength++;
+            return;
+        }
+
+        if(stack->hash != hash || stack->depth != depth) {
+            continue;
+        }
+
+        uint8_t same = 1;
+        for(uint32_t i = 0; i < depth && same; i++) {
+            ProfileFrame frame = readFrame(&stackFrame[i]);
+            ProfileFrame* recorded = &frames[stack->start + i];
+            same = frame.module == recorded->module &&
+                    frame.index == recorded->index;
+        }
+        if(same) {
+            stack->count++;
+            return;
+        }
+    }
+}
+
+uint8_t startProfile(Runtime* runtime) {
+    stacks = (ProfileStack*) calloc(PROFILE_STACKS_CAPACITY,
+            sizeof(ProfileStack));
+    stacksLength = 0;
+    frames = (ProfileFrame*) malloc(sizeof(ProfileFrame) *
+            PROFILE_FRAMES_CAPACITY);
+    framesLength = 0;
+    droppedSamples = 0;
+    profiledRuntime = runtime;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = takeSample;
+    sigemptyset(&action.sa_mask);
+    //the interpreter should not notice the signal
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &action, &oldAction);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = PROFILE_INTERVAL_US;
+    timer.it_value = timer.it_interval;
+    sampling = 1;
+    if(setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+        stopProfile();
+        return 0;
+    }
+    return 1;
+}
+
+void stopProfile() {
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    sampling = 0;
+
+    //ignoring the signal discards one that is still pending, which the old
+    //action might not handle
+    struct sigaction ignore;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPROF, &ignore, NULL);
+    sigaction(SIGPROF, &oldAction, NULL);
+}
+
+/**
+ * Returns the name of the frame in the profile. The returned string must be
+ * freed.
+ */
+static char* frameName(ProfileFrame* frame) {
+    const Module* module = frame->module;
+    if(module == NULL) {
+        return newStr("[native code]");
+    }
+
+    SrcLoc location = findSrcLoc(module, frame->index);
+    const char* name = module->name == NULL ? "[unknown]" : module->name;
+    return (char*) formatStr("%s:%i:%i", name, location.line,
+            location.column);
+}
+
+/**
+ * Appends the string to the line, doubling the line's capacity if it is too
+ * small. The whole line is never copied per frame, so deep stacks stay cheap.
+ */
+static void appendLine(char** line, size_t* length, size_t* capacity,
+        const char* str) {
+    size_t strLength = strlen(str);
+    if(*length + strLength + 1 > *capacity) {
+        while(*length + strLength + 1 > *capacity) {
+            *capacity *= 2;
+        }
+        *line = (char*) realloc(*line, *capacity);
+    }
+    memcpy(*line + *length, str, strLength + 1);
+    *length += strLength;
+}
+
+uint32_t writeProfile(FILE* file) {
+    //different instructions on the same line have the same name, so their
+    //stacks are merged
+    Map* counts = createMap();
+
+    for(uint32_t i = 0; i < PROFILE_STACKS_CAPACITY; i++) {
+        ProfileStack* stack = &stacks[i];
+        if(stack->count == 0) {
+            continue;
+        }
+
+        size_t length = 0;
+        size_t capacity = 64;
+        char* folded = (char*) malloc(capacity);
+        for(uint32_t j = 0; j < stack->depth; j++) {
+            char* name = frameName(&frames[stack->start + j]);
+            if(j != 0) {
+                appendLine(&folded, &length, &capacity, ";");
+            }
+            appendLine(&folded, &length, &capacity, name);
+            free(name);
+        }
+
+        uint32_t* count = (uint32_t*) getMapStr(counts, folded);
+        if(count == NULL) {
+            putMapStr(counts, folded, boxUint32(stack->count));
+        } else {
+            *count += stack->count;
+            free(folded);
+        }
+    }
+
+    for(Entry* entry = firstEntryMap(counts); entry != NULL;
+            entry = nextEntryMap(counts, entry)) {
+        fprintf(file, "%s %u\n", (const char*) entry->key,
+                *(uint32_t*) entry->value);
+    }
+    destroyMap(counts, free, free);
+
+    free(stacks);
+    stacks = NULL;
+    free(frames);
+    frames = NULL;
+    profiledRuntime = NULL;
+    return droppedSamples;
+}
@@ -20,6 +20,8 @@ RetVal throwMsg(Runtime* runtime, const char* msg) {
 
 Thing::~Thing() {}
 
+void Thing::markChildren(Runtime*) {}
+
 ThingType TYPE_NONE = 0;
 ThingType TYPE_INT = 1;
 ThingType TYPE_FLOAT = 2;
@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "main/util.h"
+#include "main/thing.h"
+#include "main/stats.h"
+
+ExecStats* createExecStats() {
+    ExecStats* stats = (ExecStats*) calloc(1, sizeof(ExecStats));
+    stats->previous = OPCODES;
+    stats->funcsCapacity = 64;
+    stats->funcs = (StatsFunc*) calloc(stats->funcsCapacity,
+            sizeof(StatsFunc));
+    return stats;
+}
+
+void destroyExecStats(ExecStats* stats) {
+    free(stats->funcs);
+    free(stats);
+}
+
+void countCall(ExecStats* stats, Thing* callee, Thing** args, uint8_t arity) {
+    ThingType type = typeOfThing(callee);
+    stats->callees[type]++;
+    if(type == TYPE_SYMBOL && arity > 0) {
+        stats->receivers[typeOfThing(args[0])]++;
+    }
+}
+
+/**
+ * Returns the entry of the function in the table, or the unused entry where
+ * it belongs.
+ */
+static StatsFunc* findFunc(StatsFunc* funcs, uint32_t capacity,
+        const Module* module, uint32_t index) {
+    //FNV-1a over the module and the index
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ (uint32_t) (uintptr_t) module) * 16777619u;
+    hash = (hash ^ index) * 16777619u;
+
+    uint32_t mask = capacity - 1;
+    for(uint32_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        StatsFunc* func = &funcs[slot];
+        if(func->count == 0 || (func->module == module &&
+                func->index == index)) {
+            return func;
+        }
+    }
+}
+
+void countFunc(ExecStats* stats, const Module* module, uint32_t index) {
+    //the table is kept at most half full
+    if(stats->funcsLength * 2 >= stats->funcsCapacity) {
+        uint32_t capacity = stats->funcsCapacity * 2;
+        StatsFunc* funcs = (StatsFunc*) calloc(capacity, sizeof(StatsFunc));
+        for(uint32_t i = 0; i < stats->funcsCapacity; i++) {
+            StatsFunc* func = &stats->funcs[i];
+            if(func->count != 0) {
+                *findFunc(funcs, capacity, func->module, func->index) = *func;
+            }
+        }
+        free(stats->funcs);
+        stats->funcs = funcs;
+        stats->funcsCapacity = capacity;
+    }
+
+    StatsFunc* func = findFunc(stats->funcs, stats->funcsCapacity, module,
+            index);
+    if(func->count == 0) {
+        func->module = module;
+        func->index = index;
+        stats->funcsLength++;
+    }
+    func->count++;
+}
+
+typedef struct {
+    //freed once the row is printed
+    char* name;
+    uint64_t count;
+} StatsRow;
+
+static int compareRows(const void* a, const void* b) {
+    uint64_t countA = ((const StatsRow*) a)->count;
+    uint64_t countB = ((const StatsRow*) b)->count;
+    //the most frequent rows come first
+    return (countA < countB) - (countA > countB);
+}
+
+/**
+ * Prints at most limit of the rows, from the most frequent to the least, and
+ * frees their names.
+ */
+static void printRows(FILE* file, const char* title, StatsRow* rows,
+        uint32_t length, uint32_t limit) {
+    qsort(rows, length, sizeof(StatsRow), compareRows);
+    fprintf(file, "%s\n", title);
+    for(uint32_t i = 0; i < length; i++) {
+        if(i < limit) {
+            fprintf(file, "    %-40s %12llu\n", rows[i].name,
+                    (unsigned long long) rows[i].count);
+        }
+        free(rows[i].name);
+    }
+}
+
+/**
+ * Prints the types that were counted.
+ */
+static void printTypes(FILE* file, const char* title, uint64_t* counts) {
+    StatsRow rows[THING_TYPES];
+    uint32_t length = 0;
+    for(uint32_t i = 0; i < THING_TYPES; i++) {
+        if(counts[i] != 0) {
+            rows[length].name = newStr(thingTypeName(i));
+            rows[length].count = counts[i];
+            length++;
+        }
+    }
+    printRows(file, title, rows, length, THING_TYPES);
+}
+
+void printExecStats(ExecStats* stats, FILE* file) {
+    StatsRow* rows = (StatsRow*) malloc(sizeof(StatsRow) * OPCODES * OPCODES);
+    uint32_t length = 0;
+
+    uint64_t total = 0;
+    for(uint8_t i = 0; i < OPCODES; i++) {
+        if(stats->opcodes[i] != 0) {
+            rows[length].name = newStr(opcodeName(i));
+            rows[length].count = stats->opcodes[i];
+            total += stats->opcodes[i];
+            length++;
+        }
+    }
+    fprintf(file, "instructions executed: %llu\n", (unsigned long long) total);
+    printRows(file, "opcodes:", rows, length, OPCODES);
+
+    //the first instruction has no pair
+    length = 0;
+    for(uint8_t i = 0; i < OPCODES; i++) {
+        for(uint8_t j = 0; j < OPCODES; j++) {
+            if(stats->pairs[i][j] != 0) {
+                rows[length].name = (char*) formatStr("%s %s", opcodeName(i),
+                        opcodeName(j));
+                rows[length].count = stats->pairs[i][j];
+                length++;
+            }
+        }
+    }
+    printRows(file, "opcode pairs:", rows, length, STATS_REPORTED);
+    free(rows);
+
+    rows = (StatsRow*) malloc(sizeof(StatsRow) * stats->funcsLength);
+    length = 0;
+    for(uint32_t i = 0; i < stats->funcsCapacity; i++) {
+        StatsFunc* func = &stats->funcs[i];
+        if(func->count == 0) {
+            continue;
+        }
+        SrcLoc location = findSrcLoc(func->module, func->index);
+        const char* name = func->module->name;
+        rows[length].name = (char*) formatStr("%s:%i:%i",
+                name == NULL ? "[unknown]" : name, location.line,
+                location.column);
+        rows[length].count = func->count;
+        length++;
+    }
+    printRows(file, "functions:", rows, length, STATS_REPORTED);
+    free(rows);
+
+    printTypes(file, "callees:", stats->callees);
+    printTypes(file, "symbol receivers:", stats->receivers);
+}
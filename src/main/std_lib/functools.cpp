@@ -1,5 +1,6 @@
 #include <stdlib.h>
 
+#include "main/gc.h"
 #include "main/std_lib/functools.h"
 
 #define UNUSED(x) (void)(x)
@@ -79,6 +80,10 @@ public:
     ThingType type() {
         return TYPE_VARARG;
     }
+
+    void markChildren(Runtime* runtime) {
+        markThing(runtime, this->func);
+    }
 };
 
 RetVal varargCall(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
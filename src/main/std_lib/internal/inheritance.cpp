@@ -8,17 +8,17 @@ RetVal libProperties(Runtime* runtime, Thing* self, Thing** args, uint8_t arity)
     }
 
     Thing* list = runtime->noneThing;
-    Entry* entry = getObjectMap(args[0])->entry;
+    Thing** slots = getObjectSlots(args[0]);
 
-    while(entry != NULL) {
+    //each shape adds the symbol of the last slot to its parent
+    for(Shape* shape = getObjectShape(args[0]); shape->parent != NULL;
+            shape = shape->parent) {
         Thing** elements = (Thing**) malloc(sizeof(Thing*) * 2);
-        uint32_t* key = (uint32_t*) entry->key;
-        elements[0] = createSymbolThing(runtime, *key, 0);
-        elements[1] = (Thing*) entry->value;
+        elements[0] = createSymbolThing(runtime, shape->symbol, 0);
+        elements[1] = slots[shape->slotCount - 1];
         Thing* head = createTupleThing(runtime, 2, elements);
 
         list = createListThing(runtime, head, list);
-        entry = entry->tail;
     }
 
     return createRetVal(list, 0);
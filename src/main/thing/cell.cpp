@@ -1,5 +1,6 @@
 #include "main/runtime.h"
 #include "main/thing.h"
+#include "main/gc.h"
 #include "main/thing/cell.h"
 
 CellThing::CellThing(Thing* value) :
@@ -19,6 +20,10 @@ ThingType CellThing::type() {
     return TYPE_CELL;
 }
 
+void CellThing::markChildren(Runtime* runtime) {
+    markThing(runtime, this->value);
+}
+
 Thing* createCellThing(Runtime* runtime, Thing* value) {
     return createThing(runtime, new CellThing(value));
 }
@@ -30,11 +30,8 @@ Thing* createErrorThing(Runtime* runtime, const char* msg) {
     Thing* thing = createThing(runtime, new ErrorThing(msg, NULL));
     ErrorThing* self = (ErrorThing*) thing;
 
-    List* list = reverseList(runtime->stackFrame);
-    List* listOriginal = list;
-
-    while(list != NULL) {
-        StackFrame* stackFrame = (StackFrame*) list->head;
+    for(uint32_t i = 0; i < runtime->stackFrameLength; i++) {
+        StackFrame* stackFrame = &runtime->stackFrame[i];
         ErrorFrame* errorFrame = (ErrorFrame*) malloc(sizeof(ErrorFrame));
 
         errorFrame->location.line = 0;
@@ -46,9 +43,11 @@ Thing* createErrorThing(Runtime* runtime, const char* msg) {
 
             StackFrameDef* frameDef = &stackFrame->def;
 
-            for(uint32_t i = 0; i < frameDef->module->srcLocLength; i++) {
-                if(frameDef->index == frameDef->module->srcLoc[i].index) {
-                    errorFrame->location = frameDef->module->srcLoc[i].location;
+            //the frame's index refers to the decoded instructions
+            uint32_t offset = frameDef->module->code[frameDef->index].offset;
+            for(uint32_t j = 0; j < frameDef->module->srcLocLength; j++) {
+                if(offset == frameDef->module->srcLoc[j].index) {
+                    errorFrame->location = frameDef->module->srcLoc[j].location;
                     break;
                 }
             }
@@ -59,12 +58,8 @@ Thing* createErrorThing(Runtime* runtime, const char* msg) {
         }
 
         self->stackFrame = consList(errorFrame, self->stackFrame);
-
-        list = list->tail;
     }
 
-    destroyList(listOriginal, nothing);
-
     return thing;
 }
 
@@ -2,8 +2,7 @@
 #include "main/thing.h"
 #include "main/thing/float.h"
 
-FloatThing::FloatThing(float value) :
-        value(value) {}
+FloatThing::FloatThing() {}
 
 FloatThing::~FloatThing() {}
 
@@ -12,87 +11,56 @@ RetVal FloatThing::call(Runtime* runtime, Thing* self, Thing** args, uint8_t ari
 }
 
 RetVal FloatThing::dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
-    uint32_t id = getSymbolId(self);
-    if(id == SYM_RESPONDS_TO) {
-        if(arity != 2) {
-            const char* fmt = "expected 2 args but got %i";
-            return throwMsg(runtime, formatStr(fmt, arity));
-        }
-
-        if(typeOfThing(args[1]) != TYPE_SYMBOL) {
-            //TODO report the actual type
-            const char* msg = "expected argument 2 to be a symbol";
-            return throwMsg(runtime, newStr(msg));
-        }
-
-        uint32_t checking = getSymbolId(args[1]);
-        uint8_t respondsTo =
-                checking == SYM_ADD ||
-                checking == SYM_SUB ||
-                checking == SYM_MUL ||
-                checking == SYM_DIV ||
-                checking == SYM_EQ ||
-                checking == SYM_NOT_EQ ||
-                checking == SYM_LESS_THAN ||
-                checking == SYM_LESS_THAN_EQ ||
-                checking == SYM_GREATER_THAN ||
-                checking == SYM_GREATER_THAN_EQ;
-
-        return createRetVal(createBoolThing(runtime, respondsTo), 0);
-    } else {
-        RetVal retVal = typeCheck(runtime, self, args, arity, 2,
-                TYPE_FLOAT, TYPE_FLOAT);
-        if(isRetValError(retVal)) {
-            return retVal;
-        }
-
-        float valueA = ((FloatThing*) args[0])->value;
-        float valueB = ((FloatThing*) args[1])->value;
-
-        Thing* thing = NULL;
-        const char* error = NULL;
-
-        if(id == SYM_ADD) {
-            thing = createFloatThing(runtime, valueA + valueB);
-        } else if(id == SYM_SUB) {
-            thing = createFloatThing(runtime, valueA - valueB);
-        } else if(id == SYM_MUL) {
-            thing = createFloatThing(runtime, valueA * valueB);
-        } else if(id == SYM_DIV) {
-            thing = createFloatThing(runtime, valueA / valueB);
-        } else if(id == SYM_EQ) {
-            thing = createBoolThing(runtime, (uint8_t) (valueA == valueB));
-        } else if(id == SYM_NOT_EQ) {
-            thing = createBoolThing(runtime, (uint8_t) (valueA != valueB));
-        } else if(id == SYM_LESS_THAN) {
-            thing = createBoolThing(runtime, (uint8_t) (valueA < valueB));
-        } else if(id == SYM_LESS_THAN_EQ) {
-            thing = createBoolThing(runtime, (uint8_t) (valueA <= valueB));
-        } else if(id == SYM_GREATER_THAN) {
-            thing = createBoolThing(runtime, (uint8_t) (valueA > valueB));
-        } else if(id == SYM_GREATER_THAN_EQ) {
-            thing = createBoolThing(runtime, (uint8_t) (valueA >= valueB));
-        } else {
-            //TODO report the symbol
-            error = "floats do not respond to that symbol";
-        }
-
-        if(error != NULL) {
-            return throwMsg(runtime, error);
-        } else {
-            return createRetVal(thing, 0);
-        }
-    }
+    return handlerDispatch(runtime, TYPE_FLOAT, self, args, arity,
+            "floats do not respond to that symbol");
 }
 
 ThingType FloatThing::type() {
     return TYPE_FLOAT;
 }
 
-Thing* createFloatThing(Runtime* runtime, float value) {
-    return createThing(runtime, new FloatThing(value));
-}
+//defines the handler of an operator on two floats. The operands are valueA
+//and valueB.
+#define FLOAT_OPERATOR(name, result) \
+    static RetVal name(Runtime* runtime, Thing* self, Thing** args, \
+            uint8_t arity) { \
+        RetVal retVal = typeCheck(runtime, self, args, arity, 2, TYPE_FLOAT, \
+                TYPE_FLOAT); \
+        if(isRetValError(retVal)) { \
+            return retVal; \
+        } \
+        float valueA = thingAsFloat(args[0]); \
+        float valueB = thingAsFloat(args[1]); \
+        return createRetVal(result, 0); \
+    }
+
+FLOAT_OPERATOR(floatAdd, createFloatThing(runtime, valueA + valueB))
+FLOAT_OPERATOR(floatSub, createFloatThing(runtime, valueA - valueB))
+FLOAT_OPERATOR(floatMul, createFloatThing(runtime, valueA * valueB))
+FLOAT_OPERATOR(floatDiv, createFloatThing(runtime, valueA / valueB))
+FLOAT_OPERATOR(floatEq,
+        createBoolThing(runtime, (uint8_t) (valueA == valueB)))
+FLOAT_OPERATOR(floatNotEq,
+        createBoolThing(runtime, (uint8_t) (valueA != valueB)))
+FLOAT_OPERATOR(floatLessThan,
+        createBoolThing(runtime, (uint8_t) (valueA < valueB)))
+FLOAT_OPERATOR(floatLessThanEq,
+        createBoolThing(runtime, (uint8_t) (valueA <= valueB)))
+FLOAT_OPERATOR(floatGreaterThan,
+        createBoolThing(runtime, (uint8_t) (valueA > valueB)))
+FLOAT_OPERATOR(floatGreaterThanEq,
+        createBoolThing(runtime, (uint8_t) (valueA >= valueB)))
 
-float thingAsFloat(Thing* thing) {
-    return ((FloatThing*) thing)->value;
+void initFloatHandlers() {
+    setSymbolHandler(TYPE_FLOAT, SYM_RESPONDS_TO, respondsToHandler);
+    setSymbolHandler(TYPE_FLOAT, SYM_ADD, floatAdd);
+    setSymbolHandler(TYPE_FLOAT, SYM_SUB, floatSub);
+    setSymbolHandler(TYPE_FLOAT, SYM_MUL, floatMul);
+    setSymbolHandler(TYPE_FLOAT, SYM_DIV, floatDiv);
+    setSymbolHandler(TYPE_FLOAT, SYM_EQ, floatEq);
+    setSymbolHandler(TYPE_FLOAT, SYM_NOT_EQ, floatNotEq);
+    setSymbolHandler(TYPE_FLOAT, SYM_LESS_THAN, floatLessThan);
+    setSymbolHandler(TYPE_FLOAT, SYM_LESS_THAN_EQ, floatLessThanEq);
+    setSymbolHandler(TYPE_FLOAT, SYM_GREATER_THAN, floatGreaterThan);
+    setSymbolHandler(TYPE_FLOAT, SYM_GREATER_THAN_EQ, floatGreaterThanEq);
 }
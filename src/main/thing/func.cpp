@@ -1,11 +1,23 @@
+#include <stdlib.h>
+
 #include "main/runtime.h"
 #include "main/thing.h"
+#include "main/gc.h"
 #include "main/thing/func.h"
 
-FuncThing::FuncThing(unsigned int entry, Module* module, Scope* parentScope) :
-    entry(entry), module(module), parentScope(parentScope) {}
+FuncThing::FuncThing(unsigned int entry, Module* module, Scope* parentScope,
+        uint32_t capturedCount) :
+    entry(entry), module(module), parentScope(parentScope),
+    capturedCount(capturedCount), unresolved(capturedCount) {
+    this->captured = (Thing**) malloc(sizeof(Thing*) * capturedCount);
+    for(uint32_t i = 0; i < capturedCount; i++) {
+        this->captured[i] = NULL;
+    }
+}
 
-FuncThing::~FuncThing() {}
+FuncThing::~FuncThing() {
+    free(this->captured);
+}
 
 RetVal FuncThing::call(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
     return callFail(runtime);
@@ -19,6 +31,13 @@ ThingType FuncThing::type() {
     return TYPE_FUNC;
 }
 
+void FuncThing::markChildren(Runtime* runtime) {
+    markScope(runtime, this->parentScope);
+    for(uint32_t i = 0; i < this->capturedCount; i++) {
+        markThing(runtime, this->captured[i]);
+    }
+}
+
 unsigned int getFuncEntry(Thing* thing) {
     return ((FuncThing*) thing)->entry;
 }
@@ -31,7 +50,36 @@ Scope* getFuncParentScope(Thing* thing) {
     return ((FuncThing*) thing)->parentScope;
 }
 
+Thing** getFuncCaptured(Thing* thing) {
+    return ((FuncThing*) thing)->captured;
+}
+
+/**
+ * Returns the module level scope that the scope is nested in.
+ */
+static Scope* moduleScope(Scope* scope) {
+    while(scope->locals == NULL) {
+        scope = scope->parent;
+    }
+    return scope;
+}
+
+void setFuncUnresolved(Thing* thing, uint32_t unresolved) {
+    FuncThing* func = (FuncThing*) thing;
+    func->unresolved = unresolved;
+    if(unresolved == 0) {
+        func->parentScope = moduleScope(func->parentScope);
+    }
+}
+
+void resolveFuncCaptured(Thing* thing, uint32_t index, Thing* value) {
+    FuncThing* func = (FuncThing*) thing;
+    func->captured[index] = value;
+    setFuncUnresolved(thing, func->unresolved - 1);
+}
+
 Thing* createFuncThing(Runtime* runtime, uint32_t entry,
-        Module* module, Scope* parentScope) {
-    return createThing(runtime, new FuncThing(entry, module, parentScope));
+        Module* module, Scope* parentScope, uint32_t capturedCount) {
+    return createThingSized(runtime, new FuncThing(entry, module, parentScope,
+            capturedCount), sizeof(FuncThing) + sizeof(Thing*) * capturedCount);
 }
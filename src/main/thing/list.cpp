@@ -1,5 +1,6 @@
 #include "main/runtime.h"
 #include "main/thing.h"
+#include "main/gc.h"
 #include "main/thing/list.h"
 
 ListThing::ListThing(Thing* head, Thing* tail) :
@@ -18,6 +19,11 @@ ThingType ListThing::type() {
     return TYPE_LIST;
 }
 
+void ListThing::markChildren(Runtime* runtime) {
+    markThing(runtime, this->head);
+    markThing(runtime, this->tail);
+}
+
 Thing* getListHead(Thing* thing) {
     return ((ListThing*) thing)->head;
 }
@@ -17,10 +17,3 @@ RetVal NoneThing::dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_t
 ThingType NoneThing::type() {
     return TYPE_NONE;
 }
-
-/**
- * Singleton none object.
- */
-Thing* createNoneThing(Runtime* runtime) {
-    return createThing(runtime, new NoneThing());
-}
@@ -1,13 +1,14 @@
 #include "main/runtime.h"
 #include "main/execute.h"
 #include "main/thing.h"
+#include "main/gc.h"
 #include "main/thing/object.h"
 
-ObjectThing::ObjectThing(Map* map) :
-    map(map) {}
+ObjectThing::ObjectThing(Shape* shape, Thing** slots) :
+    shape(shape), slots(slots) {}
 
 ObjectThing::~ObjectThing() {
-    destroyMap(this->map, free, nothing);
+    free(this->slots);
 }
 
 RetVal ObjectThing::call(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
@@ -22,7 +23,7 @@ RetVal ObjectThing::call(Runtime* runtime, Thing* self, Thing** args, uint8_t ar
         return throwMsg(runtime, "expected self to be an object");
     }
 
-    Thing* value = (Thing*) getMapUint32(this->map, SYM_CALL);
+    Thing* value = getObjectProperty(self, SYM_CALL);
     if(value == NULL) {
         const char* msg = "object is not callable (does not have call property)";
         return throwMsg(runtime, newStr(msg));
@@ -43,7 +44,7 @@ RetVal ObjectThing::dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_
         return throwMsg(runtime, "expected argument 1 to be an object");
     }
 
-    Thing* value = (Thing*) getMapUint32(this->map, getSymbolId(self));
+    Thing* value = getObjectProperty(args[0], getSymbolId(self));
     if(value == NULL) {
         if(getSymbolId(self) == SYM_RESPONDS_TO) {
             if(arity != 2) {
@@ -58,7 +59,8 @@ RetVal ObjectThing::dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_
             }
 
             uint32_t checking = getSymbolId(args[1]);
-            uint32_t responds = getMapUint32(this->map, checking) != NULL;
+            uint32_t slot;
+            uint32_t responds = findShapeSlot(this->shape, checking, &slot);
             return createRetVal(createBoolThing(runtime, responds), 0);
         } else {
             const char* msg = "object does not respond to that symbol";
@@ -82,10 +84,92 @@ ThingType ObjectThing::type() {
     return TYPE_OBJECT;
 }
 
-Thing* createObjectThing(Runtime* runtime, Map* map) {
-    return createThing(runtime, new ObjectThing(map));
+void ObjectThing::markChildren(Runtime* runtime) {
+    for(uint32_t i = 0; i < this->shape->slotCount; i++) {
+        markThing(runtime, this->slots[i]);
+    }
+}
+
+Thing* createObjectThing(Runtime* runtime, Shape* shape, Thing** slots) {
+    return createThingSized(runtime, new ObjectThing(shape, slots),
+            sizeof(ObjectThing) + sizeof(Thing*) * shape->slotCount);
+}
+
+Shape* getObjectShape(Thing* object) {
+    return ((ObjectThing*) object)->shape;
+}
+
+Thing** getObjectSlots(Thing* object) {
+    return ((ObjectThing*) object)->slots;
 }
 
-Map* getObjectMap(Thing* object) {
-    return ((ObjectThing*) object)->map;
+Thing* getObjectProperty(Thing* object, uint32_t symbol) {
+    ObjectThing* self = (ObjectThing*) object;
+    uint32_t slot;
+    if(findShapeSlot(self->shape, symbol, &slot)) {
+        return self->slots[slot];
+    } else {
+        return NULL;
+    }
+}
+
+static Shape* rootShape = NULL;
+
+Shape* createShape(Shape* parent, uint32_t symbol, uint32_t slotCount,
+        Map* slots) {
+    Shape* shape = (Shape*) malloc(sizeof(Shape));
+    shape->parent = parent;
+    shape->symbol = symbol;
+    shape->slotCount = slotCount;
+    shape->slots = slots;
+    shape->transitions = createMap();
+    return shape;
+}
+
+Shape* emptyShape() {
+    if(rootShape == NULL) {
+        rootShape = createShape(NULL, 0, 0, createMap());
+    }
+    return rootShape;
+}
+
+Shape* addShapeSymbol(Shape* shape, uint32_t symbol) {
+    Shape* child = (Shape*) getMapUint32(shape->transitions, symbol);
+    if(child != NULL) {
+        return child;
+    }
+
+    Map* slots = createMap();
+    for(Entry* entry = firstEntryMap(shape->slots); entry != NULL;
+            entry = nextEntryMap(shape->slots, entry)) {
+        putMapUint32(slots, entry->num, boxUint32(*((uint32_t*) entry->value)));
+    }
+    putMapUint32(slots, symbol, boxUint32(shape->slotCount));
+
+    child = createShape(shape, symbol, shape->slotCount + 1, slots);
+    putMapUint32(shape->transitions, symbol, child);
+    return child;
+}
+
+uint8_t findShapeSlot(Shape* shape, uint32_t symbol, uint32_t* slot) {
+    uint32_t* found = (uint32_t*) getMapUint32(shape->slots, symbol);
+    if(found == NULL) {
+        return 0;
+    }
+    *slot = *found;
+    return 1;
+}
+
+void destroyShape(void* shape) {
+    Shape* self = (Shape*) shape;
+    destroyMap(self->transitions, nothing, destroyShape);
+    destroyMap(self->slots, nothing, free);
+    free(self);
+}
+
+void destroyShapes() {
+    if(rootShape != NULL) {
+        destroyShape(rootShape);
+        rootShape = NULL;
+    }
 }
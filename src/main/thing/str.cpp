@@ -18,72 +18,81 @@ RetVal StrThing::call(Runtime* runtime, Thing* self, Thing** args, uint8_t arity
 }
 
 RetVal StrThing::dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
-    uint32_t id = getSymbolId(self);
-
-    if(id == SYM_RESPONDS_TO) {
-        if(arity != 2) {
-            const char* fmt = "expected 2 args but got %i";
-            return throwMsg(runtime, formatStr(fmt, arity));
-        }
-
-        if(typeOfThing(args[1]) != TYPE_SYMBOL) {
-            //TODO report the actual type
-            const char* msg = "expected argument 2 to be a symbol";
-            return throwMsg(runtime, newStr(msg));
-        }
-
-        uint32_t checking = getSymbolId(args[1]);
-        uint8_t respondsTo =
-                checking == SYM_ADD ||
-                checking == SYM_EQ ||
-                checking == SYM_NOT_EQ;
-
-        return createRetVal(createBoolThing(runtime, respondsTo), 0);
-    } else {
-        RetVal retVal = typeCheck(runtime, self, args, arity, 2, TYPE_STR,
-                TYPE_STR);
-        if(isRetValError(retVal)) {
-            return retVal;
-        }
-
-        const char* valueA = thingAsStr(args[0]);
-        const char* valueB = thingAsStr(args[1]);
-
-        Thing* thing;
-        const char* error = 0;
-
-        if(id == SYM_ADD) {
-            uint32_t len = strlen(valueA) + strlen(valueB);
-            char* out = (char*) malloc(sizeof(char) * (len + 1));
-            out[0] = 0;
-            strcat(out, valueA);
-            strcat(out, valueB);
-            thing = createStrThing(runtime, out, 0);
-        } else if(id == SYM_EQ) {
-            thing = createBoolThing(runtime, strcmp(valueA, valueB) == 0);
-        } else if(id == SYM_NOT_EQ) {
-            thing = createBoolThing(runtime, strcmp(valueA, valueB) != 0);
-        } else {
-            //TODO report the symbol
-            error = "strs do not respond to that symbol";
-        }
-
-        if(error != NULL) {
-            return throwMsg(runtime, error);
-        } else {
-            return createRetVal(thing, 0);
-        }
-    }
+    return handlerDispatch(runtime, TYPE_STR, self, args, arity,
+            "strs do not respond to that symbol");
 }
 
 ThingType StrThing::type() {
     return TYPE_STR;
 }
 
+static RetVal strAdd(Runtime* runtime, Thing* self, Thing** args,
+        uint8_t arity) {
+    RetVal retVal = typeCheck(runtime, self, args, arity, 2, TYPE_STR,
+            TYPE_STR);
+    if(isRetValError(retVal)) {
+        return retVal;
+    }
+
+    const char* valueA = thingAsStr(args[0]);
+    const char* valueB = thingAsStr(args[1]);
+
+    uint32_t len = strlen(valueA) + strlen(valueB);
+    char* out = (char*) malloc(sizeof(char) * (len + 1));
+    out[0] = 0;
+    strcat(out, valueA);
+    strcat(out, valueB);
+    return createRetVal(createStrThing(runtime, out, 0), 0);
+}
+
+/**
+ * Handles == and !=. equal is 1 for == and 0 for !=.
+ */
+static RetVal strCompare(Runtime* runtime, Thing* self, Thing** args,
+        uint8_t arity, uint8_t equal) {
+    RetVal retVal = typeCheck(runtime, self, args, arity, 2, TYPE_STR,
+            TYPE_STR);
+    if(isRetValError(retVal)) {
+        return retVal;
+    }
+
+    uint8_t same = strcmp(thingAsStr(args[0]), thingAsStr(args[1])) == 0;
+    return createRetVal(createBoolThing(runtime, same == equal), 0);
+}
+
+static RetVal strEq(Runtime* runtime, Thing* self, Thing** args,
+        uint8_t arity) {
+    return strCompare(runtime, self, args, arity, 1);
+}
+
+static RetVal strNotEq(Runtime* runtime, Thing* self, Thing** args,
+        uint8_t arity) {
+    return strCompare(runtime, self, args, arity, 0);
+}
+
 Thing* createStrThing(Runtime* runtime, const char* value, uint8_t literal) {
-    return createThing(runtime, new StrThing(value, literal));
+    size_t size = sizeof(StrThing);
+    if(!literal) {
+        size += strlen(value) + 1;
+    }
+    return createThingSized(runtime, new StrThing(value, literal), size);
+}
+
+Thing* createLiteralStrThing(const char* value) {
+    Thing* thing = new StrThing(value, 1);
+    thing->thingType = TYPE_STR;
+    //it stays marked, so the collector never visits it
+    thing->marked = 1;
+    return thing;
 }
 
 const char* thingAsStr(Thing* self) {
     return ((StrThing*) self)->value;
 }
+
+void initStrHandlers() {
+    setSymbolHandler(TYPE_STR, SYM_RESPONDS_TO, respondsToHandler);
+    setSymbolHandler(TYPE_STR, SYM_ADD, strAdd);
+    setSymbolHandler(TYPE_STR, SYM_EQ, strEq);
+    setSymbolHandler(TYPE_STR, SYM_NOT_EQ, strNotEq);
+}
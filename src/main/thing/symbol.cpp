@@ -14,7 +14,7 @@ RetVal SymbolThing::call(Runtime* runtime, Thing* self, Thing** args, uint8_t ar
         const char* format = "expected %i arguments, but got %i";
         return throwMsg(runtime, formatStr(format, this->arity, arity));
     }
-    return args[0]->dispatch(runtime, self, args, arity);
+    return thingBehavior(args[0])->dispatch(runtime, self, args, arity);
 }
 
 RetVal SymbolThing::dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
@@ -38,3 +38,7 @@ Thing* createSymbolThing(Runtime* runtime, uint32_t id, uint8_t arity) {
 uint32_t getSymbolId(Thing* self) {
     return ((SymbolThing*) self)->id;
 }
+
+uint8_t getSymbolArity(Thing* self) {
+    return ((SymbolThing*) self)->arity;
+}
@@ -6,6 +6,8 @@
 #include "main/execute.h"
 #include "main/runtime.h"
 #include "main/thing.h"
+#include "main/gc.h"
+#include "main/allocs.h"
 
 #include "main/thing/none.h"
 #include "main/thing/int.h"
@@ -22,6 +24,8 @@
 #include "main/thing/object.h"
 #include "main/thing/cell.h"
 
+#define UNUSED(x) (void)(x)
+
 RetVal callFail(Runtime* runtime) {
     return throwMsg(runtime, "cannot call this type");
 }
@@ -50,6 +54,57 @@ RetVal symbolDispatch(Runtime* runtime, Thing* self, Thing** args,
     }
 }
 
+//the handlers of each type, indexed by type and then by symbol id. Types
+//without any handlers have NULL tables.
+static ExecFunc** symbolHandlers = NULL;
+//the number of symbols each table has room for
+static uint32_t symbolHandlerCount = 0;
+
+void setSymbolHandler(ThingType type, uint32_t symbol, ExecFunc handler) {
+    if(symbolHandlers[type] == NULL) {
+        symbolHandlers[type] = (ExecFunc*) calloc(symbolHandlerCount,
+                sizeof(ExecFunc));
+    }
+    symbolHandlers[type][symbol] = handler;
+}
+
+ExecFunc getSymbolHandler(ThingType type, uint32_t symbol) {
+    if(type >= TYPE_UNDEF || symbol >= symbolHandlerCount ||
+            symbolHandlers[type] == NULL) {
+        return NULL;
+    }
+    return symbolHandlers[type][symbol];
+}
+
+RetVal handlerDispatch(Runtime* runtime, ThingType type, Thing* self,
+        Thing** args, uint8_t arity, const char* error) {
+    ExecFunc handler = getSymbolHandler(type, getSymbolId(self));
+    if(handler == NULL) {
+        //TODO report the symbol
+        return throwMsg(runtime, newStr(error));
+    }
+    return handler(runtime, self, args, arity);
+}
+
+RetVal respondsToHandler(Runtime* runtime, Thing* self, Thing** args,
+        uint8_t arity) {
+    UNUSED(self);
+    if(arity != 2) {
+        const char* fmt = "expected 2 args but got %i";
+        return throwMsg(runtime, formatStr(fmt, arity));
+    }
+
+    if(typeOfThing(args[1]) != TYPE_SYMBOL) {
+        //TODO report the actual type
+        const char* msg = "expected argument 2 to be a symbol";
+        return throwMsg(runtime, newStr(msg));
+    }
+
+    ExecFunc handler = getSymbolHandler(typeOfThing(args[0]),
+            getSymbolId(args[1]));
+    return createRetVal(createBoolThing(runtime, handler != NULL), 0);
+}
+
 uint32_t SYM_ADD = 0;
 uint32_t SYM_SUB = 0;
 uint32_t SYM_MUL = 0;
@@ -69,8 +124,6 @@ uint32_t SYM_CALL = 0;
 uint32_t SYM_RESPONDS_TO = 0;
 uint32_t SYM_UNPACK = 0;
 
-#define UNUSED(x) (void)(x)
-
 void destroySimpleThing(Thing* thing) {
     UNUSED(thing);
 }
@@ -107,6 +160,17 @@ void initThing() {
         SYM_RESPONDS_TO = newSymbolId();
         SYM_UNPACK = newSymbolId();
 
+        //the symbols above are consecutive, so the handler tables only need
+        //room for them
+        symbolHandlerCount = SYM_UNPACK + 1;
+        symbolHandlers = (ExecFunc**) calloc(TYPE_UNDEF, sizeof(ExecFunc*));
+        initIntHandlers();
+        initFloatHandlers();
+        initStrHandlers();
+        initBoolHandlers();
+        initTupleHandlers();
+        initModuleHandlers();
+
         initialized = 1;
     }
 }
@@ -129,30 +193,89 @@ void deinitThing() {
         SYM_DOT = 0;
         SYM_CALL = 0;
 
+        for(uint32_t i = 0; i < TYPE_UNDEF; i++) {
+            free(symbolHandlers[i]);
+        }
+        free(symbolHandlers);
+        symbolHandlers = NULL;
+        symbolHandlerCount = 0;
+
+        destroyShapes();
         initialized = 0;
     }
 }
 
-/**
- * Creates a thing. If the runtime is destroyed, the object will also be
- * destroyed.
- *
- * @param runtime the runtime object
- * @param type the native type of the object
- * @param size the size of the object's custom data. The custom data is found
- *      after the Thing struct.
- */
-Thing* createThing(Runtime* runtime, Thing* type) {
-    runtime->allocatedThings = consList(type, runtime->allocatedThings);
-    return type;
+Thing* createThingSized(Runtime* runtime, Thing* thing, size_t size) {
+    thing->thingType = thing->type();
+    runtime->allocatedThings = consList(thing, runtime->allocatedThings);
+    runtime->allocationCount++;
+    runtime->allocationTotal++;
+    if(runtime->allocStats != NULL) {
+        countAlloc(runtime, thing->thingType, size);
+    }
+    pinThing(runtime, thing);
+    return thing;
+}
+
+const char* thingTypeName(ThingType type) {
+    if(type == TYPE_NONE) {
+        return "none";
+    } else if(type == TYPE_INT) {
+        return "int";
+    } else if(type == TYPE_FLOAT) {
+        return "float";
+    } else if(type == TYPE_STR) {
+        return "str";
+    } else if(type == TYPE_BOOL) {
+        return "bool";
+    } else if(type == TYPE_MODULE) {
+        return "module";
+    } else if(type == TYPE_FUNC) {
+        return "func";
+    } else if(type == TYPE_NATIVE_FUNC) {
+        return "native func";
+    } else if(type == TYPE_ERROR) {
+        return "error";
+    } else if(type == TYPE_TUPLE) {
+        return "tuple";
+    } else if(type == TYPE_LIST) {
+        return "list";
+    } else if(type == TYPE_OBJECT) {
+        return "object";
+    } else if(type == TYPE_CELL) {
+        return "cell";
+    } else if(type == TYPE_SYMBOL) {
+        return "symbol";
+    } else if(type == TYPE_VARARG) {
+        return "vararg";
+    } else {
+        return "undefined";
+    }
 }
 
 void destroyThing(Thing* thing) {
     delete thing;
 }
 
-ThingType typeOfThing(Thing* thing) {
-    return thing->type();
+static IntThing intBehavior;
+static FloatThing floatBehavior;
+static BoolThing boolBehavior;
+static NoneThing noneBehavior;
+
+Thing* thingBehavior(Thing* thing) {
+    if(!isThingImmediate(thing)) {
+        return thing;
+    }
+    switch((uintptr_t) thing & THING_TAG_MASK) {
+    case THING_TAG_INT:
+        return &intBehavior;
+    case THING_TAG_FLOAT:
+        return &floatBehavior;
+    case THING_TAG_BOOL:
+        return &boolBehavior;
+    default:
+        return &noneBehavior;
+    }
 }
 
 RetVal typeCheck(Runtime* runtime, Thing* self, Thing** args, uint8_t arity,
@@ -3,6 +3,7 @@
 
 #include "main/runtime.h"
 #include "main/thing.h"
+#include "main/gc.h"
 #include "main/thing/tuple.h"
 
 TupleThing::TupleThing(uint8_t size, Thing** elements) :
@@ -17,103 +18,113 @@ RetVal TupleThing::call(Runtime* runtime, Thing* self, Thing** args, uint8_t ari
 }
 
 RetVal TupleThing::dispatch(Runtime* runtime, Thing* self, Thing** args, uint8_t arity) {
-    //TODO check self is really a symbol first
-    uint32_t id = getSymbolId(self);
+    return handlerDispatch(runtime, TYPE_TUPLE, self, args, arity,
+            "tuples do not respond to that symbol");
+}
 
-    if(id == SYM_RESPONDS_TO) {
-        if(arity != 2) {
-            return throwMsg(runtime, formatStr("expected 2 args but got %i", arity));
-        }
+ThingType TupleThing::type() {
+    return TYPE_TUPLE;
+}
 
-        if(typeOfThing(args[1]) != TYPE_SYMBOL) {
-            //TODO report the actual type
-            const char* msg = "expected argument 2 to be a symbol";
-            return throwMsg(runtime, newStr(msg));
-        }
+/**
+ * Handles == and !=, which compare the elements with ==. all is 1 for == and
+ * 0 for !=.
+ */
+static RetVal tupleCompare(Runtime* runtime, Thing* self, Thing** args,
+        uint8_t arity, uint8_t all) {
+    RetVal ret = typeCheck(runtime, self, args, arity, 2, TYPE_TUPLE,
+            TYPE_TUPLE);
+
+    if(isRetValError(ret)) {
+        return ret;
+    }
+
+    TupleThing* valueA = (TupleThing*) args[0];
+    TupleThing* valueB = (TupleThing*) args[1];
 
-        uint32_t checking = getSymbolId(args[1]);
-        uint8_t respondsTo =
-                checking == SYM_RESPONDS_TO ||
-                checking == SYM_EQ ||
-                checking == SYM_NOT_EQ ||
-                checking == SYM_GET;
+    if(valueA->size != valueB->size) {
+        return createRetVal(createBoolThing(runtime, 0), 0);
+    }
+
+    Thing* eqSym = (Thing*) getMapStr(runtime->operators, "==");
 
-        return createRetVal(createBoolThing(runtime, respondsTo), 0);
-    } else if(id == SYM_EQ || id == SYM_NOT_EQ) {
-        RetVal ret = typeCheck(runtime, self, args, arity, 2, TYPE_TUPLE,
-                TYPE_TUPLE);
+    Thing** elems = (Thing**) malloc(sizeof(Thing*) * 2);
 
+    for(uint8_t i = 0; i < valueA->size; i++) {
+        elems[0] = valueA->elements[i];
+        elems[1] = valueB->elements[i];
+
+        ret = callFunction(runtime, eqSym, 2, elems);
         if(isRetValError(ret)) {
+            free(elems);
             return ret;
         }
-        uint8_t all = getSymbolId(self) == SYM_EQ;
 
-        TupleThing* valueA = (TupleThing*) args[0];
-        TupleThing* valueB = (TupleThing*) args[1];
+        Thing* value = getRetVal(ret);
 
-        if(valueA->size != valueB->size) {
-            return createRetVal(createBoolThing(runtime, 0), 0);
+        if(typeOfThing(value) != TYPE_BOOL) {
+            free(elems);
+            const char* msg = newStr("internal error: == did not return a bool");
+            return throwMsg(runtime, msg);
         }
 
-        Thing* eqSym = (Thing*) getMapStr(runtime->operators, "==");
-
-        Thing** elems = (Thing**) malloc(sizeof(Thing*) * 2);
-
-        for(uint8_t i = 0; i < valueA->size; i++) {
-            elems[0] = valueA->elements[i];
-            elems[1] = valueB->elements[i];
+        if(thingAsBool(value) != all) {
+            free(elems);
+            return ret;
+        }
+    }
 
-            ret = callFunction(runtime, eqSym, 2, elems);
-            if(isRetValError(ret)) {
-                free(elems);
-                return ret;
-            }
+    free(elems);
+    return createRetVal(createBoolThing(runtime, all), 0);
+}
 
-            Thing* value = getRetVal(ret);
+static RetVal tupleEq(Runtime* runtime, Thing* self, Thing** args,
+        uint8_t arity) {
+    return tupleCompare(runtime, self, args, arity, 1);
+}
 
-            if(typeOfThing(value) != TYPE_BOOL) {
-                free(elems);
-                const char* msg = newStr("internal error: == did not return a bool");
-                return throwMsg(runtime, msg);
-            }
+static RetVal tupleNotEq(Runtime* runtime, Thing* self, Thing** args,
+        uint8_t arity) {
+    return tupleCompare(runtime, self, args, arity, 0);
+}
 
-            if(thingAsBool(value) != all) {
-                free(elems);
-                return ret;
-            }
-        }
+static RetVal tupleGet(Runtime* runtime, Thing* self, Thing** args,
+        uint8_t arity) {
+    RetVal ret = typeCheck(runtime, self, args, arity, 2,
+            TYPE_TUPLE, TYPE_INT);
 
-        free(elems);
-        return createRetVal(createBoolThing(runtime, all), 0);
-    } else if(id == SYM_GET) {
-        RetVal ret = typeCheck(runtime, self, args, arity, 2,
-                TYPE_TUPLE, TYPE_INT);
+    if(isRetValError(ret)) {
+        return ret;
+    }
 
-        if(isRetValError(ret)) {
-            return ret;
-        }
+    TupleThing* tuple = (TupleThing*) args[0];
+    int32_t index = thingAsInt(args[1]);
 
-        TupleThing* tuple = (TupleThing*) args[0];
-        int32_t index = thingAsInt(args[1]);
+    if(index >= tuple->size) {
+        const char* format = "tuple access out of bounds: "
+                "accessed at %i but the size is %i";
+        return throwMsg(runtime, formatStr(format, index, tuple->size));
+    }
 
-        if(index >= tuple->size) {
-            const char* format = "tuple access out of bounds: "
-                    "accessed at %i but the size is %i";
-            return throwMsg(runtime, formatStr(format, index, tuple->size));
-        }
+    return createRetVal(tuple->elements[index], 0);
+}
 
-        return createRetVal(tuple->elements[index], 0);
-    } else {
-        return throwMsg(runtime, newStr("tuples do not respond to that symbol"));
-    }
+void initTupleHandlers() {
+    setSymbolHandler(TYPE_TUPLE, SYM_RESPONDS_TO, respondsToHandler);
+    setSymbolHandler(TYPE_TUPLE, SYM_EQ, tupleEq);
+    setSymbolHandler(TYPE_TUPLE, SYM_NOT_EQ, tupleNotEq);
+    setSymbolHandler(TYPE_TUPLE, SYM_GET, tupleGet);
 }
 
-ThingType TupleThing::type() {
-    return TYPE_TUPLE;
+void TupleThing::markChildren(Runtime* runtime) {
+    for(uint8_t i = 0; i < this->size; i++) {
+        markThing(runtime, this->elements[i]);
+    }
 }
 
 Thing* createTupleThing(Runtime* runtime, uint8_t size, Thing** elements) {
-    return createThing(runtime, new TupleThing(size, elements));
+    return createThingSized(runtime, new TupleThing(size, elements),
+            sizeof(TupleThing) + sizeof(Thing*) * size);
 }
 
 uint8_t getTupleSize(Thing* tuple) {
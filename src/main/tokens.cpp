@@ -12,6 +12,107 @@
 uint8_t tokensEqualVoid(void* a, void* b);
 uint8_t branchesEqual(void* a, void* b);
 
+//the arena tokens are allocated from, if any
+Arena* tokenArena = NULL;
+
+void setTokenArena(Arena* arena) {
+    tokenArena = arena;
+}
+
+Arena* getTokenArena() {
+    return tokenArena;
+}
+
+char* sliceTokenStr(const char* str, uint32_t start, uint32_t end) {
+    if(tokenArena == NULL) {
+        return sliceStr(str, start, end);
+    }
+    char* slice = (char*) allocArena(tokenArena, end - start + 1);
+    memcpy(slice, &str[start], end - start);
+    slice[end - start] = 0;
+    return slice;
+}
+
+/**
+ * If there is a token arena, moves the memory into it and frees the original.
+ * Tokens in an arena are never destroyed individually, so everything they own
+ * must be in the arena too.
+ */
+void* adoptTokenMem(const void* mem, size_t size) {
+    if(tokenArena == NULL || mem == NULL || containsArena(tokenArena, mem)) {
+        return (void*) mem;
+    }
+    void* adopted = allocArena(tokenArena, size);
+    memcpy(adopted, mem, size);
+    free((void*) mem);
+    return adopted;
+}
+
+const char* adoptTokenStr(const char* str) {
+    if(str == NULL) {
+        return NULL;
+    }
+    return (const char*) adoptTokenMem(str, strlen(str) + 1);
+}
+
+/**
+ * Moves the cells of the list into the token arena.
+ */
+List* adoptTokenList(List* list) {
+    List* adopted = list;
+    for(List** node = &adopted; *node != NULL; node = &(*node)->tail) {
+        *node = (List*) adoptTokenMem(*node, sizeof(List));
+    }
+    return adopted;
+}
+
+/**
+ * Allocates memory owned by a token, such as an ObjectPair, from the token
+ * arena if there is one.
+ */
+void* allocTokenMem(size_t size) {
+    if(tokenArena != NULL) {
+        return allocArena(tokenArena, size);
+    }
+    return malloc(size);
+}
+
+void freeTokenMem(void* mem) {
+    if(tokenArena == NULL || !containsArena(tokenArena, mem)) {
+        free(mem);
+    }
+}
+
+List* consTokenList(void* head, List* tail) {
+    List* list = (List*) allocTokenMem(sizeof(List));
+    list->head = head;
+    list->tail = tail;
+    return list;
+}
+
+void destroyTokenList(List* list, void(*func)(void*)) {
+    while(list != NULL) {
+        List* tail = list->tail;
+        func(list->head);
+        freeTokenMem(list);
+        list = tail;
+    }
+}
+
+Token::Token(SrcLoc location) :
+    location(location), inArena(tokenArena != NULL) {}
+
+void* Token::operator new(size_t size) {
+    if(tokenArena != NULL) {
+        return allocArena(tokenArena, size);
+    }
+    return ::operator new(size);
+}
+
+void Token::operator delete(void* ptr) {
+    ::operator delete(ptr);
+}
+
 SrcLoc tokenLocation(Token* token) {
     return token->location;
 }
@@ -103,7 +204,7 @@ FloatToken* createFloatToken(SrcLoc location, float value) {
 }
 
 LiteralToken::LiteralToken(SrcLoc location, const char* value) :
-    Token(location), value(value) {}
+    Token(location), value(adoptTokenStr(value)) {}
 
 LiteralToken::~LiteralToken() {
     free((void*) this->value);
@@ -143,7 +244,7 @@ LiteralToken* createLiteralToken(SrcLoc loc, const char* value) {
 }
 
 IdentifierToken::IdentifierToken(SrcLoc location, const char* value) :
-    Token(location), value(value) {}
+    Token(location), value(adoptTokenStr(value)) {}
 
 IdentifierToken::~IdentifierToken() {
     free((void*) this->value);
@@ -183,7 +284,7 @@ IdentifierToken* createIdentifierToken(SrcLoc loc, const char* value) {
 }
 
 TupleToken::TupleToken(SrcLoc location, List* elements) :
-    Token(location), elements(elements) {}
+    Token(location), elements(adoptTokenList(elements)) {}
 
 TupleToken::~TupleToken() {
     destroyList(this->elements, destroyTokenVoid);
@@ -225,7 +326,7 @@ TupleToken* createTupleToken(SrcLoc location, List* elements) {
 }
 
 ListToken::ListToken(SrcLoc location, List* elements) :
-    Token(location), elements(elements) {}
+    Token(location), elements(adoptTokenList(elements)) {}
 
 ListToken::~ListToken() {
     destroyList(this->elements, destroyTokenVoid);
@@ -269,7 +370,7 @@ ListToken* createListToken(SrcLoc location, List* elements) {
 }
 
 ObjectPair* createObjectPair(Token* key, Token* value) {
-    ObjectPair* pair = (ObjectPair*) malloc(sizeof(ObjectPair));
+    ObjectPair* pair = (ObjectPair*) allocTokenMem(sizeof(ObjectPair));
     pair->key = key;
     pair->value = value;
     return pair;
@@ -289,7 +390,7 @@ List* copyObjectPairs(List* list, CopyVisitor visitor, void* data) {
 }
 
 ObjectToken::ObjectToken(SrcLoc location, List* elements) :
-    Token(location), elements(elements) {}
+    Token(location), elements(adoptTokenList(elements)) {}
 
 ObjectToken::~ObjectToken() {
     List* elements = this->elements;
@@ -365,7 +466,7 @@ ObjectToken* createObjectToken(SrcLoc location, List* elements) {
 }
 
 CallToken::CallToken(SrcLoc location, List* children) :
-    Token(location), children(children) {}
+    Token(location), children(adoptTokenList(children)) {}
 
 CallToken::~CallToken() {
     List* children = this->children;
@@ -418,7 +519,7 @@ CallToken* createCallToken(SrcLoc location, List* children) {
 }
 
 BinaryOpToken::BinaryOpToken(SrcLoc location, const char* op, Token* left, Token* right) :
-    Token(location), op(op), left(left), right(right) {}
+    Token(location), op(adoptTokenStr(op)), left(left), right(right) {}
 
 BinaryOpToken::~BinaryOpToken() {
     free((void*) this->op);
@@ -476,7 +577,7 @@ BinaryOpToken* createBinaryOpToken(SrcLoc loc, const char* op, Token* left,
 }
 
 UnaryOpToken::UnaryOpToken(SrcLoc location, const char* op, Token* child) :
-    Token(location), op(op), child(child) {}
+    Token(location), op(adoptTokenStr(op)), child(child) {}
 
 UnaryOpToken::~UnaryOpToken() {
     free((void*) this->op);
@@ -579,7 +680,7 @@ AssignmentToken* createAssignmentToken(SrcLoc loc, Token* left, Token* right) {
 }
 
 BlockToken::BlockToken(SrcLoc location, List* children) :
-    Token(location), children(children) {}
+    Token(location), children(adoptTokenList(children)) {}
 
 BlockToken::~BlockToken() {
     destroyList(this->children, destroyTokenVoid);
@@ -615,7 +716,7 @@ BlockToken* createBlockToken(SrcLoc location, List* children) {
 }
 
 IfBranch* createIfBranch(Token* condition, BlockToken* block) {
-    IfBranch* branch = (IfBranch*) malloc(sizeof(IfBranch));
+    IfBranch* branch = (IfBranch*) allocTokenMem(sizeof(IfBranch));
     branch->condition = condition;
     branch->block = block;
     return branch;
@@ -635,7 +736,8 @@ List* copyIfBranches(List* branches, CopyVisitor visitor, void* data) {
 }
 
 IfToken::IfToken(SrcLoc location, List* branches, BlockToken* elseBranch) :
-    Token(location), branches(branches), elseBranch(elseBranch) {}
+    Token(location), branches(adoptTokenList(branches)),
+    elseBranch(elseBranch) {}
 
 IfToken::~IfToken() {
     destroyList(this->branches, destroyIfBranch);
@@ -748,12 +850,14 @@ WhileToken* createWhileToken(SrcLoc loc, Token* condition, BlockToken* body) {
 }
 
 FuncToken::FuncToken(SrcLoc loc, IdentifierToken* name, List* args, BlockToken* body) :
-    Token(loc), name(name), args(args), body(body) {}
+    Token(loc), name(name), args(adoptTokenList(args)), body(body),
+    captured(NULL) {}
 
 FuncToken::~FuncToken() {
     destroyToken(this->name);
     destroyList(this->args, destroyTokenVoid);
     destroyToken(this->body);
+    destroyList(this->captured, destroyTokenVoid);
 }
 
 TokenType FuncToken::type() {
@@ -767,6 +871,13 @@ void FuncToken::print(uint8_t indent) {
         printf(" %s", getIdentifierTokenValue((IdentifierToken*) node->head));
         node = node->tail;
     }
+    if(this->captured != NULL) {
+        printf(" (captures");
+        for(node = this->captured; node != NULL; node = node->tail) {
+            printf(" %s", getIdentifierTokenValue((IdentifierToken*) node->head));
+        }
+        printf(")");
+    }
     printf("\n");
     printTokenWithIndent(this->body, indent + 1);
 }
@@ -776,7 +887,8 @@ uint8_t FuncToken::equals(Token* other) {
 
     return tokensEqual(this->name, otherFunc->name) &&
             allList2(this->args, otherFunc->args, tokensEqualVoid) &&
-            tokensEqual(this->body, otherFunc->body);
+            tokensEqual(this->body, otherFunc->body) &&
+            allList2(this->captured, otherFunc->captured, tokensEqualVoid);
 }
 
 Token* FuncToken::copy(CopyVisitor visitor, void* data) {
@@ -784,7 +896,9 @@ Token* FuncToken::copy(CopyVisitor visitor, void* data) {
     List* args = copyTokenList(this->args, visitor, data);
     BlockToken* body = (BlockToken*) visitor(this->body, data);
 
-    return (Token*) createFuncToken(this->location, name, args, body);
+    FuncToken* func = createFuncToken(this->location, name, args, body);
+    setFuncTokenCaptured(func, copyTokenList(this->captured, visitor, data));
+    return (Token*) func;
 }
 
 IdentifierToken* getFuncTokenName(FuncToken* token) {
@@ -803,6 +917,14 @@ BlockToken* getFuncTokenBody(FuncToken* token) {
     return token->body;
 }
 
+List* getFuncTokenCaptured(FuncToken* token) {
+    return token->captured;
+}
+
+void setFuncTokenCaptured(FuncToken* token, List* captured) {
+    token->captured = adoptTokenList(captured);
+}
+
 FuncToken* createFuncToken(SrcLoc loc, IdentifierToken* name, List* args,
         BlockToken* body) {
     return new FuncToken(loc, name, args, body);
@@ -842,7 +964,7 @@ ReturnToken* createReturnToken(SrcLoc location, Token* body) {
 }
 
 LabelToken::LabelToken(SrcLoc location, const char* name) :
-    Token(location), name(name) {}
+    Token(location), name(adoptTokenStr(name)) {}
 
 LabelToken::~LabelToken() {
     free((void*) this->name);
@@ -879,7 +1001,7 @@ LabelToken* createLabelToken(const char* name) {
 }
 
 AbsJumpToken::AbsJumpToken(SrcLoc location, const char* label) :
-    Token(location), label(label) {}
+    Token(location), label(adoptTokenStr(label)) {}
 
 AbsJumpToken::~AbsJumpToken() {
     free((void*) this->label);
@@ -921,7 +1043,7 @@ CondJumpToken::~CondJumpToken() {
 }
 
 CondJumpToken::CondJumpToken(SrcLoc loc, Token* condition, const char* label, uint8_t when) :
-    Token(loc), condition(condition), label(label), when(when) {}
+    Token(loc), condition(condition), label(adoptTokenStr(label)), when(when) {}
 
 TokenType CondJumpToken::type() {
     return TOKEN_COND_JUMP;
@@ -965,7 +1087,7 @@ CondJumpToken* createCondJumpToken(SrcLoc loc, Token* cond, const char* label,
 }
 
 PushBuiltinToken::PushBuiltinToken(SrcLoc location, const char* name) :
-    Token(location), name(name) {}
+    Token(location), name(adoptTokenStr(name)) {}
 
 PushBuiltinToken::~PushBuiltinToken() {
     free((void*) this->name);
@@ -1059,7 +1181,7 @@ CallOpToken* createCallOpToken(SrcLoc loc, uint8_t arity) {
 }
 
 StoreToken::StoreToken(SrcLoc location, const char* name) :
-    Token(location), name(name) {}
+    Token(location), name(adoptTokenStr(name)) {}
 
 StoreToken::~StoreToken() {
     free((void*) this->name);
@@ -1233,7 +1355,7 @@ PopToken* createPopToken(SrcLoc loc) {
 }
 
 BuiltinToken::BuiltinToken(SrcLoc location, const char* name) :
-    Token(location), name(name) {}
+    Token(location), name(adoptTokenStr(name)) {}
 
 BuiltinToken::~BuiltinToken() {
     free((void*) this->name);
@@ -1294,7 +1416,7 @@ CheckNoneToken* createCheckNoneToken(SrcLoc location) {
 }
 
 NewFuncToken::NewFuncToken(SrcLoc location, const char* name) :
-    Token(location), name(name) {}
+    Token(location), name(adoptTokenStr(name)) {}
 
 NewFuncToken::~NewFuncToken() {
     free((void*) this->name);
@@ -1331,7 +1453,7 @@ NewFuncToken* createNewFuncToken(SrcLoc location, const char* name) {
  * Frees a token's memory, it's data's memory and subtokens recursively
  */
 void destroyToken(Token* token) {
-    if(token != NULL) {
+    if(token != NULL && !token->inArena) {
         delete token;
     }
 }
@@ -1344,7 +1466,7 @@ void destroyIfBranch(void* x) {
     IfBranch* branch = (IfBranch*) x;
     destroyToken((Token*) branch->condition);
     destroyToken((Token*) branch->block);
-    free(branch);
+    freeTokenMem(branch);
 }
 
 /**
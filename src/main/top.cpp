@@ -8,6 +8,8 @@
 #include "main/transform.h"
 #include "main/codegen.h"
 #include "main/execute.h"
+#include "main/cache.h"
+#include "main/phases.h"
 #include "main/top.h"
 
 //from https://stackoverflow.com/questions/14002954/c-programming-how-to-read-the-whole-file-contents-into-a-buffer
@@ -26,28 +28,126 @@ char* readFile(const char* filename) {
 }
 
 Module* sourceToModule(const char* name, const char* src, char** error) {
+    uint8_t timed = timingPhases();
+    double start = timed ? phaseClock() : 0;
+
+    //all the tokens of the module are freed at once with the arena
+    Arena* arena = createArena();
+    setTokenArena(arena);
     BlockToken* ast = parseModule(src, error);
     if(ast == NULL) {
+        setTokenArena(NULL);
+        destroyArena(arena);
         return NULL;
     }
+    if(timed) {
+        double end = phaseClock();
+        //counting the tokens allocates, so it is done after the measurements
+        recordPhase(name, "parse", end - start, arena->allocations,
+                countTokens((Token*) ast), "tokens");
+        start = phaseClock();
+    }
+
     if(!validateModule(ast)) {
+        setTokenArena(NULL);
+        destroyArena(arena);
         return NULL;
     }
-    BlockToken* transformed = transformModule(ast);
-    destroyToken((Token*) ast);
+    if(timed) {
+        recordPhase(name, "validate", phaseClock() - start,
+                PHASE_UNMEASURED, PHASE_UNMEASURED, NULL);
+    }
+
+    TransformPassStats passes[TRANSFORM_PASSES];
+    BlockToken* transformed = transformModuleStats(ast, timed ? passes : NULL);
+    setTokenArena(NULL);
+    if(timed) {
+        for(uint8_t i = 0; i < TRANSFORM_PASSES; i++) {
+            char* phase = (char*) formatStr("transform %s", passes[i].name);
+            recordPhase(name, phase, passes[i].seconds, passes[i].allocations,
+                    passes[i].tokens, "tokens");
+            free(phase);
+        }
+        start = phaseClock();
+    }
+
     Module* module = compileModule((Token*) transformed);
-    destroyToken((Token*) transformed);
+    if(timed) {
+        //compilation allocates from the heap rather than the arena
+        recordPhase(name, "compile", phaseClock() - start, PHASE_UNMEASURED,
+                module->bytecodeLength, "bytes");
+    }
+    destroyArena(arena);
     module->name = name;
     return module;
 }
 
+Module* loadModule(const char* path, const char* src, char** error) {
+#if USE_MODULE_CACHE
+    uint8_t timed = timingPhases();
+    double start = timed ? phaseClock() : 0;
+    Module* module = loadModuleCache(path, src);
+    if(timed) {
+        recordPhase(path, "cache load", phaseClock() - start,
+                PHASE_UNMEASURED, module == NULL ? 0 : module->bytecodeLength,
+                "bytes");
+    }
+    if(module != NULL) {
+        return module;
+    }
+    module = sourceToModule(path, src, error);
+    if(module != NULL) {
+        start = timed ? phaseClock() : 0;
+        saveModuleCache(path, src, module);
+        if(timed) {
+            recordPhase(path, "cache save", phaseClock() - start,
+                    PHASE_UNMEASURED, PHASE_UNMEASURED, NULL);
+        }
+    }
+    return module;
+#else
+    return sourceToModule(path, src, error);
+#endif
+}
+
+uint8_t printTransformStats(const char* src) {
+    char* error = NULL;
+    BlockToken* ast = parseModule(src, &error);
+    if(ast == NULL) {
+        printf("error: %s\n", error);
+        free(error);
+        return 0;
+    }
+    if(!validateModule(ast)) {
+        printf("error: invalid module\n");
+        destroyToken((Token*) ast);
+        return 0;
+    }
+
+    TransformPassStats stats[TRANSFORM_PASSES];
+    BlockToken* transformed = transformModuleStats(ast, stats);
+    printf("%-12s %10s %10s\n", "pass", "tokens", "ms");
+    for(uint8_t i = 0; i < TRANSFORM_PASSES; i++) {
+        printf("%-12s %10u %10.3f\n", stats[i].name, stats[i].tokens,
+                stats[i].seconds * 1000);
+    }
+
+    destroyToken((Token*) ast);
+    destroyToken((Token*) transformed);
+    return 1;
+}
+
 ExecFuncOut execFunc(ExecFuncIn in) {
     ExecFuncOut out;
     out.retVal = createRetVal(NULL, 0);
     out.errorMsg = NULL;
     out.module = NULL;
 
-    out.module = sourceToModule(in.filename, in.src, (char**) &out.errorMsg);
+    if(in.filename != NULL) {
+        out.module = loadModule(in.filename, in.src, (char**) &out.errorMsg);
+    } else {
+        out.module = sourceToModule(NULL, in.src, (char**) &out.errorMsg);
+    }
     if(out.module == NULL) {
         return out;
     }
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 #include "main/util.h"
 #include "main/transform.h"
@@ -14,17 +15,48 @@
 /**
  * Used to create a unique name. This function takes an integer, concatenates
  * it with '$' and increments uniqueId.
- *
- * TODO use uint32_t instead
  */
-const char* uniqueName(uint8_t* uniqueId) {
-    int length = snprintf(NULL, 0, "$%d", *uniqueId);
+const char* uniqueName(uint32_t* uniqueId) {
+    int length = snprintf(NULL, 0, "$%u", *uniqueId);
     char* name = (char*) malloc(length + 1);
-    sprintf(name, "$%d", *uniqueId);
+    sprintf(name, "$%u", *uniqueId);
     (*uniqueId)++;
     return name;
 }
 
+/**
+ * Most of the transformation is done by lowerVisitor, which performs several
+ * rewrites in a single copy of the tree. Each rewrite can be enabled on its
+ * own, which is how the transform* functions for single rewrites work.
+ */
+typedef enum {
+    //functions are moved out of the expressions that create them (see
+    //lowerFunc)
+    LOWER_CLOSURES = 1,
+    //list literals become cons lists (see consTokens)
+    LOWER_LIST_TO_CONS = 2,
+    //if and while statements become jumps and labels (see lowerIf)
+    LOWER_JUMPS = 4,
+    //assignments become stores (see destructureLValue)
+    LOWER_DESTRUCTURE = 8,
+    //object literals become calls to 'object' (see lowerObject)
+    LOWER_OBJECTS = 16,
+    LOWER_ALL = 31
+} LowerRewrite;
+
+typedef struct {
+    //the enabled LowerRewrites
+    uint8_t rewrites;
+    //functions moved out by LOWER_CLOSURES, most recently created first
+    List* funcs;
+    //used to name the functions moved out by LOWER_CLOSURES
+    uint32_t funcId;
+    //used to name the labels created by LOWER_JUMPS
+    uint32_t labelId;
+} LowerData;
+
+Token* lowerVisitor(Token* token, LowerData* data);
+
 /**
  * Each of the following functions takes a token, and returns a list of tokens
  * that represent it using jumps.
@@ -34,8 +66,6 @@ const char* uniqueName(uint8_t* uniqueId) {
  * words, the generated names increase by one each time a new one appears.
  */
 
-Token* toJumpsVisitor(Token* token, uint8_t* uniqueId);
-
 /**
  * Converts an IfToken to a list of tokens using jump tokens.
  * For example, the code
@@ -65,7 +95,7 @@ Token* toJumpsVisitor(Token* token, uint8_t* uniqueId);
  * condition check (nextLabel) and the end of each block jumps to the label at
  * the end of the output (endLabel).
  */
-Token* toJumpsIf(IfToken* token, uint8_t* uniqueId) {
+Token* lowerIf(IfToken* token, LowerData* data) {
     List* stmts = NULL;
     //computed lazily to preserve the names of label and conditions
     const char* endLabel = NULL;
@@ -74,20 +104,20 @@ Token* toJumpsIf(IfToken* token, uint8_t* uniqueId) {
         IfBranch* branch = (IfBranch*) node->head;
 
         //jump to the next branch if the above condition is false
-        const char* nextLabel = uniqueName(uniqueId);
+        const char* nextLabel = uniqueName(&data->labelId);
         CondJumpToken* condJump = createCondJumpToken(
                 tokenLocation(branch->condition),
-                toJumpsVisitor(branch->condition, uniqueId),
+                lowerVisitor(branch->condition, data),
                 newStr(nextLabel), 0);
         stmts = consList(condJump, stmts);
 
         //if the condition is true, the block is executed
-        Token* stmt = toJumpsVisitor((Token*) branch->block, uniqueId);
+        Token* stmt = lowerVisitor((Token*) branch->block, data);
         stmts = consList(stmt, stmts);
 
         //jump to after the if statement
         if(endLabel == NULL) {
-            endLabel = uniqueName(uniqueId);
+            endLabel = uniqueName(&data->labelId);
         }
         stmts = consList(createAbsJumpToken(newStr(endLabel)), stmts);
 
@@ -99,12 +129,12 @@ Token* toJumpsIf(IfToken* token, uint8_t* uniqueId) {
 
     //output the else branch
     if(getIfTokenElseBranch(token) != NULL) {
-        Token* stmt = toJumpsVisitor((Token*) getIfTokenElseBranch(token), uniqueId);
+        Token* stmt = lowerVisitor((Token*) getIfTokenElseBranch(token), data);
         stmts = consList(stmt, stmts);
     }
 
     if(endLabel == NULL) {
-        endLabel = uniqueName(uniqueId);
+        endLabel = uniqueName(&data->labelId);
     }
 
     //create the label all if branches jump to after execution
@@ -132,23 +162,23 @@ Token* toJumpsIf(IfToken* token, uint8_t* uniqueId) {
  * $absJump $startLabel
  * label $endLabel
  */
-Token* toJumpsWhile(WhileToken* token, uint8_t* uniqueId) {
+Token* lowerWhile(WhileToken* token, LowerData* data) {
     List* stmts = NULL;
-    const char* startLabel = uniqueName(uniqueId);
+    const char* startLabel = uniqueName(&data->labelId);
 
     //beginning of the control structure; jumped to at the end of the loop
     stmts = consList(createLabelToken(newStr(startLabel)), stmts);
 
     //jump to the end if the condition is false
-    const char* endLabel = uniqueName(uniqueId);
+    const char* endLabel = uniqueName(&data->labelId);
     CondJumpToken* condJump = createCondJumpToken(
             tokenLocation(getWhileTokenCondition(token)),
-            toJumpsVisitor(getWhileTokenCondition(token), uniqueId),
+            lowerVisitor(getWhileTokenCondition(token), data),
             newStr(endLabel), 0);
     stmts = consList(condJump, stmts);
 
     //output the body
-    stmts = consList(toJumpsVisitor((Token*) getWhileTokenBody(token), uniqueId), stmts);
+    stmts = consList(lowerVisitor((Token*) getWhileTokenBody(token), data), stmts);
 
     //end of the loop
     stmts = consList(createAbsJumpToken(newStr(startLabel)), stmts);
@@ -163,167 +193,9 @@ Token* toJumpsWhile(WhileToken* token, uint8_t* uniqueId) {
 }
 
 /**
- * Converts a function token's contents from using control structures to using
- * jumps.
- */
-Token* toJumpsFunc(FuncToken* token, uint8_t* uniqueId) {
-    //copy the arguments since each token holds a unique reference
-    List* newArgs = NULL;
-    List* oldArgs = getFuncTokenArgs(token);
-    while(oldArgs != NULL) {
-        IdentifierToken* oldId = (IdentifierToken*) oldArgs->head;
-        SrcLoc location = tokenLocation((Token*) oldId);
-        const char* newName = newStr(getIdentifierTokenValue(oldId));
-        IdentifierToken* newId = createIdentifierToken(location, newName);
-        newArgs = consList((void*) newId, newArgs);
-        oldArgs = oldArgs->tail;
-    }
-
-    SrcLoc location = tokenLocation((Token*) token);
-    IdentifierToken* name = (IdentifierToken*)
-            copyToken((Token*) getFuncTokenName(token),
-                    (CopyVisitor) toJumpsVisitor, uniqueId);
-
-    List* args = reverseList(newArgs);
-    BlockToken* body = (BlockToken*)
-            toJumpsVisitor((Token*) getFuncTokenBody(token), uniqueId);
-
-    FuncToken* ret = createFuncToken(location, name, args, body);
-
-    destroyShallowList(newArgs);
-    return (Token*) ret;
-}
-
-/**
- * Converts a list of tokens from using control structures to using jumps and
- * labels.
- *
- * The uniqueId is used to create a unique name for each generated label and
- * variable. It is modified each time a new name is created.
- */
-Token* toJumpsVisitor(Token* token, uint8_t* uniqueId) {
-    switch(getTokenType(token)) {
-    case TOKEN_INT:
-    case TOKEN_FLOAT:
-    case TOKEN_LITERAL:
-    case TOKEN_IDENTIFIER:
-    case TOKEN_TUPLE:
-    case TOKEN_LIST:
-    case TOKEN_OBJECT:
-        //this case shouldn't happen, but its here for future-proofing
-    case TOKEN_CALL:
-    case TOKEN_BINARY_OP:
-    case TOKEN_UNARY_OP:
-    case TOKEN_ASSIGNMENT:
-    case TOKEN_RETURN:
-    case TOKEN_BLOCK:
-    case TOKEN_LABEL:
-    case TOKEN_ABS_JUMP:
-    case TOKEN_COND_JUMP:
-    case TOKEN_PUSH_BUILTIN:
-    case TOKEN_PUSH_INT:
-    case TOKEN_OP_CALL:
-    case TOKEN_STORE:
-    case TOKEN_DUP:
-    case TOKEN_PUSH:
-    case TOKEN_ROT3:
-    case TOKEN_SWAP:
-    case TOKEN_POP:
-    case TOKEN_BUILTIN:
-    case TOKEN_CHECK_NONE:
-    case TOKEN_NEW_FUNC:
-        return copyToken(token, (CopyVisitor) toJumpsVisitor, uniqueId);
-    case TOKEN_IF:
-        return toJumpsIf((IfToken*) token, uniqueId);
-    case TOKEN_WHILE:
-        return toJumpsWhile((WhileToken*) token, uniqueId);
-    case TOKEN_FUNC:
-        return toJumpsFunc((FuncToken*) token, uniqueId);
-    }
-    return NULL;
-}
-
-/**
- * Converts the module from using control structures to using jumps and labels.
+ * Creates a cons list out of the given tokens, which become part of the list.
  */
-BlockToken* transformControlToJumps(BlockToken* module) {
-    uint8_t uniqueId = 0;
-    return (BlockToken*) toJumpsVisitor((Token*) module, &uniqueId);
-}
-
-Token* flattenBlocksVisitor(Token* token, void* data);
-
-List* flatList(BlockToken* token) {
-    List* list = getBlockTokenChildren(token);
-    List* flattened = NULL;
-
-    while(list != NULL) {
-        Token* stmt = (Token*) list->head;
-        if(getTokenType((Token*) stmt) == TOKEN_BLOCK) {
-            List* output = flatList((BlockToken*) stmt);
-            flattened = prependReverseList(output, flattened);
-            destroyShallowList(output);
-        } else {
-            flattened = consList(flattenBlocksVisitor(stmt, NULL), flattened);
-        }
-        list = list->tail;
-    }
-
-    List* ret = reverseList(flattened);
-    destroyShallowList(flattened);
-    return ret;
-}
-
-Token* flattenBlocksVisitor(Token* token, void* data) {
-    UNUSED(data);
-    switch(getTokenType(token)) {
-     case TOKEN_INT:
-     case TOKEN_FLOAT:
-     case TOKEN_LITERAL:
-     case TOKEN_IDENTIFIER:
-     case TOKEN_TUPLE:
-     case TOKEN_LIST:
-     case TOKEN_OBJECT:
-         //this case shouldn't happen, but its here for future-proofing
-     case TOKEN_CALL:
-     case TOKEN_BINARY_OP:
-     case TOKEN_UNARY_OP:
-     case TOKEN_ASSIGNMENT:
-     case TOKEN_RETURN:
-     case TOKEN_IF:
-     case TOKEN_WHILE:
-     case TOKEN_FUNC:
-     case TOKEN_LABEL:
-     case TOKEN_ABS_JUMP:
-     case TOKEN_COND_JUMP:
-         //shouldn't happen anyway
-     case TOKEN_PUSH_BUILTIN:
-     case TOKEN_PUSH_INT:
-     case TOKEN_OP_CALL:
-     case TOKEN_STORE:
-     case TOKEN_DUP:
-     case TOKEN_PUSH:
-     case TOKEN_ROT3:
-     case TOKEN_SWAP:
-     case TOKEN_POP:
-     case TOKEN_BUILTIN:
-     case TOKEN_CHECK_NONE:
-     case TOKEN_NEW_FUNC:
-         return copyToken(token, (CopyVisitor) flattenBlocksVisitor, NULL);
-     case TOKEN_BLOCK:
-         return (Token*) createBlockToken(tokenLocation(token),
-                 flatList((BlockToken*) token));
-     }
-     return NULL;
-}
-
-BlockToken* transformFlattenBlocks(BlockToken* module) {
-    return (BlockToken*) flattenBlocksVisitor((Token*) module, NULL);
-}
-
-Token* listToConsVisitor(Token* token, void* data);
-
-Token* listToConsListHelper(List* elements) {
+Token* consTokens(List* elements) {
     if(elements == NULL) {
         //TODO create a token that always resolves to none, instead of referring
         //to the global scope
@@ -333,64 +205,26 @@ Token* listToConsListHelper(List* elements) {
         return (Token*) createBuiltinToken(location, newStr("none"));
     } else {
         const char* op = newStr("::");
-        Token* left = listToConsVisitor((Token*) elements->head, NULL);
-        Token* right = listToConsListHelper(elements->tail);
+        Token* left = (Token*) elements->head;
+        Token* right = consTokens(elements->tail);
         return (Token*) createBinaryOpToken(tokenLocation(left), op, left, right);
     }
 }
 
-Token* listToConsList(Token* token) {
+Token* lowerList(Token* token, LowerData* data) {
     ListToken* list = (ListToken*) token;
-    return listToConsListHelper(getListTokenElements(list));
-}
-
-Token* listToConsVisitor(Token* token, void* data) {
-    UNUSED(data);
-    switch(getTokenType(token)) {
-    case TOKEN_INT:
-    case TOKEN_FLOAT:
-    case TOKEN_LITERAL:
-    case TOKEN_IDENTIFIER:
-    case TOKEN_TUPLE:
-    case TOKEN_OBJECT: //this case shouldn't happen
-    case TOKEN_CALL:
-    case TOKEN_BINARY_OP:
-    case TOKEN_UNARY_OP:
-    case TOKEN_ASSIGNMENT:
-    case TOKEN_BLOCK:
-    case TOKEN_IF:
-    case TOKEN_WHILE:
-    case TOKEN_FUNC:
-    case TOKEN_RETURN:
-    case TOKEN_LABEL:
-    case TOKEN_ABS_JUMP:
-    case TOKEN_COND_JUMP:
-    case TOKEN_PUSH_BUILTIN:
-    case TOKEN_PUSH_INT:
-    case TOKEN_OP_CALL:
-    case TOKEN_STORE:
-    case TOKEN_DUP:
-    case TOKEN_PUSH:
-    case TOKEN_ROT3:
-    case TOKEN_SWAP:
-    case TOKEN_POP:
-    case TOKEN_BUILTIN:
-    case TOKEN_CHECK_NONE:
-    case TOKEN_NEW_FUNC:
-        return copyToken(token, listToConsVisitor, NULL);
-    case TOKEN_LIST:
-        return listToConsList(token);
-    }
-    return NULL;
-}
-
-BlockToken* transformListToCons(BlockToken* token) {
-    return (BlockToken*) listToConsVisitor((Token*) token, NULL);
+    List* elements = copyTokenList(getListTokenElements(list),
+            (CopyVisitor) lowerVisitor, data);
+    Token* ret = consTokens(elements);
+    destroyShallowList(elements);
+    return ret;
 }
 
-Token* objectDesugarVisitor(Token* token, void* data);
-
-Token* objectDesugarObject(Token* token) {
+/**
+ * Converts an object literal into a call to the 'object' builtin with a list
+ * of key, value tuples.
+ */
+Token* lowerObject(Token* token, LowerData* data) {
     ObjectToken* object = (ObjectToken*) token;
     List* tuples = NULL;
     List* elements = getObjectTokenElements(object);
@@ -398,66 +232,50 @@ Token* objectDesugarObject(Token* token) {
 
     while(elements != NULL) {
         ObjectPair* pair = (ObjectPair*) elements->head;
-        Token* key = objectDesugarVisitor(pair->key, NULL);
-        Token* value = objectDesugarVisitor(pair->value, NULL);
+        Token* key = lowerVisitor(pair->key, data);
+        Token* value = lowerVisitor(pair->value, data);
         List* tupleElems = consList(key, consList(value, NULL));
         Token* tuple = (Token*) createTupleToken(loc, tupleElems);
         tuples = consList(tuple, tuples);
         elements = elements->tail;
     }
 
-    ListToken* list = createListToken(loc, reverseList(tuples));
+    List* ordered = reverseList(tuples);
     destroyShallowList(tuples);
-    return (Token*) createUnaryOpToken(loc, newStr("object"), (Token*) list);
+    Token* list;
+    if(data->rewrites & LOWER_LIST_TO_CONS) {
+        list = consTokens(ordered);
+        destroyShallowList(ordered);
+    } else {
+        list = (Token*) createListToken(loc, ordered);
+    }
+    return (Token*) createUnaryOpToken(loc, newStr("object"), list);
 }
 
-Token* objectDesugarVisitor(Token* token, void* data) {
+Token* copyVisitor(Token* token, void* data) {
     UNUSED(data);
-    switch(getTokenType(token)) {
-    case TOKEN_INT:
-    case TOKEN_FLOAT:
-    case TOKEN_LITERAL:
-    case TOKEN_IDENTIFIER:
-    case TOKEN_TUPLE:
-    case TOKEN_LIST:
-    case TOKEN_CALL:
-    case TOKEN_BINARY_OP:
-    case TOKEN_UNARY_OP:
-    case TOKEN_ASSIGNMENT:
-    case TOKEN_BLOCK:
-    case TOKEN_IF:
-    case TOKEN_WHILE:
-    case TOKEN_FUNC:
-    case TOKEN_RETURN:
-    case TOKEN_LABEL:
-    case TOKEN_ABS_JUMP:
-    case TOKEN_COND_JUMP:
-    case TOKEN_PUSH_BUILTIN:
-    case TOKEN_PUSH_INT:
-    case TOKEN_OP_CALL:
-    case TOKEN_STORE:
-    case TOKEN_DUP:
-    case TOKEN_PUSH:
-    case TOKEN_ROT3:
-    case TOKEN_SWAP:
-    case TOKEN_POP:
-    case TOKEN_BUILTIN:
-    case TOKEN_CHECK_NONE:
-    case TOKEN_NEW_FUNC:
-        return copyToken(token, objectDesugarVisitor, NULL);
-    case TOKEN_OBJECT:
-        return objectDesugarObject(token);
-    }
-    return NULL; //shouldn't happen
+    return copyToken(token, copyVisitor, NULL);
 }
 
-Token* transformObjectDesugar(Token* module) {
-    return objectDesugarVisitor(module, NULL);
+/**
+ * Converts a list pattern into the equivalent cons pattern, since both
+ * destructure the same way.
+ */
+Token* listPatternToCons(List* elements) {
+    if(elements == NULL) {
+        SrcLoc location;
+        location.line = 0;
+        location.column = 0;
+        return (Token*) createBuiltinToken(location, newStr("none"));
+    } else {
+        Token* left = copyVisitor((Token*) elements->head, NULL);
+        Token* right = listPatternToCons(elements->tail);
+        return (Token*) createBinaryOpToken(tokenLocation(left), newStr("::"),
+                left, right);
+    }
 }
 
-Token* destructureVisitor(Token* token, void* data);
-
-Token* destructureLValue(Token* lvalue) {
+Token* destructureLValue(Token* lvalue, LowerData* data) {
     SrcLoc loc = tokenLocation(lvalue);
     if(getTokenType(lvalue)== TOKEN_IDENTIFIER) {
         IdentifierToken* identifier = (IdentifierToken*) lvalue;
@@ -483,13 +301,21 @@ Token* destructureLValue(Token* lvalue) {
             stmts = consList(createPushIntToken(loc, i), stmts);
             stmts = consList(createRot3Token(loc), stmts);
             stmts = consList(createCallOpToken(loc, 2), stmts);
-            stmts = consList(destructureLValue((Token*) elements->head), stmts);
+            stmts = consList(destructureLValue((Token*) elements->head, data),
+                    stmts);
             i++;
             elements = elements->tail;
         }
         Token* ret = (Token*) createBlockToken(loc, reverseList(stmts));
         destroyShallowList(stmts);
         return ret;
+    } else if(getTokenType(lvalue) == TOKEN_LIST &&
+            (data->rewrites & LOWER_LIST_TO_CONS)) {
+        Token* cons = listPatternToCons(getListTokenElements(
+                (ListToken*) lvalue));
+        Token* ret = destructureLValue(cons, data);
+        destroyToken(cons);
+        return ret;
     } else if(getTokenType(lvalue) == TOKEN_BINARY_OP) {
         BinaryOpToken* binOp = (BinaryOpToken*) lvalue;
         if(strcmp(getBinaryOpTokenOp(binOp), "::") != 0) {
@@ -508,13 +334,15 @@ Token* destructureLValue(Token* lvalue) {
         stmts = consList(createPushIntToken(loc, 0), stmts);
         stmts = consList(createRot3Token(loc), stmts);
         stmts = consList(createCallOpToken(loc, 2), stmts);
-        stmts = consList(destructureLValue(getBinaryOpTokenLeft(binOp)), stmts);
+        stmts = consList(destructureLValue(getBinaryOpTokenLeft(binOp), data),
+                stmts);
 
         stmts = consList(createPushBuiltinToken(loc, newStr("get")), stmts);
         stmts = consList(createPushIntToken(loc, 1), stmts);
         stmts = consList(createRot3Token(loc), stmts);
         stmts = consList(createCallOpToken(loc, 2), stmts);
-        stmts = consList(destructureLValue(getBinaryOpTokenRight(binOp)), stmts);
+        stmts = consList(destructureLValue(getBinaryOpTokenRight(binOp), data),
+                stmts);
 
         Token* ret = (Token*) createBlockToken(loc, reverseList(stmts));
         destroyShallowList(stmts);
@@ -532,12 +360,12 @@ Token* destructureLValue(Token* lvalue) {
                 stmts = consList(createDupToken(loc), stmts);
             }
 
-            Token* key = copyToken(pair->key, destructureVisitor, NULL);
+            Token* key = lowerVisitor(pair->key, data);
 
             stmts = consList(createPushToken(loc, key), stmts);
             stmts = consList(createSwapToken(loc), stmts);
             stmts = consList(createCallOpToken(loc, 1), stmts);
-            stmts = consList(destructureLValue(pair->value), stmts);
+            stmts = consList(destructureLValue(pair->value, data), stmts);
 
             pairs = pairs->tail;
         }
@@ -553,8 +381,8 @@ Token* destructureLValue(Token* lvalue) {
         stmts = consList(createDupToken(loc), stmts);
         stmts = consList(createPushBuiltinToken(loc, newStr("unpack_call")), stmts);
         stmts = consList(createSwapToken(loc), stmts);
-        Token* func = copyToken((Token*) getCallTokenChildren(call)->head,
-                destructureVisitor, NULL);
+        Token* func = lowerVisitor((Token*) getCallTokenChildren(call)->head,
+                data);
         stmts = consList(createPushToken(loc, func), stmts);
         stmts = consList(createSwapToken(loc), stmts);
         stmts = consList(createPushIntToken(loc, arity), stmts);
@@ -571,7 +399,8 @@ Token* destructureLValue(Token* lvalue) {
             stmts = consList(createSwapToken(loc), stmts);
             stmts = consList(createPushIntToken(loc, argNo), stmts);
             stmts = consList(createCallOpToken(loc, 2), stmts);
-            stmts = consList(destructureLValue((Token*) args->head), stmts);
+            stmts = consList(destructureLValue((Token*) args->head, data),
+                    stmts);
 
             args = args->tail;
             argNo++;
@@ -581,7 +410,7 @@ Token* destructureLValue(Token* lvalue) {
         destroyShallowList(stmts);
         return ret;
     } else if(getTokenType(lvalue) == TOKEN_INT || getTokenType(lvalue) == TOKEN_LITERAL) {
-        Token* copy = copyToken(lvalue, destructureVisitor, NULL);
+        Token* copy = lowerVisitor(lvalue, data);
         List* stmts = NULL;
 
         stmts = consList(createPushBuiltinToken(loc, newStr("assert_equal")),
@@ -600,39 +429,51 @@ Token* destructureLValue(Token* lvalue) {
     }
 }
 
-Token* destructureAssignment(Token* token) {
+Token* lowerAssignment(Token* token, LowerData* data) {
     AssignmentToken* assignment = (AssignmentToken*) token;
     List* stmts = NULL;
 
     Token* left = getAssignmentTokenLeft(assignment);
     Token* rightOld = getAssignmentTokenRight(assignment);
 
-    Token* right = copyToken(rightOld, destructureVisitor, NULL);
+    Token* right = lowerVisitor(rightOld, data);
     stmts = consList(createPushToken(tokenLocation(rightOld), right), stmts);
-    stmts = consList(destructureLValue(left), stmts);
+    stmts = consList(destructureLValue(left, data), stmts);
     Token* ret = (Token*) createBlockToken(tokenLocation(token), reverseList(stmts));
     destroyShallowList(stmts);
     return ret;
 }
 
-Token* destructureVisitor(Token* token, void* data) {
-    UNUSED(data);
+/**
+ * Moves the function out of the expression that creates it. The function is
+ * given a unique name and added to data->funcs; a NewFuncToken with that name
+ * takes its place.
+ */
+Token* lowerFunc(Token* token, LowerData* data) {
+    const char* name = uniqueName(&data->funcId);
+    FuncToken* func = (FuncToken*)
+            copyToken(token, (CopyVisitor) lowerVisitor, data);
+    destroyToken((Token*) getFuncTokenName(func));
+    NewFuncToken* newFunc = createNewFuncToken(tokenLocation(token),
+            newStr(name));
+    setFuncTokenName(func, createIdentifierToken(tokenLocation(token), name));
+    data->funcs = consList(func, data->funcs);
+
+    return (Token*) createPushToken(tokenLocation(token), (Token*) newFunc);
+}
+
+Token* lowerVisitor(Token* token, LowerData* data) {
     switch(getTokenType(token)) {
     case TOKEN_INT:
     case TOKEN_FLOAT:
     case TOKEN_LITERAL:
     case TOKEN_IDENTIFIER:
     case TOKEN_TUPLE:
-    case TOKEN_LIST:
-    case TOKEN_OBJECT:
     case TOKEN_CALL:
     case TOKEN_BINARY_OP:
     case TOKEN_UNARY_OP:
-    case TOKEN_BLOCK:
-    case TOKEN_IF:
-    case TOKEN_WHILE:
-    case TOKEN_FUNC:
     case TOKEN_RETURN:
+    case TOKEN_BLOCK:
     case TOKEN_LABEL:
     case TOKEN_ABS_JUMP:
     case TOKEN_COND_JUMP:
@@ -648,193 +489,457 @@ Token* destructureVisitor(Token* token, void* data) {
     case TOKEN_BUILTIN:
     case TOKEN_CHECK_NONE:
     case TOKEN_NEW_FUNC:
-        return copyToken(token, destructureVisitor, NULL);
+        break;
+    case TOKEN_LIST:
+        if(data->rewrites & LOWER_LIST_TO_CONS) {
+            return lowerList(token, data);
+        }
+        break;
+    case TOKEN_OBJECT:
+        if(data->rewrites & LOWER_OBJECTS) {
+            return lowerObject(token, data);
+        }
+        break;
     case TOKEN_ASSIGNMENT:
-        return destructureAssignment(token);
+        if(data->rewrites & LOWER_DESTRUCTURE) {
+            return lowerAssignment(token, data);
+        }
+        break;
+    case TOKEN_IF:
+        if(data->rewrites & LOWER_JUMPS) {
+            return lowerIf((IfToken*) token, data);
+        }
+        break;
+    case TOKEN_WHILE:
+        if(data->rewrites & LOWER_JUMPS) {
+            return lowerWhile((WhileToken*) token, data);
+        }
+        break;
+    case TOKEN_FUNC:
+        if(data->rewrites & LOWER_CLOSURES) {
+            return lowerFunc(token, data);
+        }
+        break;
     }
-    return NULL; //shouldn't happen
+    return copyToken(token, (CopyVisitor) lowerVisitor, data);
 }
 
-Token* transformDestructure(Token* module) {
-    return destructureVisitor(module, NULL);
+/**
+ * Applies the given rewrites to a copy of the token.
+ */
+Token* lowerToken(Token* token, uint8_t rewrites) {
+    LowerData data;
+    data.rewrites = rewrites;
+    data.funcs = NULL;
+    data.funcId = 0;
+    data.labelId = 0;
+    Token* ret = lowerVisitor(token, &data);
+    //only transformModule moves functions out
+    destroyShallowList(data.funcs);
+    return ret;
 }
 
-Token* copyVisitor(Token* token, void* data) {
-    UNUSED(data);
-    return copyToken(token, copyVisitor, NULL);
+/**
+ * Converts the module from using control structures to using jumps and labels.
+ */
+BlockToken* transformControlToJumps(BlockToken* module) {
+    return (BlockToken*) lowerToken((Token*) module, LOWER_JUMPS);
 }
 
-//this is a temporary transformation
-/*Token* transformFuncAssignToName(Token* module) {
-    BlockToken* block = (BlockToken*) module;
-    List* newStmts = NULL;
-    List* oldStmts = getBlockTokenChildren(block);
-
-    while(oldStmts != NULL) {
-        Token* stmt = (Token*) oldStmts->head;
-        Token* copy;
-        if(getTokenType(stmt) == TOKEN_ASSIGNMENT) {
-            AssignmentToken* assignment = (AssignmentToken*) stmt;
-            Token* left = getAssignmentTokenLeft(assignment);
-            Token* right = getAssignmentTokenRight(assignment);
-            if(getTokenType(left) == TOKEN_IDENTIFIER && getTokenType(right) == TOKEN_FUNC) {
-                FuncToken* func = (FuncToken*) copyVisitor(right, NULL);
-                destroyToken((Token*) getFuncTokenName(func));
-                func->name = (IdentifierToken*) copyVisitor(left, NULL);
-                copy = (Token*) func;
-            } else {
-                //this is a problem
-                copy = copyVisitor(stmt, NULL);
-            }
+BlockToken* transformListToCons(BlockToken* module) {
+    return (BlockToken*) lowerToken((Token*) module, LOWER_LIST_TO_CONS);
+}
+
+Token* transformObjectDesugar(Token* module) {
+    return lowerToken(module, LOWER_OBJECTS);
+}
+
+Token* transformDestructure(Token* module) {
+    return lowerToken(module, LOWER_DESTRUCTURE);
+}
+
+typedef struct CaptureInfo_ {
+    FuncToken* func;
+    //the function that creates this one, or NULL if $init does
+    struct CaptureInfo_* outer;
+    //the arguments and stored names of the function, created by localNames
+    Map* locals;
+    //names referenced and functions created in the body, in reverse order of
+    //appearance. Names may be repeated.
+    List* refs;
+    List* created;
+    //names of the variables captured from enclosing functions, in reverse
+    //order of their first appearance
+    List* captured;
+    uint8_t resolved;
+} CaptureInfo;
+
+/**
+ * While blocks are flattened, the names each function references and the
+ * functions it creates are recorded for transformCaptures.
+ */
+typedef struct {
+    //the function whose body is being flattened, or NULL outside of functions
+    CaptureInfo* info;
+    //maps the name of each function to its CaptureInfo
+    Map* infos;
+} FlattenData;
+
+Token* flattenBlocksVisitor(Token* token, FlattenData* data);
+
+List* flatList(BlockToken* token, FlattenData* data) {
+    List* list = getBlockTokenChildren(token);
+    List* flattened = NULL;
+
+    while(list != NULL) {
+        Token* stmt = (Token*) list->head;
+        if(getTokenType((Token*) stmt) == TOKEN_BLOCK) {
+            List* output = flatList((BlockToken*) stmt, data);
+            flattened = prependReverseList(output, flattened);
+            destroyShallowList(output);
         } else {
-            copy = copyVisitor(stmt, NULL);
+            flattened = consList(flattenBlocksVisitor(stmt, data), flattened);
         }
-        newStmts = consList(copy, newStmts);
-        oldStmts = oldStmts->tail;
+        list = list->tail;
     }
 
-    Token* ret = (Token*) createBlockToken(tokenLocation(module), reverseList(newStmts));
-    destroyShallowList(newStmts);
+    List* ret = reverseList(flattened);
+    destroyShallowList(flattened);
     return ret;
-}*/
+}
 
-typedef struct {
-    List* funcs;
-    uint8_t uniqueId;
-} ClosureData;
+Token* flattenFunc(FuncToken* token, FlattenData* data) {
+    CaptureInfo* outer = data->info;
+    CaptureInfo* info = NULL;
+    if(data->infos != NULL) {
+        info = (CaptureInfo*) malloc(sizeof(CaptureInfo));
+        info->func = NULL;
+        info->outer = NULL;
+        info->locals = NULL;
+        info->refs = NULL;
+        info->created = NULL;
+        info->captured = NULL;
+        info->resolved = 0;
+        data->info = info;
+    }
+    BlockToken* body = (BlockToken*) flattenBlocksVisitor(
+            (Token*) getFuncTokenBody(token), data);
+    data->info = outer;
+
+    IdentifierToken* name = (IdentifierToken*) copyVisitor(
+            (Token*) getFuncTokenName(token), NULL);
+    List* args = copyTokenList(getFuncTokenArgs(token), copyVisitor, NULL);
+    FuncToken* func = createFuncToken(tokenLocation((Token*) token), name,
+            args, body);
+    setFuncTokenCaptured(func, copyTokenList(getFuncTokenCaptured(token),
+            copyVisitor, NULL));
+
+    if(info != NULL) {
+        info->func = func;
+        putMapStr(data->infos, getIdentifierTokenValue(name), info);
+    }
+    return (Token*) func;
+}
+
+Token* flattenBlocksVisitor(Token* token, FlattenData* data) {
+    switch(getTokenType(token)) {
+     case TOKEN_INT:
+     case TOKEN_FLOAT:
+     case TOKEN_LITERAL:
+     case TOKEN_TUPLE:
+     case TOKEN_LIST:
+     case TOKEN_OBJECT:
+         //this case shouldn't happen, but its here for future-proofing
+     case TOKEN_CALL:
+     case TOKEN_BINARY_OP:
+     case TOKEN_UNARY_OP:
+     case TOKEN_ASSIGNMENT:
+     case TOKEN_RETURN:
+     case TOKEN_IF:
+     case TOKEN_WHILE:
+     case TOKEN_LABEL:
+     case TOKEN_ABS_JUMP:
+     case TOKEN_COND_JUMP:
+         //shouldn't happen anyway
+     case TOKEN_PUSH_BUILTIN:
+     case TOKEN_PUSH_INT:
+     case TOKEN_OP_CALL:
+     case TOKEN_STORE:
+     case TOKEN_DUP:
+     case TOKEN_PUSH:
+     case TOKEN_ROT3:
+     case TOKEN_SWAP:
+     case TOKEN_POP:
+     case TOKEN_BUILTIN:
+     case TOKEN_CHECK_NONE:
+         return copyToken(token, (CopyVisitor) flattenBlocksVisitor, data);
+     case TOKEN_IDENTIFIER:
+         if(data->info != NULL) {
+             data->info->refs = consList((void*) getIdentifierTokenValue(
+                     (IdentifierToken*) token), data->info->refs);
+         }
+         return copyToken(token, (CopyVisitor) flattenBlocksVisitor, data);
+     case TOKEN_NEW_FUNC:
+         if(data->info != NULL) {
+             data->info->created = consList((void*) getNewFuncTokenName(
+                     (NewFuncToken*) token), data->info->created);
+         }
+         return copyToken(token, (CopyVisitor) flattenBlocksVisitor, data);
+     case TOKEN_FUNC:
+         return flattenFunc((FuncToken*) token, data);
+     case TOKEN_BLOCK:
+         return (Token*) createBlockToken(tokenLocation(token),
+                 flatList((BlockToken*) token, data));
+     }
+     return NULL;
+}
 
-Token* closureVisitor(Token* token, ClosureData* data);
+BlockToken* transformFlattenBlocks(BlockToken* module) {
+    FlattenData data;
+    data.info = NULL;
+    data.infos = NULL;
+    return (BlockToken*) flattenBlocksVisitor((Token*) module, &data);
+}
 
-Token* closureCreateFunc(Token* token, ClosureData* data) {
-    UNUSED(closureVisitor);
-    const char* name = uniqueName(&data->uniqueId);
-    FuncToken* func = (FuncToken*)
-            copyToken(token, (CopyVisitor) closureVisitor, data);
-    destroyToken((Token*) getFuncTokenName(func));
-    setFuncTokenName(func, createIdentifierToken(tokenLocation(token), name));
-    data->funcs = consList(func, data->funcs);
+/**
+ * Returns the local variables of the function, which are its arguments and
+ * any stored name.
+ */
+Map* localNames(CaptureInfo* info) {
+    if(info->locals != NULL) {
+        return info->locals;
+    }
 
-    return (Token*) createPushToken(tokenLocation(token),
-            (Token*) createNewFuncToken(tokenLocation(token), newStr(name)));
+    info->locals = createMap();
+    for(List* arg = getFuncTokenArgs(info->func); arg != NULL; arg = arg->tail) {
+        putMapStr(info->locals, getIdentifierTokenValue(
+                (IdentifierToken*) arg->head), (void*) 1);
+    }
+    for(List* stmt = getBlockTokenChildren(getFuncTokenBody(info->func));
+            stmt != NULL; stmt = stmt->tail) {
+        Token* token = (Token*) stmt->head;
+        if(getTokenType(token) == TOKEN_STORE) {
+            putMapStr(info->locals, getStoreTokenName((StoreToken*) token),
+                    (void*) 1);
+        }
+    }
+    return info->locals;
 }
 
-Token* closureVisitor(Token* token, ClosureData* data) {
-    switch(getTokenType(token)) {
-        case TOKEN_INT:
-        case TOKEN_FLOAT:
-        case TOKEN_LITERAL:
-        case TOKEN_IDENTIFIER:
-        case TOKEN_TUPLE:
-        case TOKEN_LIST:
-        case TOKEN_OBJECT:
-        case TOKEN_CALL:
-        case TOKEN_BINARY_OP:
-        case TOKEN_UNARY_OP:
-        case TOKEN_BLOCK:
-        case TOKEN_ASSIGNMENT:
-        case TOKEN_IF:
-        case TOKEN_WHILE:
-        case TOKEN_RETURN:
-        case TOKEN_LABEL:
-        case TOKEN_ABS_JUMP:
-        case TOKEN_COND_JUMP:
-        case TOKEN_PUSH_BUILTIN:
-        case TOKEN_PUSH_INT:
-        case TOKEN_OP_CALL:
-        case TOKEN_STORE:
-        case TOKEN_DUP:
-        case TOKEN_PUSH:
-        case TOKEN_ROT3:
-        case TOKEN_SWAP:
-        case TOKEN_POP:
-        case TOKEN_BUILTIN:
-        case TOKEN_CHECK_NONE:
-        case TOKEN_NEW_FUNC:
-            return copyToken(token, (CopyVisitor) closureVisitor, data);
-        case TOKEN_FUNC:
-            return closureCreateFunc(token, data);
+/**
+ * Returns whether a function enclosing the given one, other than $init, has a
+ * local variable with the name.
+ */
+uint8_t isEnclosingLocal(CaptureInfo* info, const char* name) {
+    for(CaptureInfo* outer = info->outer; outer != NULL; outer = outer->outer) {
+        if(getMapStr(localNames(outer), name) != NULL) {
+            return 1;
         }
-        return NULL; //shouldn't happen
+    }
+    return 0;
 }
 
-Token* transformClosures(Token* module) {
-    ClosureData data;
-    data.funcs = NULL;
-    data.uniqueId = 0;
+/**
+ * Determines the variables a function captures. These are the names it
+ * references that are not its own local variables, along with the names
+ * captured by the functions it creates, since they must be passed through it.
+ *
+ * A stored name that is read before it is assigned refers to the variable of
+ * that name in the enclosing scopes, so stored names that are also local to
+ * an enclosing function are captured as well. Functions then never need the
+ * scopes of the functions that created them once their captured values are
+ * known.
+ */
+void resolveCaptures(Map* infos, CaptureInfo* info) {
+    if(info->resolved) {
+        return;
+    }
+    info->resolved = 1;
+
+    //names that are not captured. These are the local variables, other than
+    //those described above, and the names already captured.
+    Map* skip = createMap();
+    for(List* arg = getFuncTokenArgs(info->func); arg != NULL; arg = arg->tail) {
+        putMapStr(skip, getIdentifierTokenValue((IdentifierToken*) arg->head),
+                (void*) 1);
+    }
+    for(Entry* local = firstEntryMap(localNames(info)); local != NULL;
+            local = nextEntryMap(localNames(info), local)) {
+        if(!isEnclosingLocal(info, (const char*) local->key)) {
+            putMapStr(skip, (const char*) local->key, (void*) 1);
+        }
+    }
 
-    Token* outside = closureVisitor(module, &data);
-    Token* extracted = (Token*) createBlockToken(tokenLocation(module), data.funcs);
+    List* revRefs = reverseList(info->refs);
+    for(List* ref = revRefs; ref != NULL; ref = ref->tail) {
+        const char* name = (const char*) ref->head;
+        if(getMapStr(skip, name) == NULL) {
+            info->captured = consList((void*) name, info->captured);
+            putMapStr(skip, name, (void*) 1);
+        }
+    }
+    destroyShallowList(revRefs);
+
+    List* revCreated = reverseList(info->created);
+    for(List* created = revCreated; created != NULL; created = created->tail) {
+        CaptureInfo* inner = (CaptureInfo*) getMapStr(infos,
+                (const char*) created->head);
+        resolveCaptures(infos, inner);
+        List* revInner = reverseList(inner->captured);
+        for(List* ref = revInner; ref != NULL; ref = ref->tail) {
+            const char* name = (const char*) ref->head;
+            if(getMapStr(skip, name) == NULL) {
+                info->captured = consList((void*) name, info->captured);
+                putMapStr(skip, name, (void*) 1);
+            }
+        }
+        destroyShallowList(revInner);
+    }
+    destroyShallowList(revCreated);
 
-    return (Token*) createBlockToken(tokenLocation(module),
-            consList(outside, consList(extracted, NULL)));
+    destroyMap(skip, nothing, nothing);
 }
 
-Token* transformInitFunc(Token* module) {
-    BlockToken* block = (BlockToken*) module;
-    List* stmts = getBlockTokenChildren(block);
-    List* funcs = NULL;
-    List* other = NULL;
+void destroyCaptureInfo(void* info) {
+    if(((CaptureInfo*) info)->locals != NULL) {
+        destroyMap(((CaptureInfo*) info)->locals, nothing, nothing);
+    }
+    destroyShallowList(((CaptureInfo*) info)->refs);
+    destroyShallowList(((CaptureInfo*) info)->created);
+    destroyShallowList(((CaptureInfo*) info)->captured);
+    free(info);
+}
 
-    while(stmts != NULL) {
-        Token* stmt = copyToken((Token*) stmts->head, copyVisitor, NULL);
+/**
+ * Turns the output of lowerVisitor into the form compileModule expects: a
+ * block of functions, the first of which is $init. $init holds the
+ * statements that are outside of any function. Blocks are flattened and the
+ * variables each function captures from the functions that create it are
+ * recorded (see getFuncTokenCaptured). $init captures nothing; its variables
+ * are looked up by name.
+ */
+BlockToken* transformFunctions(BlockToken* module) {
+    FlattenData data;
+    data.info = NULL;
+    data.infos = createMap();
+    List* stmts = flatList(module, &data);
 
-        if(getTokenType(stmt) == TOKEN_FUNC) {
-            funcs = consList(stmt, funcs);
+    List* funcs = NULL;
+    List* other = NULL;
+    for(List* stmt = stmts; stmt != NULL; stmt = stmt->tail) {
+        Token* token = (Token*) stmt->head;
+        if(getTokenType(token) == TOKEN_FUNC) {
+            funcs = consList(token, funcs);
         } else {
-            other = consList(stmt, other);
+            other = consList(token, other);
         }
-
-        stmts = stmts->tail;
     }
+    destroyShallowList(stmts);
 
-    List* oldFuncs = funcs;
-    List* oldOther = other;
-
-    funcs = reverseList(funcs);
-    other = reverseList(other);
-
-    destroyShallowList(oldFuncs);
-    destroyShallowList(oldOther);
-
-    List* parts = NULL;
-    parts = consList(createBlockToken(tokenLocation(module), funcs), NULL);
+    //functions are already lifted out of the functions that create them
+    for(List* list = funcs; list != NULL; list = list->tail) {
+        FuncToken* func = (FuncToken*) list->head;
+        CaptureInfo* info = (CaptureInfo*) getMapStr(data.infos,
+                getIdentifierTokenValue(getFuncTokenName(func)));
+        for(List* created = info->created; created != NULL;
+                created = created->tail) {
+            ((CaptureInfo*) getMapStr(data.infos,
+                    (const char*) created->head))->outer = info;
+        }
+    }
 
-    IdentifierToken* name = createIdentifierToken(tokenLocation(module),
-            newStr("$init"));
-    BlockToken* body = createBlockToken(tokenLocation(module), other);
-    List* args = consList(createIdentifierToken(tokenLocation(module),
-            newStr("$arg")), NULL);
-    parts = consList(createFuncToken(tokenLocation(module), name, args, body), parts);
+    for(List* list = funcs; list != NULL; list = list->tail) {
+        FuncToken* func = (FuncToken*) list->head;
+        CaptureInfo* info = (CaptureInfo*) getMapStr(data.infos,
+                getIdentifierTokenValue(getFuncTokenName(func)));
+        resolveCaptures(data.infos, info);
 
-    return (Token*) createBlockToken(tokenLocation(module), parts);
+        List* captured = NULL;
+        for(List* ref = info->captured; ref != NULL; ref = ref->tail) {
+            captured = consList(createIdentifierToken(tokenLocation(
+                    (Token*) func), newStr((const char*) ref->head)), captured);
+        }
+        setFuncTokenCaptured(func, captured);
+    }
+    destroyMap(data.infos, nothing, destroyCaptureInfo);
+
+    SrcLoc loc = tokenLocation((Token*) module);
+    IdentifierToken* name = createIdentifierToken(loc, newStr("$init"));
+    BlockToken* body = createBlockToken(loc, reverseList(other));
+    List* args = consList(createIdentifierToken(loc, newStr("$arg")), NULL);
+    Token* init = (Token*) createFuncToken(loc, name, args, body);
+    destroyShallowList(other);
+
+    List* parts = consList(init, reverseList(funcs));
+    destroyShallowList(funcs);
+    return createBlockToken(loc, parts);
 }
 
-BlockToken* transformModule(BlockToken* module1) {
-    Token* moduleT = transformClosures((Token*) module1);
-
-    BlockToken* module2 = (BlockToken*) transformListToCons((BlockToken*) moduleT);
-    destroyToken(moduleT);
+/**
+ * Counts the tokens in the tree.
+ */
+Token* countTokensVisitor(Token* token, void* data) {
+    (*(uint32_t*) data)++;
+    return copyToken(token, countTokensVisitor, data);
+}
 
-    BlockToken* module3 = transformControlToJumps(module2);
-    destroyToken((Token*) module2);
+uint32_t countTokens(Token* token) {
+    uint32_t count = 0;
+    destroyToken(countTokensVisitor(token, &count));
+    return count;
+}
 
-    Token* module4 = transformDestructure((Token*) module3);
-    destroyToken((Token*) module3);
+double transformTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
 
-    Token* module5 = transformObjectDesugar((Token*) module4);
-    destroyToken(module4);
+//the allocations made from the token arena so far
+static uint64_t arenaAllocations() {
+    Arena* arena = getTokenArena();
+    return arena == NULL ? 0 : arena->allocations;
+}
 
-    BlockToken* module6 = (BlockToken*) transformListToCons((BlockToken*) module5);
-    destroyToken((Token*) module5);
+BlockToken* transformModuleStats(BlockToken* module,
+        TransformPassStats stats[TRANSFORM_PASSES]) {
+    double start = stats != NULL ? transformTime() : 0;
+    uint64_t startAllocations = arenaAllocations();
 
-    BlockToken* module7 = transformFlattenBlocks((BlockToken*) module6);
-    destroyToken((Token*) module6);
+    LowerData data;
+    data.rewrites = LOWER_ALL;
+    data.funcs = NULL;
+    data.funcId = 0;
+    data.labelId = 0;
+    Token* outside = lowerVisitor((Token*) module, &data);
+    SrcLoc loc = tokenLocation((Token*) module);
+    Token* extracted = (Token*) createBlockToken(loc, data.funcs);
+    BlockToken* lowered = createBlockToken(loc,
+            consList(outside, consList(extracted, NULL)));
 
-    Token* module8 = transformInitFunc((Token*) module7);
-    destroyToken((Token*) module7);
+    double lowerEnd = stats != NULL ? transformTime() : 0;
+    uint64_t lowerAllocations = arenaAllocations();
+
+    BlockToken* transformed = transformFunctions(lowered);
+
+    if(stats != NULL) {
+        double end = transformTime();
+        //counting the tokens copies them, so it comes after the measurements
+        uint64_t endAllocations = arenaAllocations();
+        stats[0].name = "lower";
+        stats[0].seconds = lowerEnd - start;
+        stats[0].allocations = lowerAllocations - startAllocations;
+        stats[0].tokens = countTokens((Token*) lowered);
+        stats[1].name = "functions";
+        stats[1].seconds = end - lowerEnd;
+        stats[1].allocations = endAllocations - lowerAllocations;
+        stats[1].tokens = countTokens((Token*) transformed);
+    }
 
-    Token* module9 = (Token*) transformFlattenBlocks((BlockToken*) module8);
-    destroyToken(module8);
+    destroyToken((Token*) lowered);
+    return transformed;
+}
 
-    return (BlockToken*) module9;
+BlockToken* transformModule(BlockToken* module) {
+    return transformModuleStats(module, NULL);
 }
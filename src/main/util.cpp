@@ -3,7 +3,6 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <stdio.h>
-#include <math.h>
 
 #include "main/util.h"
 
@@ -18,40 +17,12 @@ char* newStr(const char* src) {
 const char* formatStr(const char* format, ...) {
     va_list args;
     va_start(args, format);
-
-    size_t length = 1;
-
-    for(uint32_t i = 0; format[i] != 0; i++) {
-        char c = format[i];
-
-        if(c == '%') {
-            i++;
-            c = format[i];
-            if(c == 's') {
-                length += strlen(va_arg(args, char*));
-            } else if(c == 'i') {
-                int val = va_arg(args, int);
-                if(val == 0) {
-                    length += 1;
-                } else {
-                    length += ceil(log10(val));
-                }
-            } else {
-                length++;
-            }
-        } else if(c == '\\') {
-            i++;
-            length++;
-        } else {
-            length++;
-        }
-    }
-
+    size_t length = vsnprintf(NULL, 0, format, args) + 1;
     va_end(args);
 
     char* str = (char*) malloc(sizeof(char) * length);
     va_start(args, format);
-    vsprintf(str, format, args);
+    vsnprintf(str, length, format, args);
     va_end(args);
 
     return str;
@@ -163,103 +134,256 @@ List* reverseList(List* list) {
 
 Map* createMap() {
     Map* map = (Map*) malloc(sizeof(Map));
-    map->entry = NULL;
+    map->entries = NULL;
+    map->capacity = 0;
+    map->length = 0;
     return map;
 }
 
-Entry* copyEntry(Entry* original) {
-    if(original == NULL) {
-        return NULL;
+Map* copyMap(Map* original) {
+    Map* copy = (Map*) malloc(sizeof(Map));
+    copy->capacity = original->capacity;
+    copy->length = original->length;
+    if(original->capacity == 0) {
+        copy->entries = NULL;
+    } else {
+        size_t size = sizeof(Entry) * original->capacity;
+        copy->entries = (Entry*) malloc(size);
+        memcpy(copy->entries, original->entries, size);
     }
-    Entry* copy = (Entry*) malloc(sizeof(Entry));
-    copy->key = original->key;
-    copy->value = original->value;
-    copy->tail = copyEntry(original->tail);
     return copy;
 }
 
-Map* copyMap(Map* original) {
-    Map* copy = (Map*) malloc(sizeof(Map));
-    copy->entry = copyEntry(original->entry);
-    return copy;
+void destroyMap(Map* map, void(*destroyKey)(void*), void(*destroyValue)(void*)) {
+    for(uint32_t i = 0; i < map->capacity; i++) {
+        if(map->entries[i].hash != 0) {
+            destroyKey(map->entries[i].key);
+            destroyValue(map->entries[i].value);
+        }
+    }
+    free(map->entries);
+    free(map);
 }
 
-void destroyEntry(Entry* entry, void(*destroyKey)(void*), void(*destroyValue)(void*)) {
-    if(entry == NULL) {
-        return;
+Entry* firstEntryMap(Map* map) {
+    for(uint32_t i = 0; i < map->capacity; i++) {
+        if(map->entries[i].hash != 0) {
+            return &map->entries[i];
+        }
     }
-    destroyKey(entry->key);
-    destroyValue(entry->value);
-    destroyEntry(entry->tail, destroyKey, destroyValue);
-    free(entry);
+    return NULL;
 }
 
-void destroyMap(Map* map, void(*destroyKey)(void*), void(*destroyValue)(void*)) {
-    destroyEntry(map->entry, destroyKey, destroyValue);
-    free(map);
+Entry* nextEntryMap(Map* map, Entry* entry) {
+    Entry* end = map->entries + map->capacity;
+    for(entry++; entry < end; entry++) {
+        if(entry->hash != 0) {
+            return entry;
+        }
+    }
+    return NULL;
 }
 
 /**
- * Compares two boxed integer values
+ * FNV-1a. Zero marks unused entries, so it is never returned.
  */
-uint8_t intEq(const void* a, const void* b) {
-    return *((uint8_t*) a) == *((uint8_t*) b);
+uint32_t hashStr(const char* str) {
+    uint32_t hash = 2166136261u;
+    for(; *str != 0; str++) {
+        hash ^= (uint8_t) *str;
+        hash *= 16777619u;
+    }
+    return hash == 0 ? 1 : hash;
 }
 
 /**
- * Compares two string values
+ * The finalizer from MurmurHash3. Zero marks unused entries, so it is never
+ * returned.
  */
-uint8_t strEq(const void* a, const void* b) {
-    return strcmp((const char*) a, (const char*) b) == 0;
+uint32_t hashUint32(uint32_t num) {
+    num ^= num >> 16;
+    num *= 0x85ebca6b;
+    num ^= num >> 13;
+    num *= 0xc2b2ae35;
+    num ^= num >> 16;
+    return num == 0 ? 1 : num;
 }
 
 /**
- * Gets the entry object from the map with the given key or NULL if there is
- * no such entry.
+ * Returns the entry with the given key, or the unused entry where it would be
+ * inserted. The map must have a nonzero capacity.
  */
-Entry* getEntryMap(Map* map, const void* key, uint8_t(*equal)(const void*, const void*)) {
-    for(Entry* i = map->entry; i != NULL; i = i->tail) {
-        if(equal(i->key, key)) {
-            return i;
+Entry* findEntryStr(Map* map, const char* key, uint32_t hash) {
+    uint32_t mask = map->capacity - 1;
+    uint32_t i = hash & mask;
+    while(1) {
+        Entry* entry = &map->entries[i];
+        if(entry->hash == 0 || (entry->hash == hash &&
+                strcmp((const char*) entry->key, key) == 0)) {
+            return entry;
         }
+        i = (i + 1) & mask;
     }
-    return NULL;
 }
 
-void* postGetMap(Entry* entry) {
-    if(entry == NULL) {
+Entry* findEntryUint32(Map* map, uint32_t key, uint32_t hash) {
+    uint32_t mask = map->capacity - 1;
+    uint32_t i = hash & mask;
+    while(1) {
+        Entry* entry = &map->entries[i];
+        if(entry->hash == 0 || (entry->hash == hash && entry->num == key)) {
+            return entry;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+/**
+ * Makes sure there is room for one more entry, keeping the load factor under
+ * 3/4.
+ */
+void reserveMap(Map* map) {
+    if((map->length + 1) * 4 <= map->capacity * 3) {
+        return;
+    }
+
+    Entry* old = map->entries;
+    uint32_t oldCapacity = map->capacity;
+    map->capacity = oldCapacity == 0 ? 8 : oldCapacity * 2;
+    map->entries = (Entry*) calloc(map->capacity, sizeof(Entry));
+
+    //entries are moved by hash alone; keys are only compared on collisions,
+    //and there are no duplicate keys to collide with
+    uint32_t mask = map->capacity - 1;
+    for(uint32_t i = 0; i < oldCapacity; i++) {
+        if(old[i].hash != 0) {
+            uint32_t k = old[i].hash & mask;
+            while(map->entries[k].hash != 0) {
+                k = (k + 1) & mask;
+            }
+            map->entries[k] = old[i];
+        }
+    }
+    free(old);
+}
+
+void* getMapStrHashed(Map* map, const char* key, uint32_t hash) {
+    if(map->length == 0) {
         return NULL;
-    } else {
-        return entry->value;
     }
+    return findEntryStr(map, key, hash)->value;
 }
 
-void* getMapUint32(Map* map, uint32_t key) {
-    return postGetMap(getEntryMap(map, &key, intEq));
+void putMapStrHashed(Map* map, const char* key, uint32_t hash, void* value) {
+    reserveMap(map);
+    Entry* entry = findEntryStr(map, key, hash);
+    if(entry->hash == 0) {
+        entry->hash = hash;
+        entry->key = (void*) key;
+        map->length++;
+    }
+    entry->value = value;
 }
 
 void* getMapStr(Map* map, const char* key) {
-    return postGetMap(getEntryMap(map, key, strEq));
+    if(map->length == 0) {
+        return NULL;
+    }
+    return findEntryStr(map, key, hashStr(key))->value;
 }
 
-void postPutMap(Map* map, Entry* entry, void* key, void* value) {
-    if(entry == NULL) {
-        entry = (Entry*) malloc(sizeof(Entry));
-        entry->tail = map->entry;
-        entry->key = key;
-        entry->value = value;
-        map->entry = entry;
-    } else {
-        entry->value = value;
+void putMapStr(Map* map, const char* key, void* value) {
+    putMapStrHashed(map, key, hashStr(key), value);
+}
+
+void* getMapUint32(Map* map, uint32_t key) {
+    if(map->length == 0) {
+        return NULL;
     }
+    return findEntryUint32(map, key, hashUint32(key))->value;
 }
 
 void putMapUint32(Map* map, uint32_t key, void* value) {
-    postPutMap(map, getEntryMap(map, &key, intEq), boxUint32(key), value);
+    reserveMap(map);
+    uint32_t hash = hashUint32(key);
+    Entry* entry = findEntryUint32(map, key, hash);
+    if(entry->hash == 0) {
+        entry->hash = hash;
+        entry->num = key;
+        map->length++;
+    }
+    entry->value = value;
 }
 
-void putMapStr(Map* map, const char* key, void* value) {
-    postPutMap(map, getEntryMap(map, key, strEq), (void*) key, value);
+//the size of the first chunk of an arena. Each chunk after it is twice as big
+//as the one before, so there are few chunks to search in containsArena.
+#define ARENA_CHUNK_SIZE 4096
+
+//the memory of a chunk starts right after this header
+struct alignas(max_align_t) ArenaChunk_ {
+    ArenaChunk* next;
+    size_t size;
+    size_t used;
+};
+
+uint8_t* arenaChunkData(ArenaChunk* chunk) {
+    return (uint8_t*) (chunk + 1);
+}
+
+ArenaChunk* createArenaChunk(size_t size, ArenaChunk* next) {
+    ArenaChunk* chunk = (ArenaChunk*) malloc(sizeof(ArenaChunk) + size);
+    chunk->next = next;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+Arena* createArena() {
+    Arena* arena = (Arena*) malloc(sizeof(Arena));
+    arena->chunks = createArenaChunk(ARENA_CHUNK_SIZE, NULL);
+    arena->allocations = 0;
+    return arena;
+}
+
+void* allocArena(Arena* arena, size_t size) {
+    size_t align = alignof(max_align_t);
+    size = (size + align - 1) / align * align;
+
+    ArenaChunk* chunk = arena->chunks;
+    if(chunk->used + size > chunk->size) {
+        size_t chunkSize = chunk->size * 2;
+        while(chunkSize < size) {
+            chunkSize *= 2;
+        }
+        chunk = createArenaChunk(chunkSize, chunk);
+        arena->chunks = chunk;
+    }
+
+    void* ptr = arenaChunkData(chunk) + chunk->used;
+    chunk->used += size;
+    arena->allocations++;
+    return ptr;
+}
+
+uint8_t containsArena(Arena* arena, const void* ptr) {
+    for(ArenaChunk* chunk = arena->chunks; chunk != NULL; chunk = chunk->next) {
+        const uint8_t* start = arenaChunkData(chunk);
+        if((const uint8_t*) ptr >= start &&
+                (const uint8_t*) ptr < start + chunk->used) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void destroyArena(Arena* arena) {
+    ArenaChunk* chunk = arena->chunks;
+    while(chunk != NULL) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
 }
 
 uint32_t* boxUint32(uint32_t primitive) {
@@ -8,6 +8,9 @@
 #include "main/transform.h"
 #include "main/bytecode.h"
 #include "main/codegen.h"
+#include "main/cache.h"
+#include "main/peephole.h"
+#include "main/top.h"
 
 #include "test/tests.h"
 
@@ -84,10 +87,23 @@ void printModule(Module* module) {
             printf("PUSH_NONE");
         } else if(opcode == OP_CALL) {
             printf("CALL %i", readUInt(module, &i));
+        } else if(opcode == OP_TAIL_CALL) {
+            printf("TAIL_CALL %i", readUInt(module, &i));
         } else if(opcode == OP_RETURN) {
             printf("RETURN");
         } else if(opcode == OP_CREATE_FUNC) {
             printf("CREATE_FUNC %i", readInt(module, &i));
+            uint32_t capturedNum = readUInt(module, &i);
+            for(uint32_t k = 0; k < capturedNum; k++) {
+                uint8_t source = module->bytecode[i++];
+                uint32_t index = readUInt(module, &i);
+                if(source == CAPTURE_NAME) {
+                    printf(", %i (%s)", index, getConstant(module, index));
+                } else {
+                    printf(", %s %i", source == CAPTURE_LOCAL ? "local" :
+                            "captured", index);
+                }
+            }
         } else if(opcode == OP_LOAD) {
             printIndexArgOp("LOAD", module, &i);
         } else if(opcode == OP_STORE) {
@@ -98,18 +114,33 @@ void printModule(Module* module) {
             printf("OP_COND_JUMP_FALSE %i", readInt(module, &i));
         } else if(opcode == OP_ABS_JUMP) {
             printf("OP_ABS_JUMP %i", readInt(module, &i));
+        } else if(opcode == OP_LOAD_LOCAL) {
+            printf("LOAD_LOCAL %i", readUInt(module, &i));
+        } else if(opcode == OP_STORE_LOCAL) {
+            printf("STORE_LOCAL %i", readUInt(module, &i));
+        } else if(opcode == OP_LOAD_CAPTURED) {
+            printf("LOAD_CAPTURED %i", readUInt(module, &i));
+        } else if(opcode >= OP_ADD && opcode <= OP_GREATER_THAN_EQ) {
+            const char* names[OPERATOR_OPCODES] = {
+                "ADD", "SUB", "MUL", "DIV", "EQ", "NOT_EQ", "LESS_THAN",
+                "LESS_THAN_EQ", "GREATER_THAN", "GREATER_THAN_EQ"
+            };
+            printf("%s", names[opcode - OP_ADD]);
         } else if(opcode == OP_DEF_FUNC) {
             uint8_t argNum = module->bytecode[i++];
-            if(opcode == OP_DEF_FUNC) {
-                printf("DEF_FUNC %i: ", argNum);
-            } else {
-                printf("DEF_FUNC_INIT %i: ", argNum);
-            }
-            for(uint8_t k = 0; k < argNum; k++) {
+            uint32_t slotNum = readUInt(module, &i);
+            printf("DEF_FUNC %i %i: ", argNum, slotNum);
+            for(uint32_t k = 0; k < slotNum; k++) {
                 uint32_t arg = readUInt(module, &i);
                 const char* str = getConstant(module, arg);
                 printf("%i (%s), ", arg, str);
             }
+            uint32_t capturedNum = readUInt(module, &i);
+            printf("captures %i: ", capturedNum);
+            for(uint32_t k = 0; k < capturedNum; k++) {
+                uint32_t arg = readUInt(module, &i);
+                printf("%i (%s), ", arg, getConstant(module, arg));
+            }
         } else if(opcode == OP_DUP) {
             printf("DUP");
         } else if(opcode == OP_ROT3) {
@@ -166,7 +197,7 @@ const char* codegenTestSimple() {
 
     //global object
     uint32_t mainEntry = createLabel(builder);
-    emitCreateFunc(builder, mainEntry);
+    emitCreateFunc(builder, mainEntry, 0);
     emitStore(builder, "main");
     emitPushNone(builder);
     emitReturn(builder);
@@ -176,13 +207,10 @@ const char* codegenTestSimple() {
     const char* args[1] = {
             "x"
     };
-    emitDefFunc(builder, 1, args, 0);
-    emitPushBuiltin(builder, "+");
+    emitDefFunc(builder, 1, 1, args, 0, NULL, 0);
     emitPushInt(builder, 1);
     emitPushInt(builder, 2);
-    emitCall(builder, 2);
-    emitReturn(builder);
-    emitPushNone(builder);
+    emitOperator(builder, OP_ADD);
     emitReturn(builder);
 
     Module* expected = builderToModule(builder, initLabel);
@@ -209,7 +237,8 @@ const char* codegenTestJumps() {
     ModuleBuilder* builder = createModuleBuilder();
 
     uint32_t factorialEntry = createLabel(builder);
-    emitCreateFunc(builder, factorialEntry);
+    emitCreateFunc(builder, factorialEntry, 1);
+    emitCaptureName(builder, "factorial");
     emitStore(builder, "factorial");
     emitPushNone(builder);
     emitReturn(builder);
@@ -218,33 +247,28 @@ const char* codegenTestJumps() {
     const char* args[1] = {
             "n"
     };
-    emitDefFunc(builder, 1, args, 0);
-    emitPushBuiltin(builder, "==");
-    emitLoad(builder, "n");
+    const char* captured[1] = {
+            "factorial"
+    };
+    emitDefFunc(builder, 1, 1, args, 1, captured, 0);
+    emitLoadLocal(builder, 0);
     emitPushInt(builder, 0);
-    emitCall(builder, 2);
+    emitOperator(builder, OP_EQ);
     uint32_t elseLabel = createLabel(builder);
     emitCondJump(builder, elseLabel, 0);
 
     emitPushInt(builder, 0);
     emitReturn(builder);
-    uint32_t endLabel = createLabel(builder);
-    emitAbsJump(builder, endLabel);
 
+    //the jump to the end and the end itself can not be reached
     emitLabel(builder, elseLabel);
-    emitPushBuiltin(builder, "*");
-    emitLoad(builder, "n");
-    emitLoad(builder, "factorial");
-    emitPushBuiltin(builder, "-");
-    emitLoad(builder, "n");
+    emitLoadLocal(builder, 0);
+    emitLoadCaptured(builder, 0);
+    emitLoadLocal(builder, 0);
     emitPushInt(builder, 1);
-    emitCall(builder, 2);
+    emitOperator(builder, OP_SUB);
     emitCall(builder, 1);
-    emitCall(builder, 2);
-    emitReturn(builder);
-
-    emitLabel(builder, endLabel);
-    emitPushNone(builder);
+    emitOperator(builder, OP_MUL);
     emitReturn(builder);
 
     Module* expected = builderToModule(builder, 0);
@@ -274,7 +298,7 @@ const char* codegenTestLiteralUnaryOp() {
     emitLabel(builder, initLabel);
 
     uint32_t mainEntry = createLabel(builder);
-    emitCreateFunc(builder, mainEntry);
+    emitCreateFunc(builder, mainEntry, 0);
     emitStore(builder, "main");
     emitPushNone(builder);
     emitReturn(builder);
@@ -283,15 +307,12 @@ const char* codegenTestLiteralUnaryOp() {
     const char* args[1] = {
             "x"
     };
-    emitDefFunc(builder, 1, args, 0);
+    emitDefFunc(builder, 1, 1, args, 0, NULL, 0);
     emitPushBuiltin(builder, "not");
     emitPushLiteral(builder, "hello");
     emitCall(builder, 1);
     emitReturn(builder);
 
-    emitPushNone(builder);
-    emitReturn(builder);
-
     Module* expected = builderToModule(builder, initLabel);
     destroyModuleBuilder(builder);
 
@@ -302,3 +323,196 @@ const char* codegenTestLiteralUnaryOp() {
 
     return NULL;
 }
+
+const char* codegenTestTranslate() {
+    char* error = NULL;
+    BlockToken* ast = parseModule("f = def n do while n > 0 do n = n - 1.5; end return (n, 'done'); end;", &error);
+    assert(ast != NULL, "incorrect parse");
+    Token* transformed = (Token*) transformModule(ast);
+    destroyToken((Token*) ast);
+    Module* module = compileModule(transformed);
+    destroyToken(transformed);
+
+    //every instruction must decode to the operands in the bytecode
+    for(uint32_t i = 0; i < module->codeLength; i++) {
+        Instruction* instr = &module->code[i];
+        uint32_t offset = instr->offset;
+        uint32_t operand = offset + 1;
+        if(instr->opcode == OP_ABS_JUMP || instr->opcode == OP_COND_JUMP_FALSE) {
+            Instruction* target = &module->code[instr->arg.u];
+            assert(target->offset == readUInt(module, &operand),
+                    "wrong jump target");
+        } else if(instr->opcode == OP_PUSH_FLOAT) {
+            assert(instr->arg.f == readFloat(module, &operand),
+                    "wrong float operand");
+        } else if(instr->opcode == OP_PUSH_LITERAL) {
+            assert(strcmp(instr->arg.str, "done") == 0, "wrong literal");
+        }
+        assert(module->codeIndex[offset] == i, "wrong code index");
+    }
+    assert(module->code[module->codeLength].offset == module->bytecodeLength,
+            "missing end of code");
+
+    destroyModule(module);
+
+    return NULL;
+}
+
+/**
+ * Overwrites the byte at the given offset from the end of the cache file.
+ *
+ * @return whether the cache was changed
+ */
+uint8_t corruptCache(const char* file, long offset, uint8_t byte) {
+    FILE* cache = fopen(file, "r+b");
+    if(cache == NULL) {
+        return 0;
+    }
+    uint8_t written = fseek(cache, offset, SEEK_END) == 0 &&
+            fputc(byte, cache) != EOF;
+    return fclose(cache) == 0 && written;
+}
+
+const char* codegenTestCache() {
+    const char* path = "codegenTestCache.blg";
+    const char* src = "f = def n do return n * 2.5; end;";
+    char* error = NULL;
+    Module* compiled = sourceToModule(path, src, &error);
+    assert(compiled != NULL, "incorrect parse");
+
+    assert(loadModuleCache(path, src) == NULL, "loaded a missing cache");
+    assert(saveModuleCache(path, src, compiled), "the cache was not written");
+    Module* loaded = loadModuleCache(path, src);
+    assert(loaded != NULL, "the cache was not loaded");
+    assert(modulesEqual(compiled, loaded), "modules not equal");
+    assert(loaded->entryIndex == compiled->entryIndex, "wrong entry index");
+    assert(loaded->srcLocLength == compiled->srcLocLength, "wrong srcLoc");
+    for(uint32_t i = 0; i < loaded->constantsLength; i++) {
+        assert(loaded->constantHashes[i] == hashStr(loaded->constants[i]),
+                "wrong constant hash");
+    }
+    assert(loadModuleCache(path, "f = 1;") == NULL,
+            "loaded the cache of different source");
+
+    //damaged bytecode must not be loaded
+    char* file = cachePath(path);
+    uint32_t constantDataLength = 0;
+    for(uint32_t i = 0; i < compiled->constantsLength; i++) {
+        constantDataLength += strlen(compiled->constants[i]) + 1;
+    }
+    long bytecodeEnd = -(long) constantDataLength;
+    long bytecodeStart = bytecodeEnd - (long) compiled->bytecodeLength;
+    assert(corruptCache(file, bytecodeStart, 0xFF),
+            "the cache could not be changed");
+    assert(loadModuleCache(path, src) == NULL, "loaded an unknown opcode");
+    assert(saveModuleCache(path, src, compiled), "the cache was not written");
+    assert(corruptCache(file, bytecodeEnd - 1, OP_POP),
+            "the cache could not be changed");
+    assert(loadModuleCache(path, src) == NULL,
+            "loaded a function without a return");
+
+    remove(file);
+    free(file);
+    destroyModule(compiled);
+    destroyModule(loaded);
+
+    return NULL;
+}
+
+const char* codegenTestManyConstants() {
+    ModuleBuilder* builder = createModuleBuilder();
+    uint32_t initLabel = createLabel(builder);
+    emitLabel(builder, initLabel);
+
+    //more constants than fit in the builder's first arrays
+    const uint32_t count = 3000;
+    for(uint32_t i = 0; i < count; i++) {
+        const char* name = formatStr("name%u", i);
+        emitLoad(builder, name);
+        free((char*) name);
+    }
+    emitLoad(builder, "name0");
+    emitLoad(builder, "name2500");
+    emitReturn(builder);
+
+    Module* module = builderToModule(builder, initLabel);
+    destroyModuleBuilder(builder);
+
+    assert(module->constantsLength == count, "constants were duplicated");
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t index = i * 5 + 1;
+        assert(readUInt(module, &index) == i, "wrong constant index");
+    }
+    uint32_t index = count * 5 + 1;
+    assert(readUInt(module, &index) == 0, "wrong constant index");
+    index++;
+    assert(readUInt(module, &index) == 2500, "wrong constant index");
+    assert(strcmp(module->constants[2500], "name2500") == 0,
+            "wrong constant");
+
+    destroyModule(module);
+    return NULL;
+}
+
+const char* codegenTestPeephole() {
+    ModuleBuilder* builder = createModuleBuilder();
+    uint32_t entry = createLabel(builder);
+    uint32_t first = createLabel(builder);
+    uint32_t second = createLabel(builder);
+    emitLabel(builder, entry);
+
+    SrcLoc location = {1, 1};
+    emitSrcLoc(builder, location);
+    emitDup(builder);
+    location.line = 2;
+    emitSrcLoc(builder, location);
+    emitPop(builder);
+    location.line = 3;
+    emitSrcLoc(builder, location);
+    emitPushInt(builder, 1);
+    emitSwap(builder);
+    emitSwap(builder);
+    emitCondJump(builder, first, 0);
+    emitLoad(builder, "f");
+    emitCall(builder, 0);
+    emitAbsJump(builder, second);
+    emitPushInt(builder, 3);
+    emitLabel(builder, first);
+    emitAbsJump(builder, second);
+    emitLabel(builder, second);
+    emitReturn(builder);
+    emitPushNone(builder);
+    emitReturn(builder);
+
+    optimizeBuilder(builder, entry);
+    Module* optimized = builderToModule(builder, entry);
+    destroyModuleBuilder(builder);
+
+    //the conditional jump skips the chain of jumps, the jump to the return
+    //becomes a return and the call before it a tail call
+    builder = createModuleBuilder();
+    entry = createLabel(builder);
+    second = createLabel(builder);
+    emitLabel(builder, entry);
+    emitPushInt(builder, 1);
+    emitCondJump(builder, second, 0);
+    emitLoad(builder, "f");
+    emitCall(builder, 0);
+    emitReturn(builder);
+    emitLabel(builder, second);
+    emitReturn(builder);
+    Module* expected = builderToModule(builder, entry);
+    destroyModuleBuilder(builder);
+
+    assert(modulesEqual(optimized, expected), "modules not equal");
+    assert(optimized->entryIndex == 0, "wrong entry index");
+    //the locations of the removed instructions are replaced by the location
+    //of the instruction after them
+    assert(optimized->srcLocLength == 1, "wrong number of locations");
+    assert(optimized->srcLoc[0].index == 0, "wrong location index");
+    assert(optimized->srcLoc[0].location.line == 3, "wrong location");
+
+    destroyModule(optimized);
+    destroyModule(expected);
+    return NULL;
+}
@@ -1,6 +1,8 @@
 #include <main/thing.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
+#include <signal.h>
 
 #include "main/parse.h"
 #include "main/validate.h"
@@ -9,6 +11,11 @@
 #include "main/codegen.h"
 #include "main/execute.h"
 #include "main/top.h"
+#include "main/profile.h"
+#include "main/stats.h"
+#include "main/allocs.h"
+#include "main/phases.h"
+#include "main/thing/tuple.h"
 
 #include "test/tests.h"
 
@@ -76,6 +83,7 @@ const char* executeTestMainFuncReturns1() {
     in.arity = 1;
     in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
     in.args[0] = in.runtime->noneThing;
+    in.filename = NULL;
 
     ExecFuncOut out = execFunc(in);
     assert(out.errorMsg == NULL, out.errorMsg);
@@ -506,6 +514,7 @@ const char* executeTestRecFunc() {
     in.arity = 1;
     in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
     in.args[0] = createIntThing(in.runtime, 5);
+    in.filename = NULL;
 
     ExecFuncOut out = execFunc(in);
     assert(out.errorMsg == NULL, out.errorMsg);
@@ -514,3 +523,587 @@ const char* executeTestRecFunc() {
     cleanupExecFunc(in, out);
     return NULL;
 }
+
+const char* executeTestGarbageCollection() {
+    initThing();
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    in.src = "sum = def x do\n"
+            "    keep = none;\n"
+            "    i = 0;\n"
+            "    while i < x do\n"
+            "        keep = i :: keep;\n"
+            "        garbage = (i, 'garbage');\n"
+            "        i = i + 1;\n"
+            "    end\n"
+            "    total = 0;\n"
+            "    while i > 0 do\n"
+            "        total = total + head keep;\n"
+            "        keep = tail keep;\n"
+            "        i = i - 1;\n"
+            "    end\n"
+            "    return total;\n"
+            "end;";
+    in.name = "sum";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = createIntThing(in.runtime, 20000);
+    in.filename = NULL;
+
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg == NULL, out.errorMsg);
+    assert(checkInt(out.retVal, 199990000), "return value is not 199990000");
+    //over 200000 things are allocated, but only the kept list is live at once
+    uint32_t allocated = lengthList(in.runtime->allocatedThings);
+    assert(allocated < 100000, "unreachable things were not collected");
+
+    cleanupExecFunc(in, out);
+    return NULL;
+}
+
+const char* executeTestStackOverflow() {
+    initThing();
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    setStackFrameLimit(in.runtime, 100);
+    //the addition keeps the recursive call from being a tail call
+    in.src = "forever = def x do return 1 + forever x; end;";
+    in.name = "forever";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = in.runtime->noneThing;
+    in.filename = NULL;
+
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg != NULL, "no error was raised");
+    assert(strstr(out.errorMsg, "error: stack overflow") != NULL,
+            "the error is not a stack overflow");
+
+    cleanupExecFunc(in, out);
+    return NULL;
+}
+
+const char* executeTestImmediateThings() {
+    initThing();
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    in.src = "sum = def x do\n"
+            "    total = 0;\n"
+            "    fraction = 0.0;\n"
+            "    i = 0;\n"
+            "    while i < x do\n"
+            "        total = total + i;\n"
+            "        fraction = fraction + 0.5;\n"
+            "        i = i + 1;\n"
+            "    end\n"
+            "    if fraction == 5000.0 then\n"
+            "        return total;\n"
+            "    end\n"
+            "    return 0 - 1;\n"
+            "end;";
+    in.name = "sum";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = createIntThing(in.runtime, 10000);
+    in.filename = NULL;
+    //nothing may be collected, or allocations would go unnoticed
+    in.runtime->collectThreshold = UINT32_MAX;
+
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg == NULL, out.errorMsg);
+    assert(checkInt(out.retVal, 49995000), "return value is not 49995000");
+
+    Thing* negative = createIntThing(in.runtime, -7);
+    assert(typeOfThing(negative) == TYPE_INT, "int has the wrong type");
+    assert(thingAsInt(negative) == -7, "int has the wrong value");
+    Thing* half = createFloatThing(in.runtime, -0.5);
+    assert(typeOfThing(half) == TYPE_FLOAT, "float has the wrong type");
+    assert(thingAsFloat(half) == -0.5, "float has the wrong value");
+    assert(typeOfThing(createBoolThing(in.runtime, 2)) == TYPE_BOOL,
+            "bool has the wrong type");
+    assert(createBoolThing(in.runtime, 2) == createBoolThing(in.runtime, 1),
+            "bools are not normalized");
+    assert(typeOfThing(in.runtime->noneThing) == TYPE_NONE,
+            "none has the wrong type");
+
+    //the loop above would have allocated over 30000 things if ints, floats
+    //and bools were allocated
+    uint32_t allocated = lengthList(in.runtime->allocatedThings);
+    assert(allocated < 1000, "immediate things were allocated");
+
+    cleanupExecFunc(in, out);
+    return NULL;
+}
+
+const char* executeTestLiteralThings() {
+    initThing();
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    in.src = "main = def x do\n"
+            "    i = 0;\n"
+            "    while i < x do\n"
+            "        s = 'literal';\n"
+            "        i = i + 1;\n"
+            "    end\n"
+            "    return s;\n"
+            "end;";
+    in.name = "main";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = createIntThing(in.runtime, 10000);
+    in.filename = NULL;
+
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg == NULL, out.errorMsg);
+    assert(checkStr(out.retVal, "literal"), "return value is not 'literal'");
+
+    //every execution of the literal pushes the module's thing
+    Module* module = out.module;
+    uint8_t found = 0;
+    for(uint32_t i = 0; i < module->constantsLength; i++) {
+        found = found || module->literals[i] == getRetVal(out.retVal);
+    }
+    assert(found, "the literal is not the module's thing");
+    uint32_t allocated = lengthList(in.runtime->allocatedThings);
+    assert(allocated < 1000, "literals were allocated");
+
+    cleanupExecFunc(in, out);
+    return NULL;
+}
+
+const char* executeTestTailCall() {
+    initThing();
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    setStackFrameLimit(in.runtime, 100);
+    in.src = "sum = def x do\n"
+            "    return total (build x none) x 0;\n"
+            "end;\n"
+            "build = def n acc do\n"
+            "    if n == 0 then\n"
+            "        return acc;\n"
+            "    else\n"
+            "        return build (n - 1) (n :: acc);\n"
+            "    end\n"
+            "end;\n"
+            "total = def list n acc do\n"
+            "    if n == 0 then\n"
+            "        return acc;\n"
+            "    end\n"
+            "    return total (tail list) (n - 1) (acc + (head list));\n"
+            "end;";
+    in.name = "sum";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = createIntThing(in.runtime, 20000);
+    in.filename = NULL;
+
+    //without tail calls, this would need 20000 frames
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg == NULL, out.errorMsg);
+    assert(checkInt(out.retVal, 200010000), "return value is not 200010000");
+
+    cleanupExecFunc(in, out);
+    return NULL;
+}
+
+const char* executeTestCallCache() {
+    initThing();
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    in.src = "sum = def x do\n"
+            "    add = def a b do return a + b; end;\n"
+            "    total = 0;\n"
+            "    i = 0;\n"
+            "    while i < x do\n"
+            "        total = add total i;\n"
+            "        i = i + 1;\n"
+            "    end\n"
+            "    return total;\n"
+            "end;";
+    in.name = "sum";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = createIntThing(in.runtime, 100);
+    in.filename = NULL;
+
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg == NULL, out.errorMsg);
+    assert(checkInt(out.retVal, 4950), "return value is not 4950");
+
+    //the call in the loop always calls the same function
+    Module* module = out.module;
+    uint8_t found = 0;
+    for(uint32_t i = 0; i < module->callCachesLength; i++) {
+        CallCache* cache = &module->callCaches[i];
+        found = found || (cache->length == 1 &&
+                cache->entries[0].kind == CALL_CACHE_FUNC &&
+                cache->entries[0].arity == 2);
+    }
+    assert(found, "the call was not cached");
+
+    cleanupExecFunc(in, out);
+    return NULL;
+}
+
+const char* executeTestClosureScope() {
+    initThing();
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    in.src = "make = def x do\n"
+            "    value = x;\n"
+            "    count = def n do\n"
+            "        if n == 0 then\n"
+            "            return value;\n"
+            "        end\n"
+            "        return count (n - 1);\n"
+            "    end;\n"
+            "    count 3;\n"
+            "    return count;\n"
+            "end;";
+    in.name = "make";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = createIntThing(in.runtime, 5);
+    in.filename = NULL;
+
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg == NULL, out.errorMsg);
+    Thing* count = getRetVal(out.retVal);
+    assert(typeOfThing(count) == TYPE_FUNC, "make did not return a function");
+
+    //count was unassigned when the closure was created, so it was found by
+    //the recursive call. After that, the closure no longer needs make's scope.
+    Thing** captured = getFuncCaptured(count);
+    assert(captured[0] != NULL && captured[1] != NULL,
+            "the captured values were not kept");
+    assert(getFuncParentScope(count)->locals != NULL,
+            "the closure kept the scope it was created in");
+
+    cleanupExecFunc(in, out);
+    return NULL;
+}
+
+const char* executeTestObjectShapes() {
+    initThing();
+
+    Shape* empty = emptyShape();
+    Shape* a = addShapeSymbol(empty, 100);
+    Shape* ab = addShapeSymbol(a, 101);
+    assert(addShapeSymbol(empty, 100) == a, "the transition was not reused");
+    assert(addShapeSymbol(a, 101) == ab, "the transition was not reused");
+    assert(addShapeSymbol(empty, 101) != ab, "the order of symbols was lost");
+
+    uint32_t slot;
+    assert(findShapeSlot(ab, 100, &slot) && slot == 0, "wrong slot for 100");
+    assert(findShapeSlot(ab, 101, &slot) && slot == 1, "wrong slot for 101");
+    assert(!findShapeSlot(a, 101, &slot), "the parent has the child's symbol");
+    assert(ab->slotCount == 2 && ab->parent == a, "wrong shape");
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    in.src = "main = def x do\n"
+            "    width = createSymbol 1;\n"
+            "    height = createSymbol 1;\n"
+            "    first = { width: 1, height: 2 };\n"
+            "    second = { width: 3, height: 4, width: 5 };\n"
+            "    assert (width second == 5);\n"
+            "    return (first, second);\n"
+            "end;";
+    in.name = "main";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = in.runtime->noneThing;
+    in.filename = NULL;
+
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg == NULL, out.errorMsg);
+    Thing* first = getTupleElem(getRetVal(out.retVal), 0);
+    Thing* second = getTupleElem(getRetVal(out.retVal), 1);
+    assert(getObjectShape(first) == getObjectShape(second),
+            "the objects do not share a shape");
+    assert(getObjectShape(first)->slotCount == 2, "wrong number of slots");
+
+    cleanupExecFunc(in, out);
+    return NULL;
+}
+
+const char* executeTestSymbolHandlers() {
+    initThing();
+
+    assert(getSymbolHandler(TYPE_INT, SYM_ADD) != NULL, "ints do not add");
+    assert(getSymbolHandler(TYPE_INT, SYM_ADD) !=
+            getSymbolHandler(TYPE_FLOAT, SYM_ADD), "the types share a handler");
+    assert(getSymbolHandler(TYPE_INT, SYM_GET) == NULL, "ints respond to get");
+    assert(getSymbolHandler(TYPE_BOOL, SYM_AND) != NULL, "bools do not and");
+    assert(getSymbolHandler(TYPE_BOOL, SYM_ADD) == NULL, "bools add");
+    assert(getSymbolHandler(TYPE_TUPLE, SYM_RESPONDS_TO) ==
+            getSymbolHandler(TYPE_MODULE, SYM_RESPONDS_TO),
+            "responds_to is not shared");
+    assert(getSymbolHandler(TYPE_LIST, SYM_ADD) == NULL,
+            "lists have handlers");
+    assert(getSymbolHandler(TYPE_INT, newSymbolId()) == NULL,
+            "a new symbol has a handler");
+    assert(getSymbolHandler(TYPE_UNDEF, SYM_ADD) == NULL,
+            "an undefined type has a handler");
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    in.src = "main = def x do\n"
+            "    assert (responds_to true responds_to);\n"
+            "    assert (not responds_to 1 (createSymbol 1));\n"
+            "    return (1 + 2, 1.5 < 2.5, 'a' == 'a', true and false);\n"
+            "end;";
+    in.name = "main";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = in.runtime->noneThing;
+    in.filename = NULL;
+
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg == NULL, out.errorMsg);
+    Thing* tuple = getRetVal(out.retVal);
+    assert(thingAsInt(getTupleElem(tuple, 0)) == 3, "wrong sum");
+    assert(thingAsBool(getTupleElem(tuple, 1)), "wrong comparison");
+    assert(thingAsBool(getTupleElem(tuple, 2)), "wrong str comparison");
+    assert(!thingAsBool(getTupleElem(tuple, 3)), "wrong and");
+
+    cleanupExecFunc(in, out);
+    return NULL;
+}
+
+const char* executeTestProfile() {
+    initThing();
+    Runtime* runtime = createRuntime();
+    char* errorMsg;
+    Module* module = sourceToModule("profiled.blg",
+            "main = def x do return 1; end;", &errorMsg);
+    assert(module != NULL, "error in source code");
+
+    //a blerg frame that called native code
+    runtime->stackFrame[0].type = STACK_FRAME_DEF;
+    runtime->stackFrame[0].def.module = module;
+    runtime->stackFrame[0].def.index = 0;
+    runtime->stackFrame[0].def.scope = NULL;
+    runtime->stackFrame[1].type = STACK_FRAME_NATIVE;
+    runtime->stackFrame[1].native.pinnedLength = 0;
+    runtime->stackFrameLength = 2;
+
+    assert(startProfile(runtime), "the profiler did not start");
+    for(uint8_t i = 0; i < 3; i++) {
+        raise(SIGPROF);
+    }
+    stopProfile();
+    runtime->stackFrameLength = 0;
+
+    FILE* file = tmpfile();
+    assert(writeProfile(file) == 0, "samples were dropped");
+    rewind(file);
+    char line[256];
+    char* read = fgets(line, sizeof(line), file);
+    fclose(file);
+
+    assert(read != NULL, "nothing was written");
+    const char* prefix = "profiled.blg:";
+    assert(strncmp(line, prefix, strlen(prefix)) == 0, "wrong outer frame");
+    char* count = strstr(line, ";[native code] ");
+    assert(count != NULL, "wrong inner frame");
+    //the timer itself may have fired as well
+    assert(atoi(count + strlen(";[native code] ")) >= 3, "samples were lost");
+
+    destroyRuntime(runtime);
+    destroyModule(module);
+    deinitThing();
+    return NULL;
+}
+
+const char* executeTestProfileDeep() {
+    initThing();
+    Runtime* runtime = createRuntime();
+    char* errorMsg;
+    Module* module = sourceToModule("profiled.blg",
+            "main = def x do return 1; end;", &errorMsg);
+    assert(module != NULL, "error in source code");
+
+    //as deep as runaway recursion gets
+    const uint32_t depth = DEFAULT_STACK_FRAME_LIMIT;
+    for(uint32_t i = 0; i < depth; i++) {
+        runtime->stackFrame[i].type = STACK_FRAME_DEF;
+        runtime->stackFrame[i].def.module = module;
+        runtime->stackFrame[i].def.index = 0;
+        runtime->stackFrame[i].def.scope = NULL;
+    }
+    runtime->stackFrameLength = depth;
+
+    assert(startProfile(runtime), "the profiler did not start");
+    raise(SIGPROF);
+    stopProfile();
+    runtime->stackFrameLength = 0;
+
+    FILE* file = tmpfile();
+    assert(writeProfile(file) == 0, "samples were dropped");
+    rewind(file);
+    uint32_t separators = 0;
+    int c;
+    while((c = fgetc(file)) != EOF && c != '\n') {
+        separators += c == ';';
+    }
+    fclose(file);
+    assert(separators == depth - 1, "wrong number of frames");
+
+    destroyRuntime(runtime);
+    destroyModule(module);
+    deinitThing();
+    return NULL;
+}
+
+const char* executeTestStats() {
+    initThing();
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    in.runtime->stats = createExecStats();
+    in.src = "main = def x do\n"
+            "    return twice 1 + twice 2;\n"
+            "end;\n"
+            "twice = def y do\n"
+            "    return y * 2;\n"
+            "end;";
+    in.name = "main";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = in.runtime->noneThing;
+    in.filename = NULL;
+
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg == NULL, out.errorMsg);
+    assert(thingAsInt(getRetVal(out.retVal)) == 6, "wrong result");
+
+    ExecStats* stats = in.runtime->stats;
+    assert(stats->opcodes[OP_MUL] == 2, "wrong number of multiplications");
+    assert(stats->opcodes[OP_ADD] == 1, "wrong number of additions");
+    assert(stats->pairs[OP_PUSH_INT][OP_MUL] == 2, "wrong pair count");
+    assert(stats->callees[TYPE_FUNC] == 2, "wrong number of function calls");
+
+    //the module, main and twice
+    assert(stats->funcsLength == 3, "wrong number of functions");
+    uint64_t calls = 0;
+    for(uint32_t i = 0; i < stats->funcsCapacity; i++) {
+        if(stats->funcs[i].count > calls) {
+            calls = stats->funcs[i].count;
+        }
+    }
+    assert(calls == 2, "twice was not counted");
+
+    FILE* file = tmpfile();
+    printExecStats(stats, file);
+    assert(ftell(file) > 0, "nothing was printed");
+    fclose(file);
+
+    destroyExecStats(stats);
+    in.runtime->stats = NULL;
+    cleanupExecFunc(in, out);
+    return NULL;
+}
+
+const char* executeTestAllocStats() {
+    initThing();
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    in.runtime->allocStats = createAllocStats();
+    in.src = "main = def x do\n"
+            "    a = pair 1;\n"
+            "    b = pair 2;\n"
+            "    return 0;\n"
+            "end;\n"
+            "pair = def y do\n"
+            "    return (y, y);\n"
+            "end;";
+    in.name = "main";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = in.runtime->noneThing;
+    in.filename = NULL;
+
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg == NULL, out.errorMsg);
+
+    AllocStats* stats = in.runtime->allocStats;
+    assert(stats->counts[TYPE_TUPLE] == 2, "wrong number of tuples");
+    assert(stats->bytes[TYPE_TUPLE] == 2 * (sizeof(TupleThing) +
+            2 * sizeof(Thing*)), "wrong number of tuple bytes");
+    assert(stats->counts[TYPE_INT] == 0, "ints were counted");
+    //one scope for each call of main and pair
+    assert(stats->counts[ALLOC_SCOPE] >= 3, "scopes were not counted");
+
+    //both tuples are created by the same instruction
+    uint8_t found = 0;
+    for(uint32_t i = 0; i < stats->sitesCapacity; i++) {
+        AllocSite* site = &stats->sites[i];
+        if(site->count != 0 && site->type == TYPE_TUPLE) {
+            assert(site->module != NULL, "the tuple site has no module");
+            assert(site->count == 2, "wrong tuple site count");
+            found = 1;
+        }
+    }
+    assert(found, "the tuple site was not found");
+
+    FILE* file = tmpfile();
+    printAllocStats(in.runtime, file);
+    assert(ftell(file) > 0, "nothing was printed");
+    fclose(file);
+
+    destroyAllocStats(stats);
+    in.runtime->allocStats = NULL;
+    cleanupExecFunc(in, out);
+    return NULL;
+}
+
+const char* executeTestPhaseTimes() {
+    initThing();
+
+    ExecFuncIn in;
+    in.runtime = createRuntime();
+    in.src = "main = def x do\n"
+            "    return [1, 2];\n"
+            "end;";
+    in.name = "main";
+    in.arity = 1;
+    in.args = (Thing**) malloc(sizeof(Thing*) * in.arity);
+    in.args[0] = in.runtime->noneThing;
+    in.filename = NULL;
+
+    startPhaseTimes();
+    ExecFuncOut out = execFunc(in);
+    assert(out.errorMsg == NULL, out.errorMsg);
+    assert(timingPhases(), "phases are not being timed");
+
+    FILE* file = tmpfile();
+    printPhaseTimes(file);
+    assert(!timingPhases(), "phases are still being timed");
+    long length = ftell(file);
+    char* printed = (char*) malloc(length + 1);
+    rewind(file);
+    printed[fread(printed, 1, length, file)] = 0;
+    fclose(file);
+
+    const char* expected[] = {"parse", "validate", "transform lower",
+            "transform functions", "compile", "execute", "[total]"};
+    uint8_t found = 1;
+    for(uint32_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        found = found && strstr(printed, expected[i]) != NULL;
+    }
+    free(printed);
+    assert(found, "a phase was not printed");
+
+    cleanupExecFunc(in, out);
+    return NULL;
+}
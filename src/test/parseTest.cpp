@@ -327,3 +327,35 @@ const char* parseTestObject() {
     free(state);
     return NULL;
 }
+
+const char* parseTestArena() {
+    const char* src = "main = def x do\n"
+            "    a = { key: 'value', 1: [x, 2] };\n"
+            "    if x == 1 then return a; elif x then return 2; end\n"
+            "end;";
+
+    char* error = NULL;
+    Token* expected = (Token*) parseModule(src, &error);
+
+    Arena* arena = createArena();
+    setTokenArena(arena);
+    Token* parsed = (Token*) parseModule(src, &error);
+    setTokenArena(NULL);
+
+    assert(tokensEqual(parsed, expected), "incorrect parse");
+    assert(containsArena(arena, parsed), "token not in arena");
+
+    List* children = getBlockTokenChildren((BlockToken*) parsed);
+    AssignmentToken* assignment = (AssignmentToken*) children->head;
+    IdentifierToken* name = (IdentifierToken*) getAssignmentTokenLeft(
+            assignment);
+    assert(containsArena(arena, children), "list not in arena");
+    assert(containsArena(arena, getIdentifierTokenValue(name)),
+            "identifier not in arena");
+
+    //does nothing; the tokens are freed with the arena
+    destroyToken(parsed);
+    destroyArena(arena);
+    destroyToken(expected);
+    return NULL;
+}
@@ -7,6 +7,7 @@
 #include <iostream>
 
 #include "main/top.h"
+#include "test/utilTest.h"
 #include "test/parseTest.h"
 #include "test/validateTest.h"
 #include "test/transformTest.h"
@@ -31,6 +32,9 @@ uint8_t runTests(uint8_t argc, const char* args[]) {
     uint8_t status = 0;
     printf("running tests...\n");
 
+    runTest("utilTestMapStr", utilTestMapStr(), &status);
+    runTest("utilTestMapUint32", utilTestMapUint32(), &status);
+
     runTest("testParseInt", testParseInt(), &status);
     runTest("testParseLiteral", testParseLiteral(), &status);
     runTest("testParseIdentifier", testParseIdentifier(), &status);
@@ -47,6 +51,7 @@ uint8_t runTests(uint8_t argc, const char* args[]) {
     runTest("parseTestTuple", parseTestTuple(), &status);
     runTest("parseTestCons", parseTestCons(), &status);
     runTest("parseTestObject", parseTestObject(), &status);
+    runTest("parseTestArena", parseTestArena(), &status);
 
     runTest("validateTestOnlyFuncsToplevel", validateTestOnlyFuncsToplevel(), &status);
     runTest("validateTestNoInnerFuncs", validateTestNoInnerFuncs(), &status);
@@ -54,10 +59,15 @@ uint8_t runTests(uint8_t argc, const char* args[]) {
     runTest("transformTestControlToJumps", transformTestControlToJumps(), &status);
     runTest("transformationTestObjectDesugar", transformationTestObjectDesugar(), &status);
     runTest("transformationTestDestructureTuple", transformationTestDestructureTuple(), &status);
+    runTest("transformTestCaptures", transformTestCaptures(), &status);
 
     runTest("codegenTestSimple", codegenTestSimple(), &status);
     runTest("codegenTestJumps", codegenTestJumps(), &status);
     runTest("codegenTestLiteralUnaryOp", codegenTestLiteralUnaryOp(), &status);
+    runTest("codegenTestTranslate", codegenTestTranslate(), &status);
+    runTest("codegenTestCache", codegenTestCache(), &status);
+    runTest("codegenTestManyConstants", codegenTestManyConstants(), &status);
+    runTest("codegenTestPeephole", codegenTestPeephole(), &status);
 
     runTest("executeTestGlobalHasMainFunc", executeTestGlobalHasMainFunc(), &status);
     runTest("executeTestMainFuncReturns1", executeTestMainFuncReturns1(), &status);
@@ -81,12 +91,28 @@ uint8_t runTests(uint8_t argc, const char* args[]) {
     runTest("executeTestWhileLoop", executeTestWhileLoop(), &status);
     runTest("executeTestNativeFunc", executeTestNativeFunc(), &status);
     runTest("executeTestRecFunc", executeTestRecFunc(), &status);
+    runTest("executeTestGarbageCollection", executeTestGarbageCollection(), &status);
+    runTest("executeTestStackOverflow", executeTestStackOverflow(), &status);
+    runTest("executeTestImmediateThings", executeTestImmediateThings(), &status);
+    runTest("executeTestLiteralThings", executeTestLiteralThings(), &status);
+    runTest("executeTestTailCall", executeTestTailCall(), &status);
+    runTest("executeTestCallCache", executeTestCallCache(), &status);
+    runTest("executeTestClosureScope", executeTestClosureScope(), &status);
+    runTest("executeTestObjectShapes", executeTestObjectShapes(), &status);
+    runTest("executeTestSymbolHandlers", executeTestSymbolHandlers(), &status);
+    runTest("executeTestProfile", executeTestProfile(), &status);
+    runTest("executeTestProfileDeep", executeTestProfileDeep(), &status);
+    runTest("executeTestStats", executeTestStats(), &status);
+    runTest("executeTestAllocStats", executeTestAllocStats(), &status);
+    runTest("executeTestPhaseTimes", executeTestPhaseTimes(), &status);
 
     struct dirent* file;
     DIR* dir = opendir("blg_tests");
     if(dir != NULL) {
         while((file = readdir(dir)) != NULL) {
-            if(strcmp(file->d_name, "..") != 0 && strcmp(file->d_name, ".") != 0) {
+            size_t nameLen = strlen(file->d_name);
+            //skips the directory entries and the module caches
+            if(nameLen > 4 && strcmp(file->d_name + nameLen - 4, ".blg") == 0) {
                 size_t len = strlen("blg_tests/") + strlen(file->d_name) + 1;
                 char* filename = (char*) malloc(sizeof(char) * len);
                 strcpy(filename, "blg_tests/");
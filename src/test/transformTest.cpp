@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "main/parse.h"
 #include "main/tokens.h"
@@ -128,3 +129,60 @@ const char* transformationTestDestructureTuple() {
 
     return NULL;
 }
+
+/**
+ * Returns the names captured by the function with the given name in the
+ * transformed module.
+ */
+List* capturedByFunc(BlockToken* module, const char* name) {
+    for(List* list = getBlockTokenChildren(module); list != NULL;
+            list = list->tail) {
+        FuncToken* func = (FuncToken*) list->head;
+        if(strcmp(getIdentifierTokenValue(getFuncTokenName(func)), name) == 0) {
+            return getFuncTokenCaptured(func);
+        }
+    }
+    return NULL;
+}
+
+const char* transformTestCaptures() {
+    char* error = NULL;
+    BlockToken* parsed = parseModule("main = def x do a = 1; f = def y do return a + b; end; end;", &error);
+    assert(parsed != NULL, "incorrect parse");
+    BlockToken* transformed = transformModule(parsed);
+
+    //the inner function's captures must pass through main
+    List* expectedMain = consList(createIdentifierToken(newStr("b")), NULL);
+    List* expectedInner = consList(createIdentifierToken(newStr("a")),
+            consList(createIdentifierToken(newStr("b")), NULL));
+
+    assert(allList2(capturedByFunc(transformed, "$0"), expectedMain,
+            tokensEqualVoid), "wrong captures for main");
+    assert(allList2(capturedByFunc(transformed, "$1"), expectedInner,
+            tokensEqualVoid), "wrong captures for inner function");
+    assert(capturedByFunc(transformed, "$init") == NULL,
+            "$init should not capture");
+
+    destroyList(expectedMain, destroyTokenVoid);
+    destroyList(expectedInner, destroyTokenVoid);
+    destroyToken((Token*) parsed);
+    destroyToken((Token*) transformed);
+
+    //a is read before the inner function assigns it, so the inner function
+    //needs main's a. Its argument x never refers to main's x.
+    parsed = parseModule("main = def x do a = 1; f = def x do b = a; a = x; return b; end; end;", &error);
+    assert(parsed != NULL, "incorrect parse");
+    transformed = transformModule(parsed);
+
+    expectedInner = consList(createIdentifierToken(newStr("a")), NULL);
+    assert(capturedByFunc(transformed, "$0") == NULL,
+            "main should not capture");
+    assert(allList2(capturedByFunc(transformed, "$1"), expectedInner,
+            tokensEqualVoid), "shadowed variable was not captured");
+
+    destroyList(expectedInner, destroyTokenVoid);
+    destroyToken((Token*) parsed);
+    destroyToken((Token*) transformed);
+
+    return NULL;
+}
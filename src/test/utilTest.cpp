@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test/utilTest.h"
+#include "test/tests.h"
+
+#include "main/util.h"
+
+const char* utilTestMapStr() {
+    Map* map = createMap();
+    assert(getMapStr(map, "missing") == NULL, "empty map has a value");
+
+    //enough keys to make the map grow several times
+    for(uint32_t i = 0; i < 1000; i++) {
+        putMapStr(map, formatStr("key%i", i), boxUint32(i));
+    }
+    assert(map->length == 1000, "map does not have 1000 entries");
+
+    for(uint32_t i = 0; i < 1000; i++) {
+        const char* key = formatStr("key%i", i);
+        uint32_t* value = (uint32_t*) getMapStrHashed(map, key, hashStr(key));
+        free((char*) key);
+        assert(value != NULL && *value == i, "wrong value for key");
+    }
+    assert(getMapStr(map, "key1000") == NULL, "map has an extra key");
+
+    uint32_t count = 0;
+    for(Entry* i = firstEntryMap(map); i != NULL; i = nextEntryMap(map, i)) {
+        count++;
+    }
+    assert(count == 1000, "iteration did not visit every entry");
+
+    destroyMap(map, free, free);
+    return NULL;
+}
+
+const char* utilTestMapUint32() {
+    Map* map = createMap();
+
+    //keys that only differ in their higher bytes must not collide
+    putMapUint32(map, 1, boxUint32(1));
+    putMapUint32(map, 257, boxUint32(257));
+    putMapUint32(map, 65537, boxUint32(65537));
+    //overwriting a key does not free the old value
+    free(getMapUint32(map, 257));
+    putMapUint32(map, 257, boxUint32(258));
+
+    assert(map->length == 3, "map does not have 3 entries");
+    assert(*((uint32_t*) getMapUint32(map, 1)) == 1, "wrong value for 1");
+    assert(*((uint32_t*) getMapUint32(map, 257)) == 258, "wrong value for 257");
+    assert(*((uint32_t*) getMapUint32(map, 65537)) == 65537,
+            "wrong value for 65537");
+    assert(getMapUint32(map, 513) == NULL, "map has an extra key");
+
+    destroyMap(map, nothing, free);
+    return NULL;
+}
@@ -1,6 +1,18 @@
-import os, os.path, subprocess, sys, shutil
+import os, os.path, subprocess, sys, shutil, time, json, statistics
 
-USAGE = 'usage: python3 tools.py [build | buildDebug | clean | test | valgrind | help]'
+USAGE = 'usage: python3 tools.py [build | buildDebug | clean | test | valgrind | bench | help]'
+BENCH_USAGE = 'usage: python3 tools.py bench [runs] [save]'
+
+#the directories searched for source files. include/test holds the code for the
+#parenthesized ASTs the parser tests compare against.
+SOURCE_DIRS = ['src', 'include']
+
+BENCH_DIR = 'bench'
+BENCH_BASELINE = os.path.join(BENCH_DIR, 'baseline.json')
+#how much worse than the baseline a benchmark may be before it is reported.
+#Instruction counts are compared when perf is available since they are far less
+#noisy than wall time.
+BENCH_TOLERANCE = {'time': 0.15, 'instructions': 0.02}
 
 def get_mode(debugging):
     if debugging:
@@ -25,7 +37,7 @@ def debug_flag(debugging):
     if debugging:
         return '-g -O0'
     else:
-        return ''
+        return '-O2'
 
 def include_cmd(src, debugging=False):
     return 'g++ %s -I"include" -MM -c %s' %(debug_flag(debugging), src)
@@ -60,6 +72,9 @@ def obj_tuple(files, debugging):
         parts = file.split('.')
         parts = parts[:-1] #everything but the end, removes the extension
         end = os.path.relpath(''.join(parts), 'src')
+        #files outside of src keep their path from the root
+        if end.startswith(os.pardir):
+            end = os.path.normpath(''.join(parts))
         return os.path.join(build_folder(debugging), end) + '.o'
     return map(lambda x: (x, obj_file(x)), files)
 
@@ -121,11 +136,18 @@ def any_newer_than(a, b):
             return True
     return False
 
+def source_files():
+    """
+    A generator that yields the source files to compile
+    """
+    for dir in SOURCE_DIRS:
+        yield from with_extension(get_files(dir), '.cpp')
+
 def build(debugging=False):
     """
     builds the executable
     """
-    files = list(obj_tuple(with_extension(get_files('src'), '.cpp'), debugging))
+    files = list(obj_tuple(source_files(), debugging))
 
     failed = False
     for status, (src, obj) in changed_sources(files, debugging):
@@ -186,6 +208,166 @@ def valgrind():
                 program_args = '--test'
             subprocess.run(valgrind_cmd(program_args), shell=True)
 
+def run_once(cmd):
+    """
+    Runs the command and returns its wall time in seconds and its output
+    """
+    start = time.perf_counter()
+    result = subprocess.run(cmd, stdout=subprocess.PIPE,
+        stderr=subprocess.STDOUT)
+    elapsed = time.perf_counter() - start
+    output = result.stdout.decode('utf-8', 'replace')
+    #blerg reports uncaught errors without a nonzero exit code
+    if result.returncode != 0 or 'error:' in output:
+        raise RuntimeError('%s failed:\n%s' %(' '.join(cmd), output))
+    return elapsed, output
+
+def read_peak_rss(pid):
+    """
+    Returns the peak RSS in kilobytes of a running process, or None if it has
+    exited
+    """
+    try:
+        with open('/proc/%i/status' %pid) as f:
+            for line in f:
+                if line.startswith('VmHWM:'):
+                    return int(line.split()[1])
+    except (OSError, ValueError):
+        pass
+    return None
+
+def peak_rss(cmd):
+    """
+    Runs the command and returns its peak RSS in kilobytes. Returns None if it
+    cannot be measured.
+
+    The ru_maxrss of a child includes the memory it shared with this process
+    before exec, which is more than most benchmarks use, so /proc is polled
+    while the child runs instead. ru_maxrss still covers growth after the last
+    poll when it is above what the child inherited.
+    """
+    if not hasattr(os, 'wait4') or not os.path.exists('/proc/self/status'):
+        return None
+    import resource
+    inherited = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL,
+        stderr=subprocess.DEVNULL)
+    peak = None
+    while True:
+        pid, status, usage = os.wait4(proc.pid, os.WNOHANG)
+        if pid != 0:
+            break
+        rss = read_peak_rss(proc.pid)
+        if rss is not None and (peak is None or rss > peak):
+            peak = rss
+        time.sleep(0.001)
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if usage.ru_maxrss > inherited and (peak is None or usage.ru_maxrss > peak):
+        peak = usage.ru_maxrss
+    return peak
+
+def instruction_count(cmd):
+    """
+    Counts the instructions the command executes in user space with perf.
+    Returns None if perf is not available.
+    """
+    if shutil.which('perf') is None:
+        return None
+    perf = ['perf', 'stat', '-x', ',', '-e', 'instructions:u'] + cmd
+    result = subprocess.run(perf, stdout=subprocess.DEVNULL,
+        stderr=subprocess.PIPE)
+    for line in result.stderr.decode('utf-8', 'replace').splitlines():
+        fields = line.split(',')
+        if len(fields) > 2 and fields[2].startswith('instructions'):
+            try:
+                return int(fields[0])
+            except ValueError:
+                return None
+    return None
+
+def bench_file(exe, file, runs):
+    """
+    Runs a benchmark the given number of times and returns its results
+    """
+    cmd = [exe, file]
+    times = []
+    for i in range(runs):
+        elapsed, _ = run_once(cmd)
+        times.append(elapsed)
+    return {
+        'time': statistics.median(times),
+        #measured in a separate run since polling would slow the timed ones
+        'rss': peak_rss(cmd),
+        'instructions': instruction_count(cmd)
+    }
+
+def format_change(current, baseline):
+    if current is None or baseline is None or baseline == 0:
+        return ''
+    return '%+.1f%%' %((current - baseline) / baseline * 100)
+
+def bench():
+    args = sys.argv[2:]
+    runs = 5
+    save = False
+    for arg in args:
+        if arg == 'save':
+            save = True
+        elif arg.isdigit() and int(arg) > 0:
+            runs = int(arg)
+        else:
+            print(BENCH_USAGE)
+            return False
+
+    if not build():
+        return False
+
+    baseline = {}
+    if os.path.exists(BENCH_BASELINE):
+        with open(BENCH_BASELINE) as f:
+            baseline = json.load(f)
+
+    files = sorted(with_extension(get_files(BENCH_DIR), '.blg'))
+    results = {}
+    regressions = []
+
+    print('%-20s %10s %10s %14s %10s' %('benchmark', 'median ms', 'peak KB',
+        'instructions', 'vs base'))
+    for file in files:
+        name = os.path.splitext(os.path.relpath(file, BENCH_DIR))[0]
+        try:
+            result = bench_file(executable(False), file, runs)
+        except RuntimeError as e:
+            print(e)
+            return False
+        results[name] = result
+
+        base = baseline.get(name, {})
+        change = format_change(result['time'], base.get('time'))
+        if result['instructions'] is not None and \
+                base.get('instructions') is not None:
+            metric = 'instructions'
+        else:
+            metric = 'time'
+        if base.get(metric) is not None and \
+                result[metric] > base[metric] * (1 + BENCH_TOLERANCE[metric]):
+            regressions.append(name)
+            change += ' REGRESSION'
+
+        instructions = result['instructions']
+        print('%-20s %10.1f %10s %14s %10s' %(name, result['time'] * 1000,
+            result['rss'] if result['rss'] is not None else '-',
+            instructions if instructions is not None else '-', change))
+
+    if save:
+        with open(BENCH_BASELINE, 'w') as f:
+            json.dump(results, f, indent=4, sort_keys=True)
+        print('saved the baseline to %s' %BENCH_BASELINE)
+    elif len(regressions) != 0:
+        print('regressions: %s' %', '.join(regressions))
+        return False
+    return True
+
 def help():
     print(USAGE)
 
@@ -203,6 +385,9 @@ def main():
         build()
     elif sys.argv[1] == 'valgrind':
         valgrind()
+    elif sys.argv[1] == 'bench':
+        if not bench():
+            sys.exit(1)
     elif len(sys.argv) != 2:
         invalid_args()
     elif sys.argv[1] == 'build':